@@ -0,0 +1,276 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Local attribute change tracking and report scheduling
+ *
+ * Reports follow the ZCL min / max interval and reportable change rules but
+ * never arm a timer: the scheduler runs from the wake path, so a report
+ * rides on a wake up the stack needed anyway (data poll, button, rejoin).
+ * Attributes of one cluster due together share a Report Attributes frame.
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "attr_report.h"
+#include <stdbool.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "energy_model.h"
+#include "esp_zigbee_core.h"
+#include "zboss_api.h"
+
+static const char* TAG = "attr_report";
+
+static attr_report_slot_t s_slots[ATTR_REPORT_MAX];
+static int s_count;
+static attr_report_stats_t s_stats;
+
+static attr_report_slot_t* attr_report_find(const void* value)
+{
+  for (int i = 0; i < s_count; ++i)
+  {
+    if (s_slots[i].desc->value == value)
+      return &s_slots[i];
+  }
+  return NULL;
+}
+
+esp_err_t attr_report_add(const attr_report_desc_t* desc)
+{
+  ESP_RETURN_ON_FALSE(
+      desc->size == 1 || desc->size == 2 || desc->size == 4,
+      ESP_ERR_INVALID_ARG,
+      TAG,
+      "attribute 0x%04x size %d",
+      desc->attr_id,
+      desc->size);
+  ESP_RETURN_ON_FALSE(
+      s_count < ATTR_REPORT_MAX, ESP_ERR_NO_MEM, TAG, "ATTR_REPORT_MAX");
+  s_slots[s_count++] = (attr_report_slot_t){.desc = desc, .pending = true};
+  return ESP_OK;
+}
+
+void attr_report_update(void* value)
+{
+  attr_report_slot_t* slot = attr_report_find(value);
+
+  if (!slot)
+    return;
+  const attr_report_desc_t* desc = slot->desc;
+  esp_zb_zcl_set_attribute_val(
+      desc->endpoint,
+      desc->cluster_id,
+      ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+      desc->attr_id,
+      value,
+      false);
+  ++s_stats.updates;
+
+  switch (attr_report_mark(slot, esp_timer_get_time()))
+  {
+  case ATTR_REPORT_BELOW_CHANGE:
+    ++s_stats.below_change;
+    break;
+  case ATTR_REPORT_HELD:
+    ++s_stats.held;
+    break;
+  default:
+    break;
+  }
+}
+
+/* single attribute, through the esp-zigbee API */
+static bool attr_report_send_one(attr_report_slot_t* slot)
+{
+  const attr_report_desc_t* desc = slot->desc;
+  esp_zb_zcl_report_attr_cmd_t cmd = {
+      .zcl_basic_cmd.src_endpoint = desc->endpoint,
+      .address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT,
+      .clusterID = desc->cluster_id,
+      .cluster_role = ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+      .attributeID = desc->attr_id,
+  };
+
+  /* sent to the bindings of the endpoint */
+  if (esp_zb_zcl_report_attr_cmd_req(&cmd) != ESP_OK)
+    return false;
+  /* attribute id, type and value */
+  energy_model_radio_tx(ENERGY_MODEL_ZCL_HEADER_BYTES + 3 + desc->size);
+  return true;
+}
+
+/*
+ * Pack the slots of one cluster into a Report Attributes frame, esp-zigbee
+ * only sends one attribute per report. Returns how many slots were used,
+ * packed or skipped because the stack has no such attribute, 0 if the frame
+ * could not be sent; the caller sends the rest in another frame.
+ */
+static int attr_report_send_frame(
+    attr_report_slot_t** slots, int count, int* packed)
+{
+  const attr_report_desc_t* first = slots[0]->desc;
+  zb_bufid_t buf = zb_buf_get_out();
+  zb_addr_u dst = {0};
+  int used = 0;
+
+  *packed = 0;
+  if (!buf)
+    return 0;
+  zb_uint8_t* start = ZB_ZCL_START_PACKET(buf);
+  zb_uint8_t* ptr = start;
+  ZB_ZCL_CONSTRUCT_GENERAL_COMMAND_RESP_FRAME_CONTROL(ptr);
+  ZB_ZCL_CONSTRUCT_COMMAND_HEADER(
+      ptr, ZB_ZCL_GET_SEQ_NUM(), ZB_ZCL_CMD_REPORT_ATTRIB);
+  for (; used < count; ++used)
+  {
+    const attr_report_desc_t* desc = slots[used]->desc;
+    zb_zcl_attr_t* attr = zb_zcl_get_attr_desc_a(
+        desc->endpoint,
+        desc->cluster_id,
+        ZB_ZCL_CLUSTER_SERVER_ROLE,
+        desc->attr_id);
+    if (!attr)
+    {
+      /* must not hold back the other attributes of the cluster */
+      ESP_LOGW(
+          TAG,
+          "No attribute 0x%04x in cluster 0x%04x of endpoint %d",
+          desc->attr_id,
+          desc->cluster_id,
+          desc->endpoint);
+      ++s_stats.send_errors;
+      continue;
+    }
+    size_t size = 3 + zb_zcl_get_attribute_size(attr->type, attr->data_p);
+    if (size > ZB_ZCL_GET_BYTES_AVAILABLE_WO_FRAGMENTATION(buf, ptr))
+      break;
+    ZB_ZCL_PACKET_PUT_DATA16_VAL(ptr, desc->attr_id);
+    ZB_ZCL_PACKET_PUT_DATA8(ptr, attr->type);
+    ptr = zb_zcl_put_value_to_packet(ptr, attr->type, attr->data_p);
+    ++*packed;
+  }
+  if (!*packed)
+  {
+    zb_buf_free(buf);
+    return used;
+  }
+  /* sent to the bindings of the endpoint */
+  if (zb_zcl_finish_and_send_packet(
+          buf,
+          ptr,
+          &dst,
+          ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT,
+          0,
+          first->endpoint,
+          ZB_AF_HA_PROFILE_ID,
+          first->cluster_id,
+          NULL) != RET_OK)
+  {
+    *packed = 0;
+    return 0;
+  }
+  energy_model_radio_tx(ptr - start);
+  return used;
+}
+
+/* send the slots of one cluster in as few frames as possible */
+static void attr_report_send_batch(
+    attr_report_slot_t** slots, int count, int64_t now_us)
+{
+  while (count > 0)
+  {
+    int packed = 1;
+    int used = count == 1 ? attr_report_send_one(slots[0])
+                          : attr_report_send_frame(slots, count, &packed);
+    if (!used)
+    {
+      s_stats.send_errors += count;
+      return;
+    }
+    /* a skipped attribute comes back with its max interval, not on every
+     * wake up */
+    for (int i = 0; i < used; ++i)
+      attr_report_sent(slots[i], now_us);
+    if (packed)
+    {
+      ++s_stats.frames;
+      s_stats.frames_saved += packed - 1;
+    }
+    slots += used;
+    count -= used;
+  }
+}
+
+void attr_report_on_wake(void)
+{
+  attr_report_reason_t reasons[ATTR_REPORT_MAX];
+  int64_t now = esp_timer_get_time();
+  int due = attr_report_select(s_slots, s_count, now, reasons);
+
+  ++s_stats.passes;
+  if (!due)
+    return;
+
+  ++s_stats.active_passes;
+  for (int i = 0; i < s_count; ++i)
+  {
+    if (reasons[i] == ATTR_REPORT_CHANGE)
+      ++s_stats.sent_change;
+    else if (reasons[i] == ATTR_REPORT_PERIODIC)
+      ++s_stats.sent_periodic;
+    else if (reasons[i] == ATTR_REPORT_ALIGNED)
+      ++s_stats.sent_aligned;
+  }
+  /* group the due attributes per endpoint and cluster */
+  for (int i = 0; i < s_count; ++i)
+  {
+    attr_report_slot_t* batch[ATTR_REPORT_MAX];
+    int count = 0;
+
+    if (reasons[i] == ATTR_REPORT_NONE)
+      continue;
+    for (int j = i; j < s_count; ++j)
+    {
+      if (reasons[j] != ATTR_REPORT_NONE &&
+          s_slots[j].desc->endpoint == s_slots[i].desc->endpoint &&
+          s_slots[j].desc->cluster_id == s_slots[i].desc->cluster_id)
+      {
+        batch[count++] = &s_slots[j];
+        reasons[j] = ATTR_REPORT_NONE;
+      }
+    }
+    attr_report_send_batch(batch, count, now);
+  }
+}
+
+esp_err_t attr_report_now(const attr_report_desc_t* desc)
+{
+  attr_report_slot_t slot = {.desc = desc};
+
+  esp_zb_zcl_set_attribute_val(
+      desc->endpoint,
+      desc->cluster_id,
+      ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+      desc->attr_id,
+      desc->value,
+      false);
+  if (!attr_report_send_one(&slot))
+  {
+    ++s_stats.send_errors;
+    return ESP_FAIL;
+  }
+  ++s_stats.sent_now;
+  ++s_stats.frames;
+  return ESP_OK;
+}
+
+void attr_report_get_stats(attr_report_stats_t* stats)
+{
+  *stats = s_stats;
+}
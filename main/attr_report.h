@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Local attribute change tracking and report scheduling
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "attr_report_policy.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct
+  {
+    uint32_t updates;
+    uint32_t below_change; /* updates smaller than the reportable change */
+    uint32_t held;         /* reportable changes waiting for min interval */
+    uint32_t sent_change;
+    uint32_t sent_periodic;
+    uint32_t sent_aligned; /* periodic reports sent early with another */
+    uint32_t sent_now;     /* attr_report_now() */
+    uint32_t send_errors;
+    uint32_t frames;       /* Report Attributes frames sent */
+    uint32_t frames_saved; /* attributes that shared a frame */
+    uint32_t passes;        /* wake ups that ran the scheduler */
+    uint32_t active_passes; /* of which sent at least one report */
+  } attr_report_stats_t;
+
+  /**
+   * @brief Track an attribute, its current value is reported on the first
+   * pass
+   *
+   * @param desc        description, must stay valid.
+   */
+  esp_err_t attr_report_add(const attr_report_desc_t* desc);
+
+  /**
+   * @brief Notify that the application wrote a new value
+   *
+   * The value is pushed to the stack and the attribute marked for report
+   * if it moved by the reportable change since the last report.
+   *
+   * @param value       storage of a tracked attribute.
+   */
+  void attr_report_update(void* value);
+
+  /**
+   * @brief Send the reports that are due, call only from a wake up that
+   * happens anyway
+   *
+   * Nothing is scheduled: a max interval expiring during sleep is reported
+   * on the next wake up, the data polls bound the delay.
+   */
+  void attr_report_on_wake(void);
+
+  /**
+   * @brief Write and report an attribute at once, outside the scheduler
+   *
+   * For events, where the value may repeat and a min interval makes no
+   * sense: the value is pushed to the stack and one Report Attributes frame
+   * goes to the bindings of the endpoint. The attribute must not be added
+   * to the scheduler.
+   *
+   * @param desc        description, the intervals and change are not used.
+   */
+  esp_err_t attr_report_now(const attr_report_desc_t* desc);
+
+  void attr_report_get_stats(attr_report_stats_t* stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Reporting rules of the attribute report scheduler
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "attr_report_policy.h"
+
+uint32_t attr_report_read(const attr_report_desc_t* desc)
+{
+  switch (desc->size)
+  {
+  case 1:
+    return *(const uint8_t*)desc->value;
+  case 2:
+    return *(const uint16_t*)desc->value;
+  default:
+    return *(const uint32_t*)desc->value;
+  }
+}
+
+attr_report_mark_t attr_report_mark(attr_report_slot_t* slot, int64_t now_us)
+{
+  const attr_report_desc_t* desc = slot->desc;
+  uint32_t now = attr_report_read(desc);
+  uint32_t delta = now > slot->reported ? now - slot->reported
+                                        : slot->reported - now;
+
+  if (!delta || slot->pending)
+    return ATTR_REPORT_UNCHANGED;
+  if (delta < desc->change)
+    return ATTR_REPORT_BELOW_CHANGE;
+  slot->pending = true;
+  if (now_us - slot->last_us < desc->min_interval_s * 1000000LL)
+    return ATTR_REPORT_HELD;
+  return ATTR_REPORT_MARKED;
+}
+
+attr_report_reason_t attr_report_due(
+    const attr_report_slot_t* slot, int64_t now_us, bool radio_busy)
+{
+  const attr_report_desc_t* desc = slot->desc;
+  int64_t elapsed = now_us - slot->last_us;
+  int64_t max_us = desc->max_interval_s * 1000000LL;
+
+  if (!slot->sent_once)
+    return ATTR_REPORT_CHANGE;
+  if (elapsed < desc->min_interval_s * 1000000LL)
+    return ATTR_REPORT_NONE;
+  if (slot->pending)
+    return ATTR_REPORT_CHANGE;
+  if (max_us && elapsed >= max_us)
+    return ATTR_REPORT_PERIODIC;
+  if (radio_busy && max_us &&
+      elapsed >= max_us - max_us / ATTR_REPORT_ALIGN_DIV)
+    return ATTR_REPORT_ALIGNED;
+  return ATTR_REPORT_NONE;
+}
+
+int attr_report_select(
+    const attr_report_slot_t* slots,
+    int count,
+    int64_t now_us,
+    attr_report_reason_t* reasons)
+{
+  int due = 0;
+
+  for (int i = 0; i < count; ++i)
+    reasons[i] = ATTR_REPORT_NONE;
+  /* second pass only if the first one found a report to send */
+  for (int pass = 0; pass < 2 && (pass == 0 || due); ++pass)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      if (reasons[i] != ATTR_REPORT_NONE)
+        continue;
+      reasons[i] = attr_report_due(&slots[i], now_us, pass > 0);
+      if (reasons[i] != ATTR_REPORT_NONE)
+        ++due;
+    }
+  }
+  return due;
+}
+
+void attr_report_sent(attr_report_slot_t* slot, int64_t now_us)
+{
+  slot->reported = attr_report_read(slot->desc);
+  slot->last_us = now_us;
+  slot->pending = false;
+  slot->sent_once = true;
+}
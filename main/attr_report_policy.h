@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Reporting rules of the attribute report scheduler
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* reported attributes, all endpoints together */
+#define ATTR_REPORT_MAX 8
+/* when a report goes out anyway, periodic reports due within 1/DIV of
+ * their max interval are sent along instead of on a later wake up */
+#define ATTR_REPORT_ALIGN_DIV 8
+
+  typedef struct
+  {
+    uint8_t endpoint;
+    uint16_t cluster_id;
+    uint16_t attr_id;
+    /* unsigned value in application storage, 1, 2 or 4 bytes, the same
+     * storage the cluster was built from */
+    void* value;
+    uint8_t size;
+    uint16_t min_interval_s;
+    uint16_t max_interval_s; /* 0 disables periodic reports */
+    uint32_t change;         /* reportable change, 0 reports any change */
+  } attr_report_desc_t;
+
+  typedef enum
+  {
+    ATTR_REPORT_NONE,
+    ATTR_REPORT_CHANGE,
+    ATTR_REPORT_PERIODIC,
+    ATTR_REPORT_ALIGNED,
+  } attr_report_reason_t;
+
+  /* what a new value did to a slot */
+  typedef enum
+  {
+    ATTR_REPORT_UNCHANGED, /* same value or already pending */
+    ATTR_REPORT_BELOW_CHANGE,
+    ATTR_REPORT_MARKED, /* reported on the next wake up */
+    ATTR_REPORT_HELD,   /* reported once the min interval elapsed */
+  } attr_report_mark_t;
+
+  typedef struct
+  {
+    const attr_report_desc_t* desc;
+    uint32_t reported; /* value carried by the last report */
+    int64_t last_us;
+    bool pending;
+    bool sent_once;
+  } attr_report_slot_t;
+
+  /*
+   * Plain functions without timers, also built on the host by
+   * tools/attr_report_test.c.
+   */
+
+  uint32_t attr_report_read(const attr_report_desc_t* desc);
+
+  /**
+   * @brief Mark the slot for report if its value moved by the reportable
+   * change since the last report
+   */
+  attr_report_mark_t attr_report_mark(attr_report_slot_t* slot, int64_t now_us);
+
+  /**
+   * @brief Why a slot is reported at now_us, if it is
+   *
+   * @param radio_busy  another report goes out on this wake up.
+   */
+  attr_report_reason_t attr_report_due(
+      const attr_report_slot_t* slot, int64_t now_us, bool radio_busy);
+
+  /**
+   * @brief Reasons of the slots reported on a wake up at now_us
+   *
+   * Aligned reports are only chosen when something else is due.
+   *
+   * @return the number of slots due
+   */
+  int attr_report_select(
+      const attr_report_slot_t* slots,
+      int count,
+      int64_t now_us,
+      attr_report_reason_t* reasons);
+
+  /**
+   * @brief Record that the current value of the slot was reported
+   */
+  void attr_report_sent(attr_report_slot_t* slot, int64_t now_us);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,196 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Battery voltage monitor feeding the Power Configuration cluster
+ *
+ * The ADC is only read from the wake path, at most every
+ * BATTERY_SAMPLE_PERIOD_MS, so measuring never adds a wake up. Readings are
+ * smoothed with an EMA and the attributes only change when the quantized
+ * value moves, attr_report then applies the reportable change.
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "battery_monitor.h"
+#include <inttypes.h>
+#include "attr_report.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+#include "zcl/esp_zigbee_zcl_power_config.h"
+
+static const char* TAG = "battery";
+
+typedef struct
+{
+  uint16_t mv;
+  uint8_t percentage; /* ZCL unit, 200 is 100% */
+} battery_level_t;
+
+/* discharge curve of a lithium coin cell, descending voltages */
+static const battery_level_t battery_curve[] = {
+    {3000, 200},
+    {2900, 160},
+    {2800, 120},
+    {2700, 80},
+    {2600, 50},
+    {2500, 30},
+    {2400, 15},
+    {2200, 0},
+};
+
+static adc_oneshot_unit_handle_t s_adc;
+static adc_cali_handle_t s_cali;
+/* last measure attempted, failed or not, 0 before the first */
+static int64_t s_last_sample_us;
+/* filtered voltage in mV << BATTERY_EMA_SHIFT, 0 until the first sample */
+static uint32_t s_filtered;
+static battery_monitor_stats_t s_stats = {.percentage = 200};
+static attr_report_desc_t s_reports[] = {
+    {
+        .cluster_id = ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
+        .attr_id = ESP_ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_VOLTAGE_ID,
+        .value = &s_stats.voltage,
+        .size = sizeof(s_stats.voltage),
+        .min_interval_s = BATTERY_REPORT_MIN_INTERVAL_S,
+        .max_interval_s = BATTERY_REPORT_MAX_INTERVAL_S,
+        .change = BATTERY_VOLTAGE_REPORT_DELTA,
+    },
+    {
+        .cluster_id = ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
+        .attr_id = ESP_ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_PERCENTAGE_REMAINING_ID,
+        .value = &s_stats.percentage,
+        .size = sizeof(s_stats.percentage),
+        .min_interval_s = BATTERY_REPORT_MIN_INTERVAL_S,
+        .max_interval_s = BATTERY_REPORT_MAX_INTERVAL_S,
+        .change = BATTERY_PERCENTAGE_REPORT_DELTA,
+    },
+};
+
+static uint8_t battery_percentage_from_mv(uint32_t mv)
+{
+  const size_t n = sizeof(battery_curve) / sizeof(battery_curve[0]);
+
+  if (mv >= battery_curve[0].mv)
+    return battery_curve[0].percentage;
+  for (size_t i = 1; i < n; ++i)
+  {
+    const battery_level_t* hi = &battery_curve[i - 1];
+    const battery_level_t* lo = &battery_curve[i];
+    if (mv >= lo->mv)
+      return lo->percentage + (mv - lo->mv) * (hi->percentage - lo->percentage) /
+                                  (hi->mv - lo->mv);
+  }
+  return 0;
+}
+
+esp_err_t battery_monitor_init(uint8_t endpoint)
+{
+  adc_oneshot_unit_init_cfg_t unit_cfg = {
+      .unit_id = BATTERY_ADC_UNIT,
+  };
+  adc_oneshot_chan_cfg_t chan_cfg = {
+      .atten = BATTERY_ADC_ATTEN,
+      .bitwidth = ADC_BITWIDTH_DEFAULT,
+  };
+  adc_cali_curve_fitting_config_t cali_cfg = {
+      .unit_id = BATTERY_ADC_UNIT,
+      .chan = BATTERY_ADC_CHANNEL,
+      .atten = BATTERY_ADC_ATTEN,
+      .bitwidth = ADC_BITWIDTH_DEFAULT,
+  };
+
+  ESP_RETURN_ON_ERROR(
+      adc_oneshot_new_unit(&unit_cfg, &s_adc), TAG, "ADC unit init failed");
+  ESP_RETURN_ON_ERROR(
+      adc_oneshot_config_channel(s_adc, BATTERY_ADC_CHANNEL, &chan_cfg),
+      TAG,
+      "ADC channel config failed");
+  ESP_RETURN_ON_ERROR(
+      adc_cali_create_scheme_curve_fitting(&cali_cfg, &s_cali),
+      TAG,
+      "ADC calibration failed");
+  /* reported once measured, the first measure precedes the first report */
+  for (size_t i = 0; i < sizeof(s_reports) / sizeof(s_reports[0]); ++i)
+  {
+    s_reports[i].endpoint = endpoint;
+    ESP_RETURN_ON_ERROR(attr_report_add(&s_reports[i]), TAG, "reporting");
+  }
+  return ESP_OK;
+}
+
+static esp_err_t battery_monitor_measure_mv(uint32_t* mv)
+{
+  int sum = 0;
+
+  for (int i = 0; i < BATTERY_SAMPLES_PER_MEASURE; ++i)
+  {
+    int sample;
+    ESP_RETURN_ON_ERROR(
+        adc_oneshot_get_calibrated_result(
+            s_adc, s_cali, BATTERY_ADC_CHANNEL, &sample),
+        TAG,
+        "ADC read failed");
+    sum += sample;
+  }
+  *mv = sum * BATTERY_DIVIDER_RATIO / BATTERY_SAMPLES_PER_MEASURE;
+  return ESP_OK;
+}
+
+void battery_monitor_on_wake(void)
+{
+  int64_t start = esp_timer_get_time();
+  uint32_t mv;
+
+  if (!s_adc ||
+      (s_last_sample_us &&
+       start - s_last_sample_us < BATTERY_SAMPLE_PERIOD_MS * 1000LL))
+    return;
+  /* a failing ADC is retried after the period too, not on every wake up */
+  s_last_sample_us = start;
+  if (battery_monitor_measure_mv(&mv) != ESP_OK)
+    return;
+
+  if (!s_filtered)
+    s_filtered = mv << BATTERY_EMA_SHIFT;
+  else
+    s_filtered += mv - (s_filtered >> BATTERY_EMA_SHIFT);
+  s_stats.filtered_mv = s_filtered >> BATTERY_EMA_SHIFT;
+
+  uint8_t voltage = (s_stats.filtered_mv + 50) / 100;
+  uint8_t percentage = battery_percentage_from_mv(s_stats.filtered_mv);
+  if (voltage != s_stats.voltage)
+  {
+    s_stats.voltage = voltage;
+    attr_report_update(&s_stats.voltage);
+  }
+  if (percentage != s_stats.percentage)
+  {
+    s_stats.percentage = percentage;
+    attr_report_update(&s_stats.percentage);
+  }
+
+  ++s_stats.sample_count;
+  s_stats.sample_time_us += esp_timer_get_time() - start;
+  ESP_LOGI(
+      TAG,
+      "Battery %" PRIu32 " mV (filtered %" PRIu32 " mV), %d%%, sampling "
+      "%" PRIu64 " us over %" PRIu32 " measures",
+      mv,
+      s_stats.filtered_mv,
+      s_stats.percentage / 2,
+      s_stats.sample_time_us,
+      s_stats.sample_count);
+}
+
+void battery_monitor_get_stats(battery_monitor_stats_t* stats)
+{
+  *stats = s_stats;
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Battery voltage monitor feeding the Power Configuration cluster
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_adc/adc_oneshot.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* battery sensed through a divider on an ADC1 pin */
+#define BATTERY_ADC_UNIT ADC_UNIT_1
+#define BATTERY_ADC_CHANNEL ADC_CHANNEL_3
+#define BATTERY_ADC_ATTEN ADC_ATTEN_DB_11
+#define BATTERY_DIVIDER_RATIO 2
+/* minimum time between two measurements, taken only on existing wake ups */
+#define BATTERY_SAMPLE_PERIOD_MS (5 * 60 * 1000)
+/* raw conversions averaged into one measurement */
+#define BATTERY_SAMPLES_PER_MEASURE 4
+/* EMA weight of a new measurement is 1 / 2^BATTERY_EMA_SHIFT */
+#define BATTERY_EMA_SHIFT 2
+/* reportable change: 100 mV (one unit) and 2% (4 half percents) */
+#define BATTERY_VOLTAGE_REPORT_DELTA 1
+#define BATTERY_PERCENTAGE_REPORT_DELTA 4
+#define BATTERY_REPORT_MIN_INTERVAL_S 60
+#define BATTERY_REPORT_MAX_INTERVAL_S (6 * 60 * 60)
+
+  typedef struct
+  {
+    uint32_t filtered_mv;
+    uint8_t voltage;    /* ZCL unit, 100 mV */
+    uint8_t percentage; /* ZCL unit, 200 is 100% */
+    uint32_t sample_count;
+    uint64_t sample_time_us;
+  } battery_monitor_stats_t;
+
+  /**
+   * @brief Configure the ADC and register the attributes with attr_report,
+   * no measurement is taken yet
+   *
+   * @param endpoint    endpoint holding the Power Configuration cluster.
+   */
+  esp_err_t battery_monitor_init(uint8_t endpoint);
+
+  /**
+   * @brief Measure if the sample period elapsed, call only from a wake up
+   * that happens anyway (never schedules one)
+   */
+  void battery_monitor_on_wake(void);
+
+  void battery_monitor_get_stats(battery_monitor_stats_t* stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
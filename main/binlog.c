@@ -0,0 +1,180 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Deferred binary log ring
+ *
+ * An entry is a header word (argument count and a 24 bit ms timestamp), the
+ * tag and format string addresses, then the raw arguments. Writing one costs
+ * a few word stores under a spinlock; formatting happens on the host.
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "binlog.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG_ENABLED
+#include "driver/usb_serial_jtag.h"
+#endif
+#if CONFIG_BINLOG_CONSOLE
+#include "driver/uart.h"
+#include "esp_console.h"
+#include "esp_sleep.h"
+#endif
+
+/* argument count, milliseconds since boot, tag and format addresses; the
+ * timestamp has its own word, it wraps after 49 days */
+#define BINLOG_HEADER_WORDS 4
+/* rising edges on RX that wake the chip, the characters are lost */
+#define BINLOG_CONSOLE_WAKEUP_EDGES 3
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_ring[BINLOG_RING_WORDS];
+/* free running word indexes */
+static uint32_t s_head;
+static uint32_t s_tail;
+static binlog_stats_t s_stats;
+
+static inline uint32_t binlog_entry_words(uint32_t header)
+{
+  return BINLOG_HEADER_WORDS + (header & 0xff);
+}
+
+void binlog_write(const char* tag, int nargs, const char* fmt, ...)
+{
+  uint32_t ms = esp_timer_get_time() / 1000;
+  va_list ap;
+
+  /* the header must describe what is stored, binlog_flush() copies at most
+   * BINLOG_MAX_ARGS */
+  if (nargs > BINLOG_MAX_ARGS)
+    nargs = BINLOG_MAX_ARGS;
+  uint32_t words = BINLOG_HEADER_WORDS + nargs;
+
+  va_start(ap, fmt);
+  portENTER_CRITICAL_SAFE(&s_mux);
+  /* overwrite the oldest entries when the ring is full */
+  while (s_head - s_tail + words > BINLOG_RING_WORDS)
+  {
+    s_tail += binlog_entry_words(s_ring[s_tail % BINLOG_RING_WORDS]);
+    ++s_stats.dropped;
+  }
+  s_ring[s_head++ % BINLOG_RING_WORDS] = nargs;
+  s_ring[s_head++ % BINLOG_RING_WORDS] = ms;
+  s_ring[s_head++ % BINLOG_RING_WORDS] = (uintptr_t)tag;
+  s_ring[s_head++ % BINLOG_RING_WORDS] = (uintptr_t)fmt;
+  for (int i = 0; i < nargs; ++i)
+    s_ring[s_head++ % BINLOG_RING_WORDS] = va_arg(ap, uint32_t);
+  ++s_stats.written;
+  portEXIT_CRITICAL_SAFE(&s_mux);
+  va_end(ap);
+}
+
+void binlog_flush(void)
+{
+  uint32_t entry[BINLOG_HEADER_WORDS + BINLOG_MAX_ARGS];
+
+  for (;;)
+  {
+    uint32_t words = 0;
+
+    /* copy one entry out so the console is not written under the lock */
+    portENTER_CRITICAL(&s_mux);
+    if (s_tail != s_head)
+    {
+      words = binlog_entry_words(s_ring[s_tail % BINLOG_RING_WORDS]);
+      for (uint32_t i = 0; i < words; ++i)
+        entry[i] = s_ring[s_tail++ % BINLOG_RING_WORDS];
+    }
+    portEXIT_CRITICAL(&s_mux);
+    if (!words)
+      break;
+
+    printf("BL:");
+    for (uint32_t i = 0; i < words; ++i)
+      printf(" %08lx", (unsigned long)entry[i]);
+    printf("\n");
+  }
+}
+
+void binlog_flush_if_attached(void)
+{
+  if (s_tail == s_head)
+    return;
+#if CONFIG_BINLOG_FLUSH_ON_WAKE
+  binlog_flush();
+#elif CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG_ENABLED
+  if (usb_serial_jtag_is_connected())
+    binlog_flush();
+#endif
+}
+
+#if CONFIG_BINLOG_CONSOLE
+static const char* TAG = "binlog";
+
+static int binlog_console_command(int argc, char** argv)
+{
+  binlog_stats_t stats;
+
+  binlog_flush();
+  binlog_get_stats(&stats);
+  printf(
+      "binlog: %" PRIu32 " written, %" PRIu32 " dropped\n",
+      stats.written,
+      stats.dropped);
+  return 0;
+}
+
+esp_err_t binlog_console_init(void)
+{
+  esp_console_repl_t* repl = NULL;
+  esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+  esp_console_dev_uart_config_t uart_config =
+      ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+  const esp_console_cmd_t command = {
+      .command = "binlog",
+      .help = "Print and empty the binary log ring",
+      .func = binlog_console_command,
+  };
+
+  repl_config.prompt = "bulb>";
+  ESP_RETURN_ON_ERROR(
+      esp_console_new_repl_uart(&uart_config, &repl_config, &repl),
+      TAG,
+      "console");
+  ESP_RETURN_ON_ERROR(esp_console_cmd_register(&command), TAG, "command");
+  /* typed on a sleeping device, the command would never be read */
+  ESP_RETURN_ON_ERROR(
+      uart_set_wakeup_threshold(
+          CONFIG_ESP_CONSOLE_UART_NUM, BINLOG_CONSOLE_WAKEUP_EDGES),
+      TAG,
+      "wake up threshold");
+  ESP_RETURN_ON_ERROR(
+      esp_sleep_enable_uart_wakeup(CONFIG_ESP_CONSOLE_UART_NUM),
+      TAG,
+      "UART wake up");
+  return esp_console_start_repl(repl);
+}
+#else
+esp_err_t binlog_console_init(void)
+{
+  return ESP_OK;
+}
+#endif
+
+void binlog_get_stats(binlog_stats_t* stats)
+{
+  portENTER_CRITICAL(&s_mux);
+  *stats = s_stats;
+  portEXIT_CRITICAL(&s_mux);
+}
@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Deferred binary log ring
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* ring size in 32 bit words */
+#define BINLOG_RING_WORDS 1024
+#define BINLOG_MAX_ARGS 6
+
+/* number of macro arguments, format string included */
+#define BINLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define BINLOG_NARGS(...) BINLOG_NARGS_(__VA_ARGS__, 7, 6, 5, 4, 3, 2, 1, _)
+
+/**
+ * @brief Log an entry without formatting it
+ *
+ * Only the addresses of the tag and the format string are stored, the
+ * decoder reads the strings back from the ELF (tools/binlog_decode.py).
+ * Arguments must fit in 32 bits, %s only accepts strings with static storage
+ * (string literals, esp_err_to_name(), ...).
+ */
+#if CONFIG_BINLOG_ENABLE
+#define BINLOG(tag, ...) \
+  binlog_write(tag, BINLOG_NARGS(__VA_ARGS__) - 1, __VA_ARGS__)
+#else
+#define BINLOG(tag, ...) ESP_LOGI(tag, __VA_ARGS__)
+#endif
+
+  typedef struct
+  {
+    uint32_t written;
+    uint32_t dropped; /* oldest entries overwritten before a flush */
+  } binlog_stats_t;
+
+  void binlog_write(const char* tag, int nargs, const char* fmt, ...);
+
+  /**
+   * @brief Print the pending entries in the decoder format and empty the ring
+   */
+  void binlog_flush(void);
+
+  /**
+   * @brief Flush if a host is listening on USB-Serial/JTAG, always with
+   * CONFIG_BINLOG_FLUSH_ON_WAKE
+   */
+  void binlog_flush_if_attached(void);
+
+  /**
+   * @brief Start the UART console with the binlog command, which flushes on
+   * demand; nothing to do without CONFIG_BINLOG_CONSOLE
+   */
+  esp_err_t binlog_console_init(void);
+
+  void binlog_get_stats(binlog_stats_t* stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,152 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Energy accounting model
+ *
+ * Time is split between awake (CPU active) and light sleep using the
+ * CAN_SLEEP path. Radio time is not observable from the application, it is
+ * estimated from the airtime of the frames the application sees plus one
+ * data poll exchange per timer wake up. Flash is powered while awake, and
+ * while asleep too unless CONFIG_ESP_SLEEP_POWER_DOWN_FLASH is set.
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "energy_model.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+/* 802.15.4 at 250 kbps */
+#define ENERGY_MODEL_US_PER_BYTE 32
+/* preamble, SFD, PHR and FCS */
+#define ENERGY_MODEL_PHY_OVERHEAD_BYTES 8
+/* RX/TX turnaround and the 5 byte ACK frame */
+#define ENERGY_MODEL_ACK_US (192 + (5 + 6) * ENERGY_MODEL_US_PER_BYTE)
+/* MAC data request and the wait for the parent answer */
+#define ENERGY_MODEL_POLL_TX_BYTES 12
+#define ENERGY_MODEL_POLL_RX_WAIT_US 2000
+
+static const uint32_t s_current_ua[ENERGY_STATE_COUNT] = {
+    [ENERGY_STATE_CPU_ACTIVE] = ENERGY_MODEL_CPU_ACTIVE_UA,
+    [ENERGY_STATE_LIGHT_SLEEP] = ENERGY_MODEL_LIGHT_SLEEP_UA,
+    [ENERGY_STATE_RADIO_RX] = ENERGY_MODEL_RADIO_RX_UA,
+    [ENERGY_STATE_RADIO_TX] = ENERGY_MODEL_RADIO_TX_UA,
+    [ENERGY_STATE_FLASH] = ENERGY_MODEL_FLASH_UA,
+};
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint64_t s_time_us[ENERGY_STATE_COUNT];
+static int64_t s_start_us;
+static int64_t s_awake_since_us;
+static int64_t s_sleep_since_us;
+
+void energy_model_init(void)
+{
+  portENTER_CRITICAL(&s_mux);
+  for (int i = 0; i < ENERGY_STATE_COUNT; ++i)
+    s_time_us[i] = 0;
+  s_start_us = esp_timer_get_time();
+  s_awake_since_us = s_start_us;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+void energy_model_sleep_enter(void)
+{
+  int64_t now = esp_timer_get_time();
+
+  portENTER_CRITICAL(&s_mux);
+  s_time_us[ENERGY_STATE_CPU_ACTIVE] += now - s_awake_since_us;
+  s_time_us[ENERGY_STATE_FLASH] += now - s_awake_since_us;
+  s_sleep_since_us = now;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+void energy_model_sleep_exit(esp_sleep_wakeup_cause_t cause)
+{
+  int64_t now = esp_timer_get_time();
+
+  portENTER_CRITICAL(&s_mux);
+  s_time_us[ENERGY_STATE_LIGHT_SLEEP] += now - s_sleep_since_us;
+#if !CONFIG_ESP_SLEEP_POWER_DOWN_FLASH
+  s_time_us[ENERGY_STATE_FLASH] += now - s_sleep_since_us;
+#endif
+  s_awake_since_us = now;
+  portEXIT_CRITICAL(&s_mux);
+
+  if (cause == ESP_SLEEP_WAKEUP_TIMER)
+  {
+    energy_model_radio_tx(ENERGY_MODEL_POLL_TX_BYTES);
+    portENTER_CRITICAL(&s_mux);
+    s_time_us[ENERGY_STATE_RADIO_RX] += ENERGY_MODEL_POLL_RX_WAIT_US;
+    portEXIT_CRITICAL(&s_mux);
+  }
+}
+
+void energy_model_radio_tx(uint16_t bytes)
+{
+  portENTER_CRITICAL(&s_mux);
+  s_time_us[ENERGY_STATE_RADIO_TX] +=
+      (bytes + ENERGY_MODEL_PHY_OVERHEAD_BYTES) * ENERGY_MODEL_US_PER_BYTE;
+  s_time_us[ENERGY_STATE_RADIO_RX] += ENERGY_MODEL_ACK_US;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+void energy_model_radio_rx(uint16_t bytes)
+{
+  portENTER_CRITICAL(&s_mux);
+  s_time_us[ENERGY_STATE_RADIO_RX] +=
+      (bytes + ENERGY_MODEL_PHY_OVERHEAD_BYTES) * ENERGY_MODEL_US_PER_BYTE;
+  s_time_us[ENERGY_STATE_RADIO_TX] += ENERGY_MODEL_ACK_US;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+void energy_model_get_stats(energy_model_stats_t* stats)
+{
+  int64_t now = esp_timer_get_time();
+  uint64_t charge = 0; /* uA * us */
+  uint64_t radio_us;
+
+  portENTER_CRITICAL(&s_mux);
+  for (int i = 0; i < ENERGY_STATE_COUNT; ++i)
+    stats->time_us[i] = s_time_us[i];
+  stats->time_us[ENERGY_STATE_CPU_ACTIVE] += now - s_awake_since_us;
+  stats->time_us[ENERGY_STATE_FLASH] += now - s_awake_since_us;
+  stats->elapsed_us = now - s_start_us;
+  portEXIT_CRITICAL(&s_mux);
+
+  /* radio currents include the CPU, do not count that time twice */
+  radio_us = stats->time_us[ENERGY_STATE_RADIO_RX] +
+             stats->time_us[ENERGY_STATE_RADIO_TX];
+  for (int i = 0; i < ENERGY_STATE_COUNT; ++i)
+  {
+    uint64_t t = stats->time_us[i];
+    if (i == ENERGY_STATE_CPU_ACTIVE)
+      t = t > radio_us ? t - radio_us : 0;
+    charge += t * s_current_ua[i];
+  }
+  stats->consumed_uah = charge / 3600000000ULL;
+  stats->average_ua = stats->elapsed_us ? charge / stats->elapsed_us : 0;
+
+  uint32_t capacity_uah = ENERGY_MODEL_BATTERY_CAPACITY_MAH * 1000;
+  stats->battery_percentage =
+      stats->consumed_uah >= capacity_uah
+          ? 0
+          : 200 - (uint64_t)stats->consumed_uah * 200 / capacity_uah;
+}
+
+const char* energy_state_to_string(energy_state_t state)
+{
+  static const char* names[ENERGY_STATE_COUNT] = {
+      [ENERGY_STATE_CPU_ACTIVE] = "cpu_active",
+      [ENERGY_STATE_LIGHT_SLEEP] = "light_sleep",
+      [ENERGY_STATE_RADIO_RX] = "radio_rx",
+      [ENERGY_STATE_RADIO_TX] = "radio_tx",
+      [ENERGY_STATE_FLASH] = "flash",
+  };
+  return state < ENERGY_STATE_COUNT ? names[state] : "unknown";
+}
@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Energy accounting model
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_sleep.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Typical currents in uA from the datasheets, replace with bench figures for
+ * a given board. Radio figures include the CPU running next to the radio. */
+#if CONFIG_IDF_TARGET_ESP32C6
+#define ENERGY_MODEL_CPU_ACTIVE_UA 27000
+#define ENERGY_MODEL_LIGHT_SLEEP_UA 180
+#define ENERGY_MODEL_RADIO_RX_UA 74000
+#define ENERGY_MODEL_RADIO_TX_UA 77000
+#define ENERGY_MODEL_FLASH_UA 2000
+#else /* ESP32-H2 */
+#define ENERGY_MODEL_CPU_ACTIVE_UA 11000
+#define ENERGY_MODEL_LIGHT_SLEEP_UA 85
+#define ENERGY_MODEL_RADIO_RX_UA 24000
+#define ENERGY_MODEL_RADIO_TX_UA 20000
+#define ENERGY_MODEL_FLASH_UA 2000
+#endif
+
+/* frame control, sequence number and command of a ZCL frame, the byte
+ * count the application passes for the frames it sends starts there */
+#define ENERGY_MODEL_ZCL_HEADER_BYTES 3
+
+/* capacity used for BatteryPercentageRemaining, CR2032 by default */
+#ifndef ENERGY_MODEL_BATTERY_CAPACITY_MAH
+#define ENERGY_MODEL_BATTERY_CAPACITY_MAH 220
+#endif
+
+  typedef enum
+  {
+    ENERGY_STATE_CPU_ACTIVE,
+    ENERGY_STATE_LIGHT_SLEEP,
+    ENERGY_STATE_RADIO_RX,
+    ENERGY_STATE_RADIO_TX,
+    ENERGY_STATE_FLASH,
+    ENERGY_STATE_COUNT,
+  } energy_state_t;
+
+  typedef struct
+  {
+    uint64_t time_us[ENERGY_STATE_COUNT];
+    uint64_t elapsed_us;
+    uint32_t consumed_uah;
+    uint32_t average_ua; /* also the uAh used per hour */
+    uint8_t battery_percentage; /* ZCL unit, 200 is 100% */
+  } energy_model_stats_t;
+
+  void energy_model_init(void);
+
+  /**
+   * @brief Call right before the light sleep
+   */
+  void energy_model_sleep_enter(void);
+
+  /**
+   * @brief Call right after the light sleep
+   *
+   * @param cause       wake up cause, a timer wake is accounted as a data
+   * poll to the parent.
+   */
+  void energy_model_sleep_exit(esp_sleep_wakeup_cause_t cause);
+
+  /**
+   * @brief Account the airtime of a frame sent or received, in MAC payload
+   * bytes
+   *
+   * The application calls energy_model_radio_tx() for each frame it hands
+   * to the stack, with the ZCL frame size.
+   */
+  void energy_model_radio_tx(uint16_t bytes);
+
+  void energy_model_radio_rx(uint16_t bytes);
+
+  /**
+   * @brief Snapshot of the model, the current awake period is included
+   */
+  void energy_model_get_stats(energy_model_stats_t* stats);
+
+  const char* energy_state_to_string(energy_state_t state);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -12,20 +12,40 @@
  * CONDITIONS OF ANY KIND, either express or implied.
  */
 #include "esp_zb_light.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include "attr_report.h"
+#include "battery_monitor.h"
+#include "binlog.h"
+#include "energy_model.h"
 #include "esp_check.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_sleep.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "ha/esp_zigbee_ha_standard.h"
+#include "light_control.h"
+#include "light_driver.h"
+#include "light_power.h"
 #include "nvs_flash.h"
+#include "ota_client.h"
+#include "poll_control.h"
+#include "power_save.h"
+#include "sleep_stats.h"
+#include "sleep_tuner.h"
 #include "string.h"
+#include "zb_arena.h"
+#include "zb_connectivity.h"
+#include "zb_descriptor.h"
+#include "zb_diagnostics.h"
+#include "zcl_decode.h"
+#include "zboss_api.h"
 #include "zcl/esp_zigbee_zcl_common.h"
-#ifdef CONFIG_PM_ENABLE
-#include "esp_pm.h"
-#include "esp_private/esp_clk.h"
-#endif
+#include "zcl/esp_zigbee_zcl_power_config.h"
+#include "zcl/zb_zcl_diagnostics.h"
+#include "zcl/zb_zcl_poll_control.h"
 
 char modelid[] = {5, 'P', 'l', 'o', 'u', 'f'};
 char manufname[] = {2, 'L', 'e'};
@@ -37,40 +57,817 @@ char manufname[] = {2, 'L', 'e'};
 static const char* TAG = "plouf";
 
 static switch_func_pair_t button_func_pair[] = {
-    {GPIO_INPUT_IO_TOGGLE_SWITCH, SWITCH_ONOFF_TOGGLE_CONTROL}};
+    {GPIO_INPUT_IO_TOGGLE_SWITCH, HA_BUTTON_FUNC}};
+
+/* attribute values, shared by every endpoint built from the same table */
+static struct
+{
+  uint8_t zcl_version;
+  uint8_t power_source;
+  uint16_t identify_time;
+  uint8_t groups_name_support;
+  uint8_t scenes_count;
+  uint8_t current_scene;
+  uint16_t current_group;
+  bool scene_valid;
+  uint8_t scenes_name_support;
+  bool on_off;
+  uint8_t current_level;
+  uint16_t color_x;
+  uint16_t color_y;
+  uint8_t color_mode;
+  uint8_t battery_voltage;
+  uint8_t battery_percentage;
+  uint32_t average_current_ua;
+  uint32_t report_frames_saved;
+  uint32_t check_in_interval;
+  uint32_t long_poll_interval;
+  uint16_t short_poll_interval;
+  uint16_t fast_poll_timeout;
+  uint16_t fast_poll_timeout_max;
+  esp_zb_ieee_addr_t ota_server_id;
+  uint32_t ota_file_offset;
+  uint32_t ota_file_version;
+  uint32_t ota_downloaded_file_version;
+  uint8_t ota_image_status;
+  uint16_t ota_manufacturer;
+  uint16_t ota_image_type;
+  uint16_t ota_min_block_period;
+  uint16_t ota_server_addr;
+  uint8_t ota_server_endpoint;
+  uint16_t button_states;
+  bool button_out_of_service;
+  uint8_t button_status_flags;
+  uint16_t button_event;
+} light_attr = {
+    .zcl_version = ESP_ZB_ZCL_BASIC_ZCL_VERSION_DEFAULT_VALUE,
+    .power_source = ZB_ZCL_BASIC_POWER_SOURCE_BATTERY,
+    .identify_time = ESP_ZB_ZCL_IDENTIFY_IDENTIFY_TIME_DEFAULT_VALUE,
+    .groups_name_support = ESP_ZB_ZCL_GROUPS_NAME_SUPPORT_DEFAULT_VALUE,
+    .scenes_count = ESP_ZB_ZCL_SCENES_SCENE_COUNT_DEFAULT_VALUE,
+    .current_scene = ESP_ZB_ZCL_SCENES_CURRENT_SCENE_DEFAULT_VALUE,
+    .current_group = ESP_ZB_ZCL_SCENES_CURRENT_GROUP_DEFAULT_VALUE,
+    .scene_valid = ESP_ZB_ZCL_SCENES_SCENE_VALID_DEFAULT_VALUE,
+    .scenes_name_support = ESP_ZB_ZCL_SCENES_NAME_SUPPORT_DEFAULT_VALUE,
+    .on_off = ESP_ZB_ZCL_ON_OFF_ON_OFF_DEFAULT_VALUE,
+    .current_level = LIGHT_LEVEL_MAX,
+    .color_x = ESP_ZB_ZCL_COLOR_CONTROL_CURRENT_X_DEF_VALUE,
+    .color_y = ESP_ZB_ZCL_COLOR_CONTROL_CURRENT_Y_DEF_VALUE,
+    .color_mode = ESP_ZB_ZCL_COLOR_CONTROL_COLOR_MODE_DEFAULT_VALUE,
+    .battery_percentage = 200,
+    .check_in_interval = POLL_CONTROL_CHECK_IN_INTERVAL_QS,
+    .long_poll_interval = POLL_CONTROL_LONG_POLL_INTERVAL_QS,
+    .short_poll_interval = POLL_CONTROL_SHORT_POLL_INTERVAL_QS,
+    .fast_poll_timeout = POLL_CONTROL_FAST_POLL_TIMEOUT_QS,
+    .fast_poll_timeout_max = POLL_CONTROL_FAST_POLL_TIMEOUT_MAX_QS,
+    .ota_server_id = ESP_ZB_ZCL_OTA_UPGRADE_SERVER_DEF_VALUE,
+    .ota_file_offset = ESP_ZB_ZCL_OTA_UPGRADE_FILE_OFFSET_DEF_VALUE,
+    .ota_file_version = HA_OTA_FILE_VERSION,
+    .ota_downloaded_file_version =
+        ESP_ZB_ZCL_OTA_UPGRADE_DOWNLOADED_FILE_VERSION_DEF_VALUE,
+    .ota_image_status = ESP_ZB_ZCL_OTA_UPGRADE_IMAGE_STATUS_DEF_VALUE,
+    .ota_manufacturer = HA_OTA_MANUFACTURER_CODE,
+    .ota_image_type = HA_OTA_IMAGE_TYPE,
+    .ota_min_block_period = ESP_ZB_OTA_UPGRADE_MIN_BLOCK_PERIOD_DEF_VALUE,
+    .ota_server_addr = ESP_ZB_ZCL_OTA_UPGRADE_SERVER_ADDR_DEF_VALUE,
+    .ota_server_endpoint = ESP_ZB_ZCL_OTA_UPGRADE_SERVER_ENDPOINT_DEF_VALUE,
+    .button_states = SWITCH_EVENT_RELEASE,
+    .button_event = SWITCH_EVENT_RELEASE,
+};
+
+static const zb_attr_desc_t basic_attrs[] = {
+    ZB_DESC_ATTR(ESP_ZB_ZCL_ATTR_BASIC_ZCL_VERSION_ID, &light_attr.zcl_version),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_BASIC_POWER_SOURCE_ID, &light_attr.power_source),
+    ZB_DESC_ATTR(ESP_ZB_ZCL_ATTR_BASIC_MODEL_IDENTIFIER_ID, &modelid[0]),
+    ZB_DESC_ATTR(ESP_ZB_ZCL_ATTR_BASIC_MANUFACTURER_NAME_ID, &manufname[0]),
+};
+
+static const zb_attr_desc_t identify_attrs[] = {
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_IDENTIFY_IDENTIFY_TIME_ID, &light_attr.identify_time),
+};
+
+static const zb_attr_desc_t light_groups_attrs[] = {
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_GROUPS_NAME_SUPPORT_ID,
+        &light_attr.groups_name_support),
+};
+
+static const zb_attr_desc_t light_scenes_attrs[] = {
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_SCENES_SCENE_COUNT_ID, &light_attr.scenes_count),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_SCENES_CURRENT_SCENE_ID, &light_attr.current_scene),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_SCENES_CURRENT_GROUP_ID, &light_attr.current_group),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_SCENES_SCENE_VALID_ID, &light_attr.scene_valid),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_SCENES_NAME_SUPPORT_ID,
+        &light_attr.scenes_name_support),
+};
+
+static const zb_attr_desc_t light_on_off_attrs[] = {
+    ZB_DESC_ATTR(ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, &light_attr.on_off),
+};
+
+static const zb_attr_desc_t light_level_attrs[] = {
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_LEVEL_CONTROL_CURRENT_LEVEL_ID,
+        &light_attr.current_level),
+};
+
+#if LIGHT_DRIVER_HAS_COLOR
+/* CIE xy only, the color mode never changes */
+static const zb_attr_desc_t light_color_attrs[] = {
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_COLOR_CONTROL_CURRENT_X_ID, &light_attr.color_x),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_COLOR_CONTROL_CURRENT_Y_ID, &light_attr.color_y),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_COLOR_CONTROL_COLOR_MODE_ID, &light_attr.color_mode),
+};
+#endif
+
+/* written by the battery monitor */
+static const zb_attr_desc_t light_power_config_attrs[] = {
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_VOLTAGE_ID,
+        &light_attr.battery_voltage),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_PERCENTAGE_REMAINING_ID,
+        &light_attr.battery_percentage),
+};
+
+static const zb_attr_desc_t light_poll_control_attrs[] = {
+    ZB_DESC_CUSTOM_ATTR(
+        ZB_ZCL_ATTR_POLL_CONTROL_CHECKIN_INTERVAL_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE,
+        &light_attr.check_in_interval),
+    ZB_DESC_CUSTOM_ATTR(
+        ZB_ZCL_ATTR_POLL_CONTROL_LONG_POLL_INTERVAL_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        &light_attr.long_poll_interval),
+    ZB_DESC_CUSTOM_ATTR(
+        ZB_ZCL_ATTR_POLL_CONTROL_SHORT_POLL_INTERVAL_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        &light_attr.short_poll_interval),
+    ZB_DESC_CUSTOM_ATTR(
+        ZB_ZCL_ATTR_POLL_CONTROL_FAST_POLL_TIMEOUT_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE,
+        &light_attr.fast_poll_timeout),
+    ZB_DESC_CUSTOM_ATTR(
+        ZB_ZCL_ATTR_POLL_CONTROL_FAST_POLL_MAX_TIMEOUT_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        &light_attr.fast_poll_timeout_max),
+};
+
+/* OTA Upgrade client, the server is discovered. Not const: the client
+ * parameter, last, is built by the stack at start up. */
+static zb_attr_desc_t light_ota_attrs[] = {
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_ID, light_attr.ota_server_id),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_FILE_OFFSET_ID,
+        &light_attr.ota_file_offset),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_FILE_VERSION_ID,
+        &light_attr.ota_file_version),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_DOWNLOADED_FILE_VERSION_ID,
+        &light_attr.ota_downloaded_file_version),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_IMAGE_STATUS_ID,
+        &light_attr.ota_image_status),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_MANUFACTURE_ID,
+        &light_attr.ota_manufacturer),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_IMAGE_TYPE_ID, &light_attr.ota_image_type),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_MIN_BLOCK_REQUE_ID,
+        &light_attr.ota_min_block_period),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_ADDR_ID,
+        &light_attr.ota_server_addr),
+    ZB_DESC_ATTR(
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_ENDPOINT_ID,
+        &light_attr.ota_server_endpoint),
+    ZB_DESC_ATTR(ESP_ZB_ZCL_ATTR_OTA_UPGRADE_CLIENT_PARAMETER_ID, NULL),
+};
+
+/* Diagnostics cluster values, refreshed with the energy attributes */
+static struct
+{
+  zb_diag_counters_t counters;
+  uint16_t press_latency_p50_ms;
+  uint16_t press_latency_p90_ms;
+  uint16_t press_latency_p99_ms;
+  uint16_t press_latency_max_ms;
+  uint32_t press_count;
+  uint32_t wake_count;
+  uint32_t spurious_wake_count;
+  uint16_t awake_permille;
+} diag_attr;
+
+#define DIAG_ATTR(attr_id, attr_type, storage) \
+  ZB_DESC_CUSTOM_ATTR(                          \
+      attr_id, attr_type, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, storage)
+
+static const zb_attr_desc_t light_diagnostics_attrs[] = {
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_NUMBER_OF_RESETS_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.number_of_resets),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_MAC_RX_BCAST_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        &diag_attr.counters.mac_rx_bcast),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_MAC_TX_BCAST_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        &diag_attr.counters.mac_tx_bcast),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_MAC_RX_UCAST_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        &diag_attr.counters.mac_rx_ucast),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_MAC_TX_UCAST_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        &diag_attr.counters.mac_tx_ucast),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_MAC_TX_UCAST_RETRY_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.mac_tx_ucast_retry),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_MAC_TX_UCAST_FAIL_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.mac_tx_ucast_fail),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_APS_TX_BCAST_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.aps_tx_bcast),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_APS_TX_UCAST_SUCCESS_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.aps_tx_ucast_success),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_APS_TX_UCAST_RETRY_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.aps_tx_ucast_retry),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_APS_TX_UCAST_FAIL_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.aps_tx_ucast_fail),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_PACKET_BUFFER_ALLOCATE_FAILURES_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.packet_buffer_allocate_failures),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_AVERAGE_MAC_RETRY_PER_APS_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.average_mac_retry_per_aps),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_LAST_LQI_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U8,
+        &diag_attr.counters.last_lqi),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_LAST_RSSI_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_S8,
+        &diag_attr.counters.last_rssi),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_CUSTOM_ATTR_NWK_RETRY_OVERFLOW_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.nwk_retry_overflow),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_CUSTOM_ATTR_PHY_CCA_FAILURES_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.phy_cca_failures),
+    DIAG_ATTR(
+        ZB_ZCL_ATTR_DIAGNOSTICS_CUSTOM_ATTR_BCAST_TABLE_FULL_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.counters.bcast_table_full),
+    ZB_DESC_CUSTOM_ATTR(
+        HA_DIAGNOSTICS_ATTR_AVERAGE_CURRENT_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        &light_attr.average_current_ua),
+    DIAG_ATTR(
+        HA_DIAGNOSTICS_ATTR_REPORT_FRAMES_SAVED_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        &light_attr.report_frames_saved),
+    DIAG_ATTR(
+        HA_DIAGNOSTICS_ATTR_PRESS_LATENCY_P50_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.press_latency_p50_ms),
+    DIAG_ATTR(
+        HA_DIAGNOSTICS_ATTR_PRESS_LATENCY_P90_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.press_latency_p90_ms),
+    DIAG_ATTR(
+        HA_DIAGNOSTICS_ATTR_PRESS_LATENCY_P99_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.press_latency_p99_ms),
+    DIAG_ATTR(
+        HA_DIAGNOSTICS_ATTR_PRESS_LATENCY_MAX_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.press_latency_max_ms),
+    DIAG_ATTR(
+        HA_DIAGNOSTICS_ATTR_PRESS_COUNT_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        &diag_attr.press_count),
+    DIAG_ATTR(
+        HA_DIAGNOSTICS_ATTR_WAKE_COUNT_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        &diag_attr.wake_count),
+    DIAG_ATTR(
+        HA_DIAGNOSTICS_ATTR_SPURIOUS_WAKE_COUNT_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U32,
+        &diag_attr.spurious_wake_count),
+    DIAG_ATTR(
+        HA_DIAGNOSTICS_ATTR_AWAKE_PERMILLE_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        &diag_attr.awake_permille),
+};
+
+static const zb_cluster_desc_t light_clusters[] = {
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_BASIC,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        basic,
+        basic_attrs),
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        identify,
+        identify_attrs),
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_GROUPS,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        groups,
+        light_groups_attrs),
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_SCENES,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        scenes,
+        light_scenes_attrs),
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_ON_OFF,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        on_off,
+        light_on_off_attrs),
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        level,
+        light_level_attrs),
+#if LIGHT_DRIVER_HAS_COLOR
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_COLOR_CONTROL,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        color_control,
+        light_color_attrs),
+#endif
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        power_config,
+        light_power_config_attrs),
+    ZB_DESC_CUSTOM_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_POLL_CONTROL,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        light_poll_control_attrs),
+    ZB_DESC_CUSTOM_CLUSTER(
+        HA_DIAGNOSTICS_CLUSTER_ID,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        light_diagnostics_attrs),
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE,
+        ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+        ota,
+        light_ota_attrs),
+};
+
+/* last event of the button, one of switch_event_t. Read only without the
+ * reporting flag: each event is reported once by the application, the
+ * stack never adds a second frame for it. */
+static const zb_attr_desc_t switch_multistate_attrs[] = {
+    ZB_DESC_CUSTOM_ATTR(
+        HA_MULTISTATE_INPUT_ATTR_NUMBER_OF_STATES_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        &light_attr.button_states),
+    ZB_DESC_CUSTOM_ATTR(
+        HA_MULTISTATE_INPUT_ATTR_OUT_OF_SERVICE_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_BOOL,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        &light_attr.button_out_of_service),
+    ZB_DESC_CUSTOM_ATTR(
+        HA_MULTISTATE_INPUT_ATTR_PRESENT_VALUE_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_U16,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        &light_attr.button_event),
+    ZB_DESC_CUSTOM_ATTR(
+        HA_MULTISTATE_INPUT_ATTR_STATUS_FLAGS_ID,
+        ESP_ZB_ZCL_ATTR_TYPE_8BITMAP,
+        ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        &light_attr.button_status_flags),
+};
+
+/* one per gang, generated from button_func_pair */
+static const zb_cluster_desc_t switch_clusters[] = {
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_BASIC,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        basic,
+        basic_attrs),
+    ZB_DESC_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        identify,
+        identify_attrs),
+    ZB_DESC_CUSTOM_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_MULTI_INPUT,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        switch_multistate_attrs),
+    ZB_DESC_EMPTY_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_ON_OFF, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE, on_off),
+    ZB_DESC_EMPTY_CLUSTER(
+        ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY,
+        ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+        identify),
+};
+
+_Static_assert(
+    HA_GANG_ENDPOINT_BASE > HA_ONOFF_LIGHT_ENDPOINT &&
+        HA_GANG_ENDPOINT_BASE > HA_ONOFF_SWITCH_ENDPOINT,
+    "gang endpoints overlap the fixed endpoints");
+
+/* fixed endpoints, adding one is adding a line here */
+static const zb_endpoint_desc_t fixed_endpoint_desc[] = {
+    {
+        .endpoint = HA_ONOFF_LIGHT_ENDPOINT,
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+#if LIGHT_DRIVER_HAS_COLOR
+        .device_id = ESP_ZB_HA_COLOR_DIMMABLE_LIGHT_DEVICE_ID,
+#else
+        .device_id = ESP_ZB_HA_DIMMABLE_LIGHT_DEVICE_ID,
+#endif
+        .clusters = light_clusters,
+        .cluster_count = ZB_DESC_COUNT(light_clusters),
+    },
+};
+
+static zb_endpoint_desc_t
+    endpoint_desc[ZB_DESC_COUNT(fixed_endpoint_desc) + HA_MAX_GANGS];
+
+static uint8_t esp_zb_gang_endpoint(size_t gang)
+{
+  return gang ? HA_GANG_ENDPOINT_BASE + gang - 1 : HA_ONOFF_SWITCH_ENDPOINT;
+}
+
+/* gang a button belongs to */
+static uint8_t esp_zb_button_gang(uint32_t pin)
+{
+  for (size_t i = 0; i < PAIR_SIZE(button_func_pair); ++i)
+    if (button_func_pair[i].pin == pin)
+      return i;
+  return 0;
+}
+
+/* fixed endpoints followed by one switch endpoint per button, all the switch
+ * endpoints point at the same cluster table */
+static size_t esp_zb_endpoints_generate(void)
+{
+  size_t count = 0;
+  size_t gangs = PAIR_SIZE(button_func_pair);
+
+  if (gangs > HA_MAX_GANGS)
+  {
+    ESP_LOGW(
+        TAG, "Only %d gangs out of %d buttons", HA_MAX_GANGS, (int)gangs);
+    gangs = HA_MAX_GANGS;
+  }
+  for (size_t i = 0; i < ZB_DESC_COUNT(fixed_endpoint_desc); ++i)
+    endpoint_desc[count++] = fixed_endpoint_desc[i];
+  for (size_t i = 0; i < gangs; ++i)
+    endpoint_desc[count++] = (zb_endpoint_desc_t){
+        .endpoint = esp_zb_gang_endpoint(i),
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .device_id = ESP_ZB_HA_ON_OFF_SWITCH_DEVICE_ID,
+        .clusters = switch_clusters,
+        .cluster_count = ZB_DESC_COUNT(switch_clusters),
+    };
+  return count;
+}
+
+static const attr_report_desc_t energy_report = {
+    .endpoint = HA_ONOFF_LIGHT_ENDPOINT,
+    .cluster_id = HA_DIAGNOSTICS_CLUSTER_ID,
+    .attr_id = HA_DIAGNOSTICS_ATTR_AVERAGE_CURRENT_ID,
+    .value = &light_attr.average_current_ua,
+    .size = sizeof(light_attr.average_current_ua),
+    .min_interval_s = ENERGY_REPORT_MIN_INTERVAL_S,
+    .max_interval_s = ENERGY_REPORT_MAX_INTERVAL_S,
+    .change = ENERGY_REPORT_CHANGE_UA,
+};
+static int64_t energy_published_us;
 
+/* push every Diagnostics attribute from its storage */
+static void esp_zb_diagnostics_publish(void)
+{
+  const zb_diag_counters_t* c = &diag_attr.counters;
+
+  for (size_t i = 0; i < ZB_DESC_COUNT(light_diagnostics_attrs); ++i)
+    esp_zb_zcl_set_attribute_val(
+        HA_ONOFF_LIGHT_ENDPOINT,
+        HA_DIAGNOSTICS_CLUSTER_ID,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+        light_diagnostics_attrs[i].id,
+        light_diagnostics_attrs[i].value,
+        false);
+  ESP_LOGI(
+      TAG,
+      "Diagnostics: press latency %u/%u/%u ms (p50/p90/p99) over %" PRIu32
+      " presses, MAC %u retries %u failures, APS %u failures, %u CCA "
+      "failures, LQI %u",
+      diag_attr.press_latency_p50_ms,
+      diag_attr.press_latency_p90_ms,
+      diag_attr.press_latency_p99_ms,
+      diag_attr.press_count,
+      c->mac_tx_ucast_retry,
+      c->mac_tx_ucast_fail,
+      c->aps_tx_ucast_fail,
+      c->phy_cca_failures,
+      c->last_lqi);
+}
+
+/* application values now, stack counters once the stack copied them */
+static void esp_zb_diagnostics_collect(void)
+{
+  zb_diag_latency_t latency;
+  sleep_stats_t sleep;
+
+  zb_diag_latency_get(&latency);
+  diag_attr.press_latency_p50_ms = latency.p50_ms;
+  diag_attr.press_latency_p90_ms = latency.p90_ms;
+  diag_attr.press_latency_p99_ms = latency.p99_ms;
+  diag_attr.press_latency_max_ms = latency.max_ms;
+  diag_attr.press_count = latency.count;
+  sleep_stats_get(&sleep);
+  diag_attr.wake_count = 0;
+  diag_attr.spurious_wake_count = 0;
+  for (int i = 0; i < SLEEP_WAKE_COUNT; ++i)
+  {
+    diag_attr.wake_count += sleep.wakes[i];
+    diag_attr.spurious_wake_count += sleep.spurious[i];
+  }
+  if (zb_diag_sync(&diag_attr.counters, esp_zb_diagnostics_publish) != ESP_OK)
+    esp_zb_diagnostics_publish();
+}
+
+static void esp_zb_energy_publish(void)
+{
+  energy_model_stats_t stats;
+  battery_monitor_stats_t battery;
+  attr_report_stats_t reports;
+  poll_control_stats_t polls;
+  zb_conn_stats_t link;
+  ota_client_stats_t ota;
+  light_driver_stats_t light;
+  light_control_stats_t light_cmds;
+  light_power_stats_t light_supply;
+  int64_t now = esp_timer_get_time();
+
+  if (now - energy_published_us < ENERGY_PUBLISH_PERIOD_MS * 1000LL)
+    return;
+  energy_published_us = now;
+  energy_model_get_stats(&stats);
+  battery_monitor_get_stats(&battery);
+  light_attr.average_current_ua = stats.average_ua;
+  attr_report_update(&light_attr.average_current_ua);
+  ESP_LOGI(
+      TAG,
+      "Energy: %" PRIu32 " uA average, %" PRIu32 " uAh used, battery "
+      "sampling %" PRIu64 " us of %" PRIu64 " us awake",
+      stats.average_ua,
+      stats.consumed_uah,
+      battery.sample_time_us,
+      stats.time_us[ENERGY_STATE_CPU_ACTIVE]);
+  attr_report_get_stats(&reports);
+  light_attr.report_frames_saved = reports.frames_saved;
+  diag_attr.awake_permille =
+      stats.elapsed_us
+          ? stats.time_us[ENERGY_STATE_CPU_ACTIVE] * 1000 / stats.elapsed_us
+          : 0;
+  esp_zb_diagnostics_collect();
+  ESP_LOGI(
+      TAG,
+      "Reports: %" PRIu32 " on change, %" PRIu32 " periodic, %" PRIu32
+      " aligned, %" PRIu32 " events in %" PRIu32 " frames (%" PRIu32
+      " saved), sent on %" PRIu32 " of %" PRIu32 " wake ups",
+      reports.sent_change,
+      reports.sent_periodic,
+      reports.sent_aligned,
+      reports.sent_now,
+      reports.frames,
+      reports.frames_saved,
+      reports.active_passes,
+      reports.passes);
+  poll_control_get_stats(&polls);
+  ESP_LOGI(
+      TAG,
+      "Poll control: %" PRIu32 " check-ins, %" PRIu32 " responses, %" PRIu32
+      " fast poll windows (%" PRIu32 " stopped early) for %" PRIu64 " ms",
+      polls.check_ins,
+      polls.check_in_responses,
+      polls.fast_polls,
+      polls.fast_poll_stops,
+      polls.fast_poll_ms);
+  zb_conn_get_stats(&link);
+  ESP_LOGI(
+      TAG,
+      "Link: %s, %" PRIu64 " s joined, %" PRIu64 " s degraded, %" PRIu64
+      " s orphaned, %" PRIu64 " s rejoining, %" PRIu32 " parent losses, %"
+      PRIu32 " poll failures, %" PRIu32 " rejoins (%" PRIu32 " failed), %"
+      PRIu32 " link failures, last outage %" PRIu32 " ms, pace %u/%u",
+      zb_conn_state_to_string(link.state),
+      link.time_in_state_ms[ZB_CONN_STATE_JOINED] / 1000,
+      link.time_in_state_ms[ZB_CONN_STATE_DEGRADED] / 1000,
+      link.time_in_state_ms[ZB_CONN_STATE_ORPHANED] / 1000,
+      link.time_in_state_ms[ZB_CONN_STATE_REJOINING] / 1000,
+      link.parent_losses,
+      link.poll_failures,
+      link.rejoin_attempts,
+      link.rejoin_failures,
+      link.link_failures,
+      link.last_outage_ms,
+      link.pace,
+      ZB_CONN_PACE_UNIT);
+  light_driver_get_stats(&light);
+  if (light.updates)
+    ESP_LOGI(
+        TAG,
+        "Light: %" PRIu32 " updates, %" PRIu32 " us max in the callback "
+        "against %" PRIu32 " us max per refresh, %" PRIu32 " refreshes (%"
+        PRIu32 " coalesced, %" PRIu32 " failed)",
+        light.updates,
+        light.update_max_us,
+        light.refresh_max_us,
+        light.refreshes,
+        light.coalesced,
+        light.refresh_errors);
+  if (light.refreshes)
+    ESP_LOGI(
+        TAG,
+        "Strip: %d pixels, %" PRIu64 " us per refresh of which %" PRIu64
+        " us encoding %" PRIu64 " pixels, %" PRIu32 " unchanged frames "
+        "skipped, %" PRIu32 " refreshes held to the next tick",
+        CONFIG_EXAMPLE_STRIP_LED_NUMBER,
+        light.refresh_us / light.refreshes,
+        light.encode_us / light.refreshes,
+        light.pixels / light.refreshes,
+        light.unchanged,
+        light.tick_merges);
+  light_control_get_stats(&light_cmds);
+  if (light.transitions)
+    ESP_LOGI(
+        TAG,
+        "Light: %" PRIu32 " level and %" PRIu32 " color moves, %" PRIu32
+        " transitions in %" PRIu32 " timer frames",
+        light_cmds.level_moves,
+        light_cmds.color_moves,
+        light.transitions,
+        light.frames);
+  light_power_get_stats(&light_supply);
+  if (light.releases)
+    ESP_LOGI(
+        TAG,
+        "Light power: %" PRIu32 " releases (%" PRIu32 " sleeps busy), %"
+        PRIu32 " acquires in %" PRIu64 " us average, %" PRIu32
+        " us max, %" PRIu32 " us max added to sleep, supply off %" PRIu64
+        " s, %" PRIu32 " switch ons",
+        light.releases,
+        light.sleep_busy,
+        light.acquires,
+        light.acquires ? light.acquire_us / light.acquires : 0,
+        light.acquire_max_us,
+        light.sleep_path_max_us,
+        light_supply.off_us / 1000000,
+        light_supply.switch_ons);
+  ota_client_get_stats(&ota);
+  if (ota.transfers)
+    ESP_LOGI(
+        TAG,
+        "OTA: %" PRIu32 "/%" PRIu32 " bytes, %" PRIu32 " B/s, radio %" PRIu32
+        " ms/MB, awake %" PRIu32 " ms/MB, %" PRIu32 " transfers",
+        ota.offset,
+        ota.file_size,
+        ota.throughput_bps,
+        ota.radio_ms_per_mb,
+        ota.awake_ms_per_mb,
+        ota.transfers);
+}
+
+/* debounced press time of the event each gang has scheduled, taken in the
+ * switch task; 32 bits so the Zigbee task never reads it half written */
+static volatile uint32_t s_button_press_us[PAIR_SIZE(button_func_pair)];
+
+static void esp_zb_button_latency(uint8_t gang)
+{
+  zb_diag_latency_add(
+      (uint32_t)esp_timer_get_time() - s_button_press_us[gang]);
+}
+
+/* the gang in the high nibble, the event in the low one */
+#define ESP_ZB_BUTTON_EVENT_PARAM(gang, event) \
+  ((uint8_t)((gang) << 4 | (event)))
+_Static_assert(HA_MAX_GANGS <= 16, "gang of a button event in a nibble");
+
+/* alarm callback, one Report Attributes frame from the gang endpoint,
+ * nothing else */
+static void esp_zb_button_event(uint8_t param)
+{
+  static uint16_t value;
+  switch_event_t event = param & 0x0f;
+  attr_report_desc_t report = {
+      .endpoint = esp_zb_gang_endpoint(param >> 4),
+      .cluster_id = ESP_ZB_ZCL_CLUSTER_ID_MULTI_INPUT,
+      .attr_id = HA_MULTISTATE_INPUT_ATTR_PRESENT_VALUE_ID,
+      .value = &value,
+      .size = sizeof(value),
+  };
+
+  power_save_boost_acquire();
+  value = event;
+  ESP_LOGI(TAG, "Report event %d from endpoint %d", event, report.endpoint);
+  attr_report_now(&report);
+  esp_zb_button_latency(param >> 4);
+  power_save_boost_release();
+}
+
+/* alarm callback, the stack is only called from the Zigbee task */
+static void esp_zb_button_toggle(uint8_t gang)
+{
+  /* send on-off toggle command to remote device */
+  esp_zb_zcl_on_off_cmd_t cmd_req;
+  power_save_boost_acquire();
+  cmd_req.zcl_basic_cmd.dst_addr_u.addr_short = 0;
+  cmd_req.zcl_basic_cmd.dst_endpoint = 0;
+  cmd_req.zcl_basic_cmd.src_endpoint = esp_zb_gang_endpoint(gang);
+  cmd_req.address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT;
+  cmd_req.on_off_cmd_id = ESP_ZB_ZCL_CMD_ON_OFF_TOGGLE_ID;
+  // esp_zb_zcl_custom_cluster_cmd_req_t cmd_req;
+  // cmd_req.zcl_basic_cmd.src_endpoint = HA_ONOFF_SWITCH_ENDPOINT;
+  // cmd_req.address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT;
+  // cmd_req.cluster_id = ESP_ZB_ZCL_CLUSTER_ID_COMMISSIONING;
+  // cmd_req.custom_cmd_id = 0x34;
+  // cmd_req.data_type = ESP_ZB_ZCL_ATTR_TYPE_NULL;
+  ESP_LOGI(
+      TAG,
+      "Send 'on_off toggle' command from endpoint %d",
+      cmd_req.zcl_basic_cmd.src_endpoint);
+  // esp_zb_zcl_custom_cluster_cmd_req(&cmd_req);
+  esp_zb_zcl_on_off_cmd_req(&cmd_req);
+  energy_model_radio_tx(ENERGY_MODEL_ZCL_HEADER_BYTES);
+  esp_zb_button_latency(gang);
+  power_save_boost_release();
+}
+
+/* only schedules the frame, the boost is taken by the alarm callbacks */
 static void esp_zb_buttons_handler(switch_func_pair_t* button_func_pair)
 {
+  uint8_t gang = esp_zb_button_gang(button_func_pair->pin);
+
+  sleep_stats_note_work();
+  s_button_press_us[gang] = switch_driver_event_time_us();
   switch (button_func_pair->func)
   {
   case SWITCH_ONOFF_TOGGLE_CONTROL:
-  {
-    /* send on-off toggle command to remote device */
-    esp_zb_zcl_on_off_cmd_t cmd_req;
-    cmd_req.zcl_basic_cmd.dst_addr_u.addr_short = 0;
-    cmd_req.zcl_basic_cmd.dst_endpoint = 0;
-    cmd_req.zcl_basic_cmd.src_endpoint = HA_ONOFF_SWITCH_ENDPOINT;
-    cmd_req.address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT;
-    cmd_req.on_off_cmd_id = ESP_ZB_ZCL_CMD_ON_OFF_TOGGLE_ID;
-    // esp_zb_zcl_custom_cluster_cmd_req_t cmd_req;
-    // cmd_req.zcl_basic_cmd.src_endpoint = HA_ONOFF_SWITCH_ENDPOINT;
-    // cmd_req.address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT;
-    // cmd_req.cluster_id = ESP_ZB_ZCL_CLUSTER_ID_COMMISSIONING;
-    // cmd_req.custom_cmd_id = 0x34;
-    // cmd_req.data_type = ESP_ZB_ZCL_ATTR_TYPE_NULL;
-    ESP_EARLY_LOGI(TAG, "Send 'on_off toggle' command");
-    // esp_zb_zcl_custom_cluster_cmd_req(&cmd_req);
-    // esp_zb_zcl_on_off_cmd_req(&cmd_req);
-  }
-  break;
+    /* runs in the switch task, the frames go out from the Zigbee task */
+    esp_zb_scheduler_alarm(esp_zb_button_toggle, gang, 0);
+    break;
+  case SWITCH_EVENT_CONTROL:
+    esp_zb_scheduler_alarm(
+        esp_zb_button_event,
+        ESP_ZB_BUTTON_EVENT_PARAM(gang, switch_driver_event()),
+        0);
+    break;
   default:
     break;
   }
 }
 
-static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask)
+static void esp_zb_joined(void)
 {
-  ESP_ERROR_CHECK(esp_zb_bdb_start_top_level_commissioning(mode_mask));
+  zb_conn_joined();
+  ota_client_confirm();
 }
 
 void esp_zb_app_signal_handler(esp_zb_app_signal_t* signal_struct)
@@ -79,8 +876,15 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t* signal_struct)
   esp_err_t err_status = signal_struct->esp_err_status;
   esp_zb_app_signal_type_t sig_type = *p_sg_p;
   esp_zb_zdo_signal_leave_params_t* leave_params = NULL;
+  zb_zdo_signal_nlme_status_indication_params_t* nlme_params = NULL;
+  zb_zdo_device_unavailable_params_t* unavailable_params = NULL;
+  zb_zdo_signal_can_sleep_params_t* can_sleep_params = NULL;
+  esp_sleep_wakeup_cause_t wakeup_cause;
 
-  ESP_LOGI(
+  if (sig_type != ESP_ZB_COMMON_SIGNAL_CAN_SLEEP)
+    sleep_stats_note_work();
+  /* runs on every CAN_SLEEP, keep formatting off this path */
+  BINLOG(
       TAG,
       "ZDO signal: %s (0x%x), status: %s",
       esp_zb_zdo_signal_to_string(sig_type),
@@ -94,12 +898,9 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t* signal_struct)
     esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_INITIALIZATION);
     break;
   case ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START:
-  case ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT:
     if (err_status == ESP_OK)
     {
-      ESP_LOGI(TAG, "Start network steering");
-      esp_zb_bdb_start_top_level_commissioning(
-          ESP_ZB_BDB_MODE_NETWORK_STEERING);
+      zb_conn_rejoin_now();
     }
     else
     {
@@ -108,6 +909,13 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t* signal_struct)
           TAG, "Failed to initialize Zigbee stack (status: %d)", err_status);
     }
     break;
+  case ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT:
+    /* the stack rejoined with the network parameters stored in NVRAM */
+    if (err_status == ESP_OK)
+      esp_zb_joined();
+    else
+      zb_conn_join_failed(err_status);
+    break;
   case ESP_ZB_BDB_SIGNAL_STEERING:
     if (err_status == ESP_OK)
     {
@@ -128,33 +936,75 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t* signal_struct)
           extended_pan_id[0],
           esp_zb_get_pan_id(),
           esp_zb_get_current_channel());
+      esp_zb_joined();
     }
     else
     {
       ESP_LOGI(
           TAG, "Network steering was not successful (status: %d)", err_status);
-      esp_zb_scheduler_alarm(
-          (esp_zb_callback_t)bdb_start_top_level_commissioning_cb,
-          ESP_ZB_BDB_MODE_NETWORK_STEERING,
-          1000);
+      zb_conn_join_failed(err_status);
     }
     break;
+  case ESP_ZB_BDB_SIGNAL_TC_REJOIN_DONE:
+    if (err_status == ESP_OK)
+      esp_zb_joined();
+    else
+      zb_conn_join_failed(err_status);
+    break;
   case ESP_ZB_ZDO_SIGNAL_LEAVE:
     leave_params =
         (esp_zb_zdo_signal_leave_params_t*)esp_zb_app_signal_get_params(p_sg_p);
     if (leave_params->leave_type == ESP_ZB_NWK_LEAVE_TYPE_RESET)
     {
+      /* removed on purpose, searching again would only drain the battery
+       * and rejoin behind the user's back */
       ESP_LOGI(TAG, "Reset device");
+      zb_conn_removed();
+    }
+    else
+    {
+      zb_conn_parent_lost(true);
     }
     break;
+  case ESP_ZB_NLME_STATUS_INDICATION:
+    nlme_params = (zb_zdo_signal_nlme_status_indication_params_t*)
+        esp_zb_app_signal_get_params(p_sg_p);
+    zb_conn_nlme_status(nlme_params->nlme_status.status);
+    break;
+  case ESP_ZB_ZDO_DEVICE_UNAVAILABLE:
+    /* no MAC or APS ACK for a frame we sent */
+    unavailable_params = (zb_zdo_device_unavailable_params_t*)
+        esp_zb_app_signal_get_params(p_sg_p);
+    zb_conn_link_failed();
+    ota_client_link_failed(unavailable_params->short_addr);
+    break;
   case ESP_ZB_COMMON_SIGNAL_CAN_SLEEP:
-    ESP_ERROR_CHECK(
-        gpio_wakeup_enable(GPIO_INPUT_IO_TOGGLE_SWITCH, GPIO_INTR_LOW_LEVEL));
+    can_sleep_params =
+        (zb_zdo_signal_can_sleep_params_t*)esp_zb_app_signal_get_params(p_sg_p);
+    sleep_tuner_begin(can_sleep_params->sleep_tmo);
+    for (size_t i = 0; i < PAIR_SIZE(button_func_pair); ++i)
+      ESP_ERROR_CHECK(
+          gpio_wakeup_enable(button_func_pair[i].pin, GPIO_INTR_LOW_LEVEL));
+    sleep_stats_sleep_enter();
+    energy_model_sleep_enter();
+    light_driver_sleep_enter();
     esp_zb_sleep_now();
     // esp_light_sleep_start();
-    ESP_LOGI(TAG, "wake up cause %d", esp_sleep_get_wakeup_cause());
+    wakeup_cause = esp_sleep_get_wakeup_cause();
+    energy_model_sleep_exit(wakeup_cause);
+    sleep_stats_wake(wakeup_cause);
+    sleep_tuner_end(wakeup_cause);
+    battery_monitor_on_wake();
+    esp_zb_energy_publish();
+    if (zb_conn_get_state() == ZB_CONN_STATE_JOINED)
+    {
+      attr_report_on_wake();
+      poll_control_on_wake();
+    }
+    binlog_flush_if_attached();
 
-    if (esp_sleep_get_wakeup_cause() & ESP_SLEEP_WAKEUP_GPIO)
+    /* the wake up cause is a single source, not a mask */
+    if (wakeup_cause == ESP_SLEEP_WAKEUP_GPIO)
       check_gpio(button_func_pair, PAIR_SIZE(button_func_pair));
     break;
   default:
@@ -162,21 +1012,139 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t* signal_struct)
   }
 }
 
-static esp_err_t esp_zb_power_save_init(void)
+static void zb_attr_log(
+    const zcl_attr_src_t* src, uint16_t attr_id, const zcl_value_t* value)
 {
-  esp_err_t rc = ESP_OK;
-#ifdef CONFIG_PM_ENABLE
-  int cur_cpu_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
-  esp_pm_config_t pm_config = {
-    .max_freq_mhz = cur_cpu_freq_mhz,
-    .min_freq_mhz = cur_cpu_freq_mhz,
-#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
-    .light_sleep_enable = true
-#endif
+  char text[24];
+
+  switch (value->kind)
+  {
+  case ZCL_VALUE_BOOL:
+    snprintf(text, sizeof(text), "%s", value->v.b ? "true" : "false");
+    break;
+  case ZCL_VALUE_UNSIGNED:
+    snprintf(text, sizeof(text), "%" PRIu64, value->v.u);
+    break;
+  case ZCL_VALUE_SIGNED:
+    snprintf(text, sizeof(text), "%" PRId64, value->v.s);
+    break;
+  case ZCL_VALUE_FLOAT:
+    snprintf(text, sizeof(text), "%g", value->v.f);
+    break;
+  case ZCL_VALUE_DOUBLE:
+    snprintf(text, sizeof(text), "%g", value->v.d);
+    break;
+  case ZCL_VALUE_STRING:
+    snprintf(text, sizeof(text), "\"%.*s\"", value->len, value->data);
+    break;
+  case ZCL_VALUE_NULL:
+    snprintf(text, sizeof(text), "none");
+    break;
+  default:
+    snprintf(
+        text, sizeof(text), "%u elements, %u bytes", value->count, value->len);
+    break;
+  }
+  ESP_LOGI(
+      TAG,
+      "Attribute from 0x%04x endpoint %d: cluster(0x%x), attribute(0x%x), "
+      "type(0x%x), value %s",
+      src->short_addr,
+      src->src_endpoint,
+      src->cluster_id,
+      attr_id,
+      value->type,
+      text);
+}
+
+static void zb_on_off_report(
+    const zcl_attr_src_t* src, uint16_t attr_id, const zcl_value_t* value)
+{
+  ESP_RETURN_ON_FALSE(
+      value->kind == ZCL_VALUE_BOOL, , TAG, "on/off type 0x%x", value->type);
+  ESP_LOGI(
+      TAG,
+      "Light 0x%04x endpoint %d bound to endpoint %d is %s",
+      src->short_addr,
+      src->src_endpoint,
+      src->dst_endpoint,
+      value->v.b ? "on" : "off");
+}
+
+/* compile-time (cluster, attribute) to handler table, first match wins,
+ * attributes without a route are logged */
+static const zcl_attr_route_t zb_attr_routes[] = {
+    {ESP_ZB_ZCL_CLUSTER_ID_ON_OFF,
+     ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID,
+     zb_on_off_report},
+};
+
+/* Report Attributes and Read Attributes Response frames are decoded here,
+ * the action callbacks only get their first attribute */
+static void zb_attr_frame_dispatch(uint8_t bufid)
+{
+  const zb_zcl_parsed_hdr_t* cmd_info =
+      ZB_BUF_GET_PARAM(bufid, zb_zcl_parsed_hdr_t);
+  zcl_record_iter_t it;
+  zcl_attr_record_t record;
+
+  if (!cmd_info->is_common_command ||
+      (cmd_info->cmd_id != ZB_ZCL_CMD_REPORT_ATTRIB &&
+       cmd_info->cmd_id != ZB_ZCL_CMD_READ_ATTRIB_RESP))
+    return;
+
+  zcl_attr_src_t src = {
+      .short_addr =
+          ZB_ZCL_PARSED_HDR_SHORT_DATA(cmd_info).source.u.short_addr,
+      .src_endpoint = ZB_ZCL_PARSED_HDR_SHORT_DATA(cmd_info).src_endpoint,
+      .dst_endpoint = ZB_ZCL_PARSED_HDR_SHORT_DATA(cmd_info).dst_endpoint,
+      .cluster_id = cmd_info->cluster_id,
   };
-  rc = esp_pm_configure(&pm_config);
-#endif
-  return rc;
+  /* the ZCL header is already cut, the buffer holds the records */
+  zcl_records_init(
+      &it,
+      zb_buf_begin(bufid),
+      zb_buf_len(bufid),
+      cmd_info->cmd_id == ZB_ZCL_CMD_READ_ATTRIB_RESP);
+  while (zcl_records_next(&it, &record))
+  {
+    if (record.status != ESP_ZB_ZCL_STATUS_SUCCESS)
+    {
+      ESP_LOGW(
+          TAG,
+          "Read of cluster(0x%x) attribute(0x%x) failed: status(%d)",
+          src.cluster_id,
+          record.attr_id,
+          record.status);
+      continue;
+    }
+    zcl_attr_handler_t handler = zcl_route_find(
+        zb_attr_routes,
+        ZB_DESC_COUNT(zb_attr_routes),
+        src.cluster_id,
+        record.attr_id);
+    (handler ? handler : zb_attr_log)(&src, record.attr_id, &record.value);
+  }
+  if (it.error)
+    ESP_LOGW(
+        TAG,
+        "Malformed attribute frame from 0x%04x cluster(0x%x)",
+        src.short_addr,
+        src.cluster_id);
+}
+
+static esp_err_t zb_attribute_handler(
+    const esp_zb_zcl_set_attr_value_message_t* message)
+{
+  ESP_RETURN_ON_FALSE(message, ESP_FAIL, TAG, "Empty message");
+  ESP_RETURN_ON_FALSE(
+      message->info.status == ESP_ZB_ZCL_STATUS_SUCCESS,
+      ESP_ERR_INVALID_ARG,
+      TAG,
+      "Received message: error status(%d)",
+      message->info.status);
+  light_control_attr(message);
+  return ESP_OK;
 }
 
 static esp_err_t zb_attribute_reporting_handler(
@@ -189,21 +1157,7 @@ static esp_err_t zb_attribute_reporting_handler(
       TAG,
       "Received message: error status(%d)",
       message->status);
-  ESP_LOGI(
-      TAG,
-      "Reveived report from address(0x%x) src endpoint(%d) to dst endpoint(%d) "
-      "cluster(0x%x)",
-      message->src_address.u.short_addr,
-      message->src_endpoint,
-      message->dst_endpoint,
-      message->cluster);
-  ESP_LOGI(
-      TAG,
-      "Received report information: attribute(0x%x), type(0x%x), value(%d)\n",
-      message->attribute.id,
-      message->attribute.data.type,
-      message->attribute.data.value ? *(uint8_t*)message->attribute.data.value
-                                    : 0);
+  /* already dispatched from zb_raw_command_handler() */
   return ESP_OK;
 }
 
@@ -217,16 +1171,7 @@ static esp_err_t zb_read_attr_resp_handler(
       TAG,
       "Received message: error status(%d)",
       message->info.status);
-  ESP_LOGI(
-      TAG,
-      "Read attribute response: status(%d), cluster(0x%x), attribute(0x%x), "
-      "type(0x%x), value(%d)",
-      message->info.status,
-      message->info.cluster,
-      message->attribute.id,
-      message->attribute.data.type,
-      message->attribute.data.value ? *(uint8_t*)message->attribute.data.value
-                                    : 0);
+  /* already dispatched from zb_raw_command_handler() */
   return ESP_OK;
 }
 
@@ -253,8 +1198,14 @@ static esp_err_t zb_action_handler(
     esp_zb_core_action_callback_id_t callback_id, const void* message)
 {
   esp_err_t ret = ESP_OK;
+  power_save_boost_acquire();
+  sleep_stats_note_work();
   switch (callback_id)
   {
+  case ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID:
+    ret = zb_attribute_handler(
+        (esp_zb_zcl_set_attr_value_message_t*)message);
+    break;
   case ESP_ZB_CORE_REPORT_ATTR_CB_ID:
     ret = zb_attribute_reporting_handler(
         (esp_zb_zcl_report_attr_message_t*)message);
@@ -263,6 +1214,10 @@ static esp_err_t zb_action_handler(
     ret = zb_read_attr_resp_handler(
         (esp_zb_zcl_cmd_read_attr_resp_message_t*)message);
     break;
+  case ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID:
+    ret = ota_client_status(
+        ((esp_zb_zcl_ota_update_message_t*)message)->update_status);
+    break;
   case ESP_ZB_CORE_CMD_REPORT_CONFIG_RESP_CB_ID:
     ret = zb_configure_report_resp_handler(
         (esp_zb_zcl_cmd_config_report_resp_message_t*)message);
@@ -271,9 +1226,29 @@ static esp_err_t zb_action_handler(
     ESP_LOGW(TAG, "Receive Zigbee action(0x%x) callback", callback_id);
     break;
   }
+  power_save_boost_release();
   return ret;
 }
 
+static bool zb_raw_command_handler(uint8_t bufid)
+{
+  bool handled;
+  bool ota;
+
+  power_save_boost_acquire();
+  energy_model_radio_rx(zb_buf_len(bufid));
+  zb_attr_frame_dispatch(bufid);
+  ota = ota_client_observe(bufid);
+  /* Poll Control and the light transitions are served here, the rest is
+   * only observed and left to the stack */
+  handled = poll_control_handle(bufid) || light_control_handle(bufid);
+  /* consumed here, these never reach zb_action_handler() */
+  if (ota || handled)
+    sleep_stats_note_work();
+  power_save_boost_release();
+  return handled;
+}
+
 static void esp_zb_task(void* pvParameters)
 {
   /* initialize Zigbee stack */
@@ -282,75 +1257,29 @@ static void esp_zb_task(void* pvParameters)
   esp_zb_sleep_enable(true);
   ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
   esp_zb_init(&zb_nwk_cfg);
+  zb_conn_init();
+  poll_control_init(HA_ONOFF_LIGHT_ENDPOINT);
+  light_control_init(HA_ONOFF_LIGHT_ENDPOINT);
+  if (ota_client_init(HA_ONOFF_LIGHT_ENDPOINT) != ESP_OK)
+    ESP_LOGW(TAG, "OTA upgrades unavailable");
+  light_ota_attrs[ZB_DESC_COUNT(light_ota_attrs) - 1].value =
+      ota_client_parameter(HA_OTA_HW_VERSION);
+  if (battery_monitor_init(HA_ONOFF_LIGHT_ENDPOINT) != ESP_OK)
+    ESP_LOGW(TAG, "Battery monitor unavailable");
+  ESP_ERROR_CHECK(attr_report_add(&energy_report));
   //   esp_zb_ieee_addr_t addr = {0x00, 0x00, 0x51, 0x09, 0x00, 0x00, 0x00,
   //   0x00}; esp_zb_set_long_address(addr);
-  uint8_t test_attr;
-  test_attr = 0;
-  /* basic cluster create with fully customized */
-  esp_zb_attribute_list_t* esp_zb_basic_cluster =
-      esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_BASIC);
-  esp_zb_basic_cluster_add_attr(
-      esp_zb_basic_cluster, ESP_ZB_ZCL_ATTR_BASIC_ZCL_VERSION_ID, &test_attr);
-  esp_zb_basic_cluster_add_attr(
-      esp_zb_basic_cluster, ESP_ZB_ZCL_ATTR_BASIC_POWER_SOURCE_ID, &test_attr);
-  esp_zb_cluster_update_attr(
-      esp_zb_basic_cluster, ESP_ZB_ZCL_ATTR_BASIC_ZCL_VERSION_ID, &test_attr);
-  esp_zb_basic_cluster_add_attr(
-      esp_zb_basic_cluster,
-      ESP_ZB_ZCL_ATTR_BASIC_MODEL_IDENTIFIER_ID,
-      &modelid[0]);
-  esp_zb_basic_cluster_add_attr(
-      esp_zb_basic_cluster,
-      ESP_ZB_ZCL_ATTR_BASIC_MANUFACTURER_NAME_ID,
-      &manufname[0]);
-  /* identify cluster create with fully customized */
-  esp_zb_attribute_list_t* esp_zb_identify_cluster =
-      esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY);
-  esp_zb_identify_cluster_add_attr(
-      esp_zb_identify_cluster,
-      ESP_ZB_ZCL_ATTR_IDENTIFY_IDENTIFY_TIME_ID,
-      &test_attr);
-  /* create client role of the cluster */
-  esp_zb_attribute_list_t* esp_zb_on_off_client_cluster =
-      esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_ON_OFF);
-  esp_zb_attribute_list_t* esp_zb_identify_client_cluster =
-      esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY);
-  /* create cluster lists for this endpoint */
-  esp_zb_cluster_list_t* esp_zb_cluster_list = esp_zb_zcl_cluster_list_create();
-  esp_zb_cluster_list_add_basic_cluster(
-      esp_zb_cluster_list,
-      esp_zb_basic_cluster,
-      ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
-  esp_zb_cluster_list_add_identify_cluster(
-      esp_zb_cluster_list,
-      esp_zb_identify_cluster,
-      ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
-  esp_zb_cluster_list_add_on_off_cluster(
-      esp_zb_cluster_list,
-      esp_zb_on_off_client_cluster,
-      ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
-  esp_zb_cluster_list_add_identify_cluster(
-      esp_zb_cluster_list,
-      esp_zb_identify_client_cluster,
-      ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
-
-  esp_zb_ep_list_t* esp_zb_ep_list = esp_zb_ep_list_create();
-  esp_zb_ep_list_add_ep(
-      esp_zb_ep_list,
-      esp_zb_cluster_list,
-      HA_ONOFF_SWITCH_ENDPOINT,
-      ESP_ZB_AF_HA_PROFILE_ID,
-      ESP_ZB_HA_ON_OFF_SWITCH_DEVICE_ID);
-  // esp_zb_device_register(esp_zb_ep_list);
-
-  esp_zb_on_off_light_cfg_t light_cfg = ESP_ZB_DEFAULT_ON_OFF_LIGHT_CONFIG();
-  esp_zb_ep_list_t* esp_zb_on_off_light_ep =
-      esp_zb_on_off_light_ep_create(2, &light_cfg);
-  esp_zb_device_register(esp_zb_on_off_light_ep);
+  esp_zb_ep_list_t* esp_zb_ep_list = NULL;
+  ESP_ERROR_CHECK(zb_desc_build(
+      endpoint_desc, esp_zb_endpoints_generate(), &esp_zb_ep_list));
+  esp_zb_device_register(esp_zb_ep_list);
+  zb_arena_log_heap("registered");
   esp_zb_core_action_handler_register(zb_action_handler);
+  esp_zb_raw_command_handler_register(zb_raw_command_handler);
   esp_zb_set_primary_network_channel_set(ESP_ZB_PRIMARY_CHANNEL_MASK);
   // esp_zb_set_secondary_network_channel_set(ESP_ZB_SECONDARY_CHANNEL_MASK);
   ESP_ERROR_CHECK(esp_zb_start(false));
+  zb_arena_log_heap("started");
   esp_zb_main_loop_iteration();
 }
 
@@ -360,12 +1289,19 @@ void app_main(void)
       .radio_config = ESP_ZB_DEFAULT_RADIO_CONFIG(),
       .host_config = ESP_ZB_DEFAULT_HOST_CONFIG(),
   };
+  zb_arena_log_heap("boot");
   ESP_ERROR_CHECK(nvs_flash_init());
+  energy_model_init();
   /* esp zigbee light sleep initialization*/
-  ESP_ERROR_CHECK(esp_zb_power_save_init());
+  ESP_ERROR_CHECK(power_save_init());
   ESP_ERROR_CHECK(esp_zb_platform_config(&config));
   switch_driver_init(
       button_func_pair, PAIR_SIZE(button_func_pair), esp_zb_buttons_handler);
+  if (light_driver_init(light_attr.on_off, light_attr.current_level) !=
+      ESP_OK)
+    ESP_LOGW(TAG, "Light driver unavailable");
+  if (binlog_console_init() != ESP_OK)
+    ESP_LOGW(TAG, "Console unavailable");
 
   xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, NULL);
 }
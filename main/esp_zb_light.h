@@ -21,6 +21,47 @@
 #define ED_AGING_TIMEOUT ESP_ZB_ED_AGING_TIMEOUT_64MIN
 #define ED_KEEP_ALIVE 40000        /* 3000 millisecond */
 #define HA_ONOFF_SWITCH_ENDPOINT 1 /* esp switch device endpoint */
+#define HA_ONOFF_LIGHT_ENDPOINT 2  /* esp light device endpoint */
+/* endpoints of the extra gangs, the first button uses the switch endpoint */
+#define HA_GANG_ENDPOINT_BASE 10
+#define HA_MAX_GANGS 8
+/* what the buttons do: SWITCH_EVENT_CONTROL reports single, double, long
+ * and release events through a Multistate Input server per gang, with no
+ * On/Off command; SWITCH_ONOFF_TOGGLE_CONTROL sends bound toggles */
+#define HA_BUTTON_FUNC SWITCH_EVENT_CONTROL
+/* Multistate Input (basic) attributes, no API in esp-zigbee-lib */
+#define HA_MULTISTATE_INPUT_ATTR_NUMBER_OF_STATES_ID 0x004a
+#define HA_MULTISTATE_INPUT_ATTR_OUT_OF_SERVICE_ID 0x0051
+#define HA_MULTISTATE_INPUT_ATTR_PRESENT_VALUE_ID 0x0055
+#define HA_MULTISTATE_INPUT_ATTR_STATUS_FLAGS_ID 0x006f
+/* Diagnostics cluster, no dedicated API in esp-zigbee-lib */
+#define HA_DIAGNOSTICS_CLUSTER_ID 0x0b05
+/* manufacturer specific attributes, above the ZBOSS counters 0xff00-0xff02 */
+/* average current estimated by the energy model, uA */
+#define HA_DIAGNOSTICS_ATTR_AVERAGE_CURRENT_ID 0xff10
+/* attribute reports that shared a frame */
+#define HA_DIAGNOSTICS_ATTR_REPORT_FRAMES_SAVED_ID 0xff11
+/* button event to command handed to the stack, ms over the last presses */
+#define HA_DIAGNOSTICS_ATTR_PRESS_LATENCY_P50_ID 0xff12
+#define HA_DIAGNOSTICS_ATTR_PRESS_LATENCY_P90_ID 0xff13
+#define HA_DIAGNOSTICS_ATTR_PRESS_LATENCY_P99_ID 0xff14
+#define HA_DIAGNOSTICS_ATTR_PRESS_LATENCY_MAX_ID 0xff15
+#define HA_DIAGNOSTICS_ATTR_PRESS_COUNT_ID 0xff16
+/* light sleep wake ups, and those that found nothing to do */
+#define HA_DIAGNOSTICS_ATTR_WAKE_COUNT_ID 0xff17
+#define HA_DIAGNOSTICS_ATTR_SPURIOUS_WAKE_COUNT_ID 0xff18
+/* share of the time spent awake, per mille */
+#define HA_DIAGNOSTICS_ATTR_AWAKE_PERMILLE_ID 0xff19
+/* OTA file identity, the server only offers files that match */
+#define HA_OTA_MANUFACTURER_CODE ESP_ZB_OTA_UPGRADE_MANUFACTURER_CODE_DEF_VALUE
+#define HA_OTA_IMAGE_TYPE 0x1011
+#define HA_OTA_FILE_VERSION 0x00000001 /* running firmware, bump per file */
+#define HA_OTA_HW_VERSION 0x0001
+#define ENERGY_PUBLISH_PERIOD_MS 60000 /* energy attributes refresh */
+/* reporting of the average current: 20 uA change, every 1 to 60 min */
+#define ENERGY_REPORT_CHANGE_UA 20
+#define ENERGY_REPORT_MIN_INTERVAL_S 60
+#define ENERGY_REPORT_MAX_INTERVAL_S 3600
 #define ESP_ZB_PRIMARY_CHANNEL_MASK ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK
 #define ESP_ZB_SECONDARY_CHANNEL_MASK \
   (1l << 13) /* Zigbee primary channel mask use in the example */
@@ -0,0 +1,219 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * On/Off, Level Control and Color Control servers driving the light
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "light_control.h"
+#include <inttypes.h>
+#include "esp_log.h"
+#include "light_driver.h"
+#include "zboss_api.h"
+#include "zcl/zb_zcl_color_control.h"
+#include "zcl/zb_zcl_level_control.h"
+
+/* transition time field asking for the OnOffTransitionTime attribute,
+ * which is not served: no fade */
+#define LIGHT_CONTROL_TRANSITION_DEFAULT 0xffff
+
+static const char* TAG = "light_control";
+
+static uint8_t s_endpoint;
+static light_control_stats_t s_stats;
+
+static uint16_t light_control_transition(uint16_t transition_ds)
+{
+  return transition_ds == LIGHT_CONTROL_TRANSITION_DEFAULT ? 0
+                                                           : transition_ds;
+}
+
+/* value held by the stack */
+static const void* light_control_attr_value(
+    uint16_t cluster_id, uint16_t attr_id)
+{
+  zb_zcl_attr_t* attr = zb_zcl_get_attr_desc_a(
+      s_endpoint, cluster_id, ZB_ZCL_CLUSTER_SERVER_ROLE, attr_id);
+
+  return attr ? attr->data_p : NULL;
+}
+
+static void light_control_set(
+    uint16_t cluster_id, uint16_t attr_id, void* value)
+{
+  esp_zb_zcl_set_attribute_val(
+      s_endpoint,
+      cluster_id,
+      ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+      attr_id,
+      value,
+      false);
+}
+
+/* one coordinate changed by the stack, the callback may come before the
+ * stack stores it */
+static void light_control_color(uint16_t attr_id, uint16_t value)
+{
+  const uint16_t* x = light_control_attr_value(
+      ESP_ZB_ZCL_CLUSTER_ID_COLOR_CONTROL,
+      ESP_ZB_ZCL_ATTR_COLOR_CONTROL_CURRENT_X_ID);
+  const uint16_t* y = light_control_attr_value(
+      ESP_ZB_ZCL_CLUSTER_ID_COLOR_CONTROL,
+      ESP_ZB_ZCL_ATTR_COLOR_CONTROL_CURRENT_Y_ID);
+
+  if (!x || !y)
+    return;
+  if (attr_id == ESP_ZB_ZCL_ATTR_COLOR_CONTROL_CURRENT_X_ID)
+    light_driver_set_color_xy(value, *y, 0);
+  else
+    light_driver_set_color_xy(*x, value, 0);
+}
+
+static zb_uint8_t light_control_move_to_level(
+    zb_bufid_t bufid, bool with_on_off)
+{
+  zb_zcl_level_control_move_to_level_req_t req;
+  zb_bool_t parsed;
+  uint16_t transition_ds;
+
+  ZB_ZCL_LEVEL_CONTROL_GET_MOVE_TO_LEVEL_REQ(bufid, req, parsed);
+  if (!parsed)
+    return ZB_ZCL_STATUS_MALFORMED_CMD;
+  if (req.level > LIGHT_LEVEL_MAX)
+    return ZB_ZCL_STATUS_INVALID_VALUE;
+  transition_ds = light_control_transition(req.transition_time);
+  /* the attributes take the target at once, the light fades to it */
+  light_control_set(
+      ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL,
+      ESP_ZB_ZCL_ATTR_LEVEL_CONTROL_CURRENT_LEVEL_ID,
+      &req.level);
+  light_driver_set_level(req.level, transition_ds);
+  if (with_on_off)
+  {
+    bool on = req.level > LIGHT_CONTROL_LEVEL_MIN;
+    light_control_set(
+        ESP_ZB_ZCL_CLUSTER_ID_ON_OFF, ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, &on);
+    light_driver_set_power(on, transition_ds);
+  }
+  ++s_stats.level_moves;
+  ESP_LOGI(
+      TAG,
+      "Level %d in %d ds%s",
+      req.level,
+      transition_ds,
+      with_on_off ? " with on/off" : "");
+  return ZB_ZCL_STATUS_SUCCESS;
+}
+
+static zb_uint8_t light_control_move_to_color(zb_bufid_t bufid)
+{
+  zb_zcl_color_control_move_to_color_req_t req;
+  zb_zcl_parse_status_t parsed;
+  uint8_t mode = ESP_ZB_ZCL_COLOR_CONTROL_COLOR_MODE_DEFAULT_VALUE;
+
+  ZB_ZCL_COLOR_CONTROL_GET_MOVE_TO_COLOR_REQ(bufid, req, parsed);
+  if (parsed != ZB_ZCL_PARSE_STATUS_SUCCESS)
+    return ZB_ZCL_STATUS_MALFORMED_CMD;
+  light_control_set(
+      ESP_ZB_ZCL_CLUSTER_ID_COLOR_CONTROL,
+      ESP_ZB_ZCL_ATTR_COLOR_CONTROL_CURRENT_X_ID,
+      &req.color_x);
+  light_control_set(
+      ESP_ZB_ZCL_CLUSTER_ID_COLOR_CONTROL,
+      ESP_ZB_ZCL_ATTR_COLOR_CONTROL_CURRENT_Y_ID,
+      &req.color_y);
+  light_control_set(
+      ESP_ZB_ZCL_CLUSTER_ID_COLOR_CONTROL,
+      ESP_ZB_ZCL_ATTR_COLOR_CONTROL_COLOR_MODE_ID,
+      &mode);
+  light_driver_set_color_xy(
+      req.color_x, req.color_y, light_control_transition(req.transition_time));
+  ++s_stats.color_moves;
+  ESP_LOGI(
+      TAG,
+      "Color x 0x%04x y 0x%04x in %d ds",
+      req.color_x,
+      req.color_y,
+      light_control_transition(req.transition_time));
+  return ZB_ZCL_STATUS_SUCCESS;
+}
+
+void light_control_init(uint8_t endpoint)
+{
+  s_endpoint = endpoint;
+}
+
+bool light_control_handle(uint8_t bufid)
+{
+  /* copied, the buffer is reused by the default response */
+  zb_zcl_parsed_hdr_t cmd_info = *ZB_BUF_GET_PARAM(bufid, zb_zcl_parsed_hdr_t);
+  zb_uint8_t status;
+
+  if (cmd_info.is_common_command ||
+      cmd_info.cmd_direction != ZB_ZCL_FRAME_DIRECTION_TO_SRV ||
+      ZB_ZCL_PARSED_HDR_SHORT_DATA(&cmd_info).dst_endpoint != s_endpoint)
+    return false;
+
+  if (cmd_info.cluster_id == ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL &&
+      (cmd_info.cmd_id == ZB_ZCL_CMD_LEVEL_CONTROL_MOVE_TO_LEVEL ||
+       cmd_info.cmd_id == ZB_ZCL_CMD_LEVEL_CONTROL_MOVE_TO_LEVEL_WITH_ON_OFF))
+    status = light_control_move_to_level(
+        bufid,
+        cmd_info.cmd_id == ZB_ZCL_CMD_LEVEL_CONTROL_MOVE_TO_LEVEL_WITH_ON_OFF);
+  else if (
+      LIGHT_DRIVER_HAS_COLOR &&
+      cmd_info.cluster_id == ZB_ZCL_CLUSTER_ID_COLOR_CONTROL &&
+      cmd_info.cmd_id == ZB_ZCL_CMD_COLOR_CONTROL_MOVE_TO_COLOR)
+    status = light_control_move_to_color(bufid);
+  else
+    return false;
+  ZB_ZCL_PROCESS_COMMAND_FINISH(bufid, &cmd_info, status);
+  return true;
+}
+
+void light_control_attr(const esp_zb_zcl_set_attr_value_message_t* message)
+{
+  const esp_zb_zcl_attribute_t* attr = &message->attribute;
+
+  if (message->info.dst_endpoint != s_endpoint || !attr->data.value)
+    return;
+  switch (message->info.cluster)
+  {
+  case ESP_ZB_ZCL_CLUSTER_ID_ON_OFF:
+    if (attr->id != ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID ||
+        attr->data.type != ESP_ZB_ZCL_ATTR_TYPE_BOOL)
+      return;
+    ESP_LOGI(
+        TAG, "Light sets to %s", *(const bool*)attr->data.value ? "On" : "Off");
+    light_driver_set_power(*(const bool*)attr->data.value, 0);
+    break;
+  case ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL:
+    /* Move, Step and Stop, stepped by the stack */
+    if (attr->id != ESP_ZB_ZCL_ATTR_LEVEL_CONTROL_CURRENT_LEVEL_ID ||
+        attr->data.type != ESP_ZB_ZCL_ATTR_TYPE_U8)
+      return;
+    light_driver_set_level(*(const uint8_t*)attr->data.value, 0);
+    break;
+  case ESP_ZB_ZCL_CLUSTER_ID_COLOR_CONTROL:
+    if ((attr->id != ESP_ZB_ZCL_ATTR_COLOR_CONTROL_CURRENT_X_ID &&
+         attr->id != ESP_ZB_ZCL_ATTR_COLOR_CONTROL_CURRENT_Y_ID) ||
+        attr->data.type != ESP_ZB_ZCL_ATTR_TYPE_U16)
+      return;
+    light_control_color(attr->id, *(const uint16_t*)attr->data.value);
+    break;
+  default:
+    return;
+  }
+  ++s_stats.attr_changes;
+}
+
+void light_control_get_stats(light_control_stats_t* stats)
+{
+  *stats = s_stats;
+}
@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * On/Off, Level Control and Color Control servers driving the light
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_zigbee_core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Move to Level with On/Off to this level or below turns the light off */
+#define LIGHT_CONTROL_LEVEL_MIN 1
+
+  typedef struct
+  {
+    uint32_t level_moves; /* Move to Level, with On/Off or not */
+    uint32_t color_moves; /* Move to Color */
+    uint32_t attr_changes; /* set by the stack, applied without fade */
+  } light_control_stats_t;
+
+  /**
+   * @brief Drive the light from the clusters of an endpoint
+   *
+   * The clusters and their attributes are built by the application.
+   */
+  void light_control_init(uint8_t endpoint);
+
+  /**
+   * @brief Handle Move to Level (with On/Off) and Move to Color, call from
+   * the raw command handler
+   *
+   * These carry a transition time the light fades over by itself, instead
+   * of the stack stepping the attribute.
+   *
+   * @return true if the command was consumed, the buffer is then released.
+   */
+  bool light_control_handle(uint8_t bufid);
+
+  /**
+   * @brief Apply an attribute the stack changed, from its set attribute
+   * value callback
+   */
+  void light_control_attr(const esp_zb_zcl_set_attr_value_message_t* message);
+
+  void light_control_get_stats(light_control_stats_t* stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
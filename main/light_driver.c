@@ -35,28 +35,416 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "light_driver.h"
+
+#ifdef CONFIG_LIGHT_DRIVER_BACKEND_STRIP
+
+#include "driver/gpio.h"
+#include "esp_check.h"
 #include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "led_strip.h"
-#include "light_driver.h"
+#include "light_fb.h"
+#include "light_power.h"
+#include "light_transition.h"
+#include "power_save.h"
+#include "soc/soc_caps.h"
+
+static const char* TAG = "light_driver";
 
+typedef struct
+{
+  bool power;
+  uint8_t level;
+  uint16_t rgb[3]; /* linear */
+  uint16_t transition_ds;
+} light_driver_request_t;
+
+static const led_strip_config_t s_strip_config = {
+    .max_leds = CONFIG_EXAMPLE_STRIP_LED_NUMBER,
+    .strip_gpio_num = CONFIG_EXAMPLE_STRIP_LED_GPIO,
+};
+static const led_strip_rmt_config_t s_rmt_config = {
+    .resolution_hz = 10 * 1000 * 1000, // 10MHz
+};
+
+/* NULL while released: the light is dark, or the chip sleeps */
 static led_strip_handle_t s_led_strip;
-static uint8_t s_red = 255, s_green = 255, s_blue = 255;
+static uint8_t
+    s_pixels[CONFIG_EXAMPLE_STRIP_LED_NUMBER * LIGHT_FB_BYTES_PER_PIXEL];
+static light_fb_t s_fb;
+static TaskHandle_t s_refresh_task;
+/* only runs while a transition does, so the CPU sleeps between changes */
+static esp_timer_handle_t s_frame_timer;
+/* the state asked for, handed from the callers to the refresh task */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static light_driver_request_t s_request = {
+    .rgb = {0xffff, 0xffff, 0xffff},
+};
+static bool s_dirty;
+/* set by the refresh task while it works, the strip is only released for
+ * sleep when it is not */
+static bool s_busy;
+#if SOC_PM_SUPPORT_TOP_PD
+/* peripherals kept powered in sleep by the Zigbee task */
+static bool s_keep_peripherals;
+#endif
+/* owned by the refresh task */
+static bool s_lit;
+static light_transition_t s_transition;
+static TickType_t s_refresh_tick;
+static light_driver_stats_t s_stats;
+
+static uint16_t light_driver_level(const light_driver_request_t* request)
+{
+  if (!request->power)
+    return 0;
+  if (request->level >= LIGHT_LEVEL_MAX)
+    return 0xff00;
+  return request->level * 0xff00 / LIGHT_LEVEL_MAX;
+}
+
+/* a new RMT channel, after the supply if it was off; led_strip starts
+ * from black so the whole frame is written again */
+static esp_err_t light_driver_acquire(void)
+{
+  int64_t start_us = esp_timer_get_time();
+
+  light_power_set(true);
+  gpio_hold_dis(CONFIG_EXAMPLE_STRIP_LED_GPIO);
+  ESP_RETURN_ON_ERROR(
+      led_strip_new_rmt_device(&s_strip_config, &s_rmt_config, &s_led_strip),
+      TAG,
+      "strip on GPIO %d",
+      CONFIG_EXAMPLE_STRIP_LED_GPIO);
+  light_fb_invalidate(&s_fb);
+
+  uint32_t us = esp_timer_get_time() - start_us;
+  ++s_stats.acquires;
+  s_stats.acquire_us += us;
+  if (us > s_stats.acquire_max_us)
+    s_stats.acquire_max_us = us;
+  return ESP_OK;
+}
+
+/* the RMT channel goes, with its clock and the PM lock of the RMT driver;
+ * the data line is held low through sleep so the pixels keep what they
+ * latched */
+static void light_driver_release(void)
+{
+  const gpio_config_t data = {
+      .pin_bit_mask = 1ULL << CONFIG_EXAMPLE_STRIP_LED_GPIO,
+      .mode = GPIO_MODE_OUTPUT,
+  };
+
+  led_strip_del(s_led_strip);
+  s_led_strip = NULL;
+  gpio_set_level(CONFIG_EXAMPLE_STRIP_LED_GPIO, 0);
+  gpio_config(&data);
+  gpio_hold_en(CONFIG_EXAMPLE_STRIP_LED_GPIO);
+  ++s_stats.releases;
+}
+
+/* the pixels changed since the last refresh go to led_strip, nothing is
+ * sent when none did */
+static esp_err_t light_driver_refresh(void)
+{
+  uint16_t rgb[3];
+  uint8_t color[3];
+  uint16_t first;
+  uint16_t end;
+
+  light_transition_output(&s_transition, rgb);
+  for (int c = 0; c < 3; ++c)
+    color[c] = rgb[c] >> 8;
+  light_fb_fill(&s_fb, 0, s_fb.count, color);
+  s_lit = color[0] || color[1] || color[2];
+  if (!s_led_strip && s_fb.dirty_first != s_fb.dirty_end)
+    ESP_RETURN_ON_ERROR(light_driver_acquire(), TAG, "acquire");
+  if (!light_fb_take_dirty(&s_fb, &first, &end))
+  {
+    ++s_stats.unchanged;
+    return ESP_OK;
+  }
+
+  int64_t start_us = esp_timer_get_time();
+  s_refresh_tick = xTaskGetTickCount();
+  ++s_stats.refreshes;
+  for (uint16_t i = first; i < end; ++i)
+  {
+    const uint8_t* p = &s_pixels[i * LIGHT_FB_BYTES_PER_PIXEL];
+    ESP_RETURN_ON_ERROR(
+        led_strip_set_pixel(s_led_strip, i, p[0], p[1], p[2]),
+        TAG,
+        "set pixel %d",
+        i);
+  }
+  s_stats.encode_us += esp_timer_get_time() - start_us;
+  s_stats.pixels += end - first;
+  /* the whole strip goes out, WS2812 pixels are addressed by their
+   * position in the frame; waits for the end of the RMT transfer, in this
+   * task only */
+  ESP_RETURN_ON_ERROR(led_strip_refresh(s_led_strip), TAG, "refresh");
+
+  uint32_t us = esp_timer_get_time() - start_us;
+  s_stats.refresh_us += us;
+  if (us > s_stats.refresh_max_us)
+    s_stats.refresh_max_us = us;
+  return ESP_OK;
+}
+
+/* refresh, then a dark and still strip needs neither RMT nor supply */
+static esp_err_t light_driver_show(void)
+{
+  esp_err_t err;
+
+  power_save_boost_acquire();
+  err = light_driver_refresh();
+  power_save_boost_release();
+
+  if (err == ESP_OK && s_led_strip && !s_lit &&
+      !light_transition_running(&s_transition))
+  {
+    light_driver_release();
+    light_power_set(false);
+  }
+  return err;
+}
+
+static void light_driver_start(const light_driver_request_t* request)
+{
+  uint16_t target[LIGHT_CHANNELS] = {
+      [LIGHT_CHANNEL_LEVEL] = light_driver_level(request),
+      [LIGHT_CHANNEL_RED] = request->rgb[0],
+      [LIGHT_CHANNEL_GREEN] = request->rgb[1],
+      [LIGHT_CHANNEL_BLUE] = request->rgb[2],
+  };
+
+  light_transition_start(
+      &s_transition, target, light_transition_frames(request->transition_ds));
+  if (!light_transition_running(&s_transition))
+  {
+    if (esp_timer_is_active(s_frame_timer))
+      esp_timer_stop(s_frame_timer);
+    return;
+  }
+  ++s_stats.transitions;
+  if (!esp_timer_is_active(s_frame_timer))
+    esp_timer_start_periodic(
+        s_frame_timer, LIGHT_TRANSITION_FRAME_MS * 1000);
+}
+
+static void light_driver_frame(void* arg)
+{
+  xTaskNotifyGive(s_refresh_task);
+}
+
+static void light_driver_refresh_task(void* arg)
+{
+  for (;;)
+  {
+    light_driver_request_t request;
+    bool dirty;
+    bool step;
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    /* one refresh per tick, whatever is asked until the next tick goes
+     * with it */
+    if (xTaskGetTickCount() == s_refresh_tick)
+    {
+      vTaskDelay(1);
+      ulTaskNotifyTake(pdTRUE, 0);
+      ++s_stats.tick_merges;
+    }
+    portENTER_CRITICAL(&s_lock);
+    request = s_request;
+    dirty = s_dirty;
+    s_dirty = false;
+    s_busy = true;
+    portEXIT_CRITICAL(&s_lock);
+
+    step = !dirty && light_transition_running(&s_transition);
+    if (dirty)
+      light_driver_start(&request);
+    if (step)
+    {
+      if (!light_transition_step(&s_transition))
+        esp_timer_stop(s_frame_timer);
+      ++s_stats.frames;
+    }
+
+    /* otherwise a tick queued before the timer stopped */
+    if (dirty || step)
+    {
+      esp_err_t err = light_driver_show();
+      if (err != ESP_OK)
+      {
+        ++s_stats.refresh_errors;
+        ESP_LOGW(TAG, "Refresh failed: %s", esp_err_to_name(err));
+      }
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_busy = false;
+    portEXIT_CRITICAL(&s_lock);
+  }
+}
+
+/* the request is changed between the two, then the refresh task woken
+ * unless it has not picked the previous change yet */
+static bool light_driver_update_begin(uint16_t transition_ds)
+{
+  if (!s_refresh_task)
+    return false;
+  portENTER_CRITICAL(&s_lock);
+  s_request.transition_ds = transition_ds;
+  return true;
+}
+
+static void light_driver_update_end(int64_t start_us)
+{
+  bool pending = s_dirty;
+
+  s_dirty = true;
+  portEXIT_CRITICAL(&s_lock);
+  if (pending)
+    ++s_stats.coalesced;
+  else
+    xTaskNotifyGive(s_refresh_task);
+
+  uint32_t us = esp_timer_get_time() - start_us;
+  ++s_stats.updates;
+  s_stats.update_us += us;
+  if (us > s_stats.update_max_us)
+    s_stats.update_max_us = us;
+}
+
+void light_driver_set_power(bool power, uint16_t transition_ds)
+{
+  int64_t start_us = esp_timer_get_time();
+
+  if (!light_driver_update_begin(transition_ds))
+    return;
+  s_request.power = power;
+  light_driver_update_end(start_us);
+}
 
-void light_driver_set_power(bool power)
+void light_driver_set_level(uint8_t level, uint16_t transition_ds)
 {
-    ESP_ERROR_CHECK(led_strip_set_pixel(s_led_strip, 0, s_red * power, s_green * power, s_blue * power));
-    ESP_ERROR_CHECK(led_strip_refresh(s_led_strip));
+  int64_t start_us = esp_timer_get_time();
+
+  if (!light_driver_update_begin(transition_ds))
+    return;
+  s_request.level = level;
+  light_driver_update_end(start_us);
 }
 
-void light_driver_init(bool power)
+void light_driver_set_color_xy(
+    uint16_t x, uint16_t y, uint16_t transition_ds)
 {
-    led_strip_config_t led_strip_conf = {
-        .max_leds = CONFIG_EXAMPLE_STRIP_LED_NUMBER,
-        .strip_gpio_num = CONFIG_EXAMPLE_STRIP_LED_GPIO,
-    };
-    led_strip_rmt_config_t rmt_conf = {
-        .resolution_hz = 10 * 1000 * 1000, // 10MHz
-    };
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&led_strip_conf, &rmt_conf, &s_led_strip));
-    light_driver_set_power(power);
+  int64_t start_us = esp_timer_get_time();
+  uint16_t rgb[3];
+
+  /* outside of the lock, a few multiplications */
+  light_color_from_xy(x, y, rgb);
+  if (!light_driver_update_begin(transition_ds))
+    return;
+  for (int c = 0; c < 3; ++c)
+    s_request.rgb[c] = rgb[c];
+  light_driver_update_end(start_us);
 }
+
+static void light_driver_sleep_time(int64_t start_us)
+{
+  uint32_t us = esp_timer_get_time() - start_us;
+
+  if (us > s_stats.sleep_path_max_us)
+    s_stats.sleep_path_max_us = us;
+}
+
+/* a channel in use through the sleep keeps its state only if the
+ * peripherals stay powered, until a sleep finds the strip idle */
+static void light_driver_keep_peripherals(bool keep)
+{
+#if SOC_PM_SUPPORT_TOP_PD
+  if (keep == s_keep_peripherals)
+    return;
+  esp_sleep_pd_config(
+      ESP_PD_DOMAIN_TOP, keep ? ESP_PD_OPTION_ON : ESP_PD_OPTION_OFF);
+  s_keep_peripherals = keep;
+#endif
+}
+
+void light_driver_sleep_enter(void)
+{
+  int64_t start_us = esp_timer_get_time();
+  bool idle;
+
+  if (!s_refresh_task)
+    return;
+  /* the refresh task only runs for the caller and for the frame timer,
+   * it stays blocked until the next change when it is idle now; the
+   * pixels keep what they latched while the data line is held low, the
+   * next refresh takes a new channel */
+  portENTER_CRITICAL(&s_lock);
+  idle = !s_busy && !s_dirty;
+  portEXIT_CRITICAL(&s_lock);
+  if (!idle || esp_timer_is_active(s_frame_timer))
+  {
+    light_driver_keep_peripherals(true);
+    ++s_stats.sleep_busy;
+    light_driver_sleep_time(start_us);
+    return;
+  }
+  light_driver_keep_peripherals(false);
+  if (s_led_strip)
+    light_driver_release();
+  light_driver_sleep_time(start_us);
+}
+
+esp_err_t light_driver_init(bool power, uint8_t level)
+{
+  const esp_timer_create_args_t frame_timer = {
+      .callback = light_driver_frame,
+      .name = "light_frame",
+      /* a frame missed in light sleep is not made up for */
+      .skip_unhandled_events = true,
+  };
+  uint16_t start[LIGHT_CHANNELS];
+
+  ESP_RETURN_ON_ERROR(light_power_init(), TAG, "supply");
+  ESP_RETURN_ON_ERROR(
+      esp_timer_create(&frame_timer, &s_frame_timer), TAG, "frame timer");
+  /* the boot state is shown before the Zigbee task starts, synchronously */
+  s_request.power = power;
+  s_request.level = level;
+  start[LIGHT_CHANNEL_LEVEL] = light_driver_level(&s_request);
+  for (int c = 0; c < 3; ++c)
+    start[LIGHT_CHANNEL_RED + c] = s_request.rgb[c];
+  light_transition_init(&s_transition, start);
+  light_fb_init(&s_fb, s_pixels, CONFIG_EXAMPLE_STRIP_LED_NUMBER);
+  /* the strip is taken here, and let go at once if the light is off */
+  ESP_RETURN_ON_ERROR(light_driver_show(), TAG, "first refresh");
+  ESP_RETURN_ON_FALSE(
+      xTaskCreate(
+          light_driver_refresh_task,
+          "light_refresh",
+          LIGHT_DRIVER_REFRESH_STACK,
+          NULL,
+          LIGHT_DRIVER_REFRESH_PRIORITY,
+          &s_refresh_task) == pdPASS,
+      ESP_ERR_NO_MEM,
+      TAG,
+      "refresh task");
+  return ESP_OK;
+}
+
+void light_driver_get_stats(light_driver_stats_t* stats)
+{
+  *stats = s_stats;
+}
+
+#endif
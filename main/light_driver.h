@@ -38,32 +38,128 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
 
 #ifdef __cplusplus
-extern "C" {
+extern "C"
+{
 #endif
 
 /* light intensity level */
-#define LIGHT_DEFAULT_ON  1
+#define LIGHT_DEFAULT_ON 1
 #define LIGHT_DEFAULT_OFF 0
 
+/* the endpoint has a Color Control server only when the light has color,
+ * the backend is CONFIG_LIGHT_DRIVER_BACKEND_STRIP or _LEDC */
+#ifdef CONFIG_LIGHT_DRIVER_BACKEND_STRIP
+#define LIGHT_DRIVER_HAS_COLOR 1
+#else
+#define LIGHT_DRIVER_HAS_COLOR 0
+#endif
+
 /* LED strip configuration */
-#define CONFIG_EXAMPLE_STRIP_LED_GPIO   8
+#define CONFIG_EXAMPLE_STRIP_LED_GPIO 8
+#ifndef CONFIG_EXAMPLE_STRIP_LED_NUMBER
 #define CONFIG_EXAMPLE_STRIP_LED_NUMBER 1
+#endif
+
+/* PWM configuration: clocked from RC_FAST, which runs in light sleep, so
+ * 12 bits at 4 kHz is the resolution the 17.5 MHz clock allows */
+#define LIGHT_DRIVER_LEDC_GPIO 8
+#define LIGHT_DRIVER_LEDC_FREQ_HZ 4000
+#define LIGHT_DRIVER_LEDC_RESOLUTION 12
+
+/* ZCL CurrentLevel of full brightness */
+#define LIGHT_LEVEL_MAX 254
+
+/* the strip is refreshed by its own task, below the Zigbee task so a frame
+ * on the wire never delays it */
+#define LIGHT_DRIVER_REFRESH_PRIORITY 4
+#define LIGHT_DRIVER_REFRESH_STACK 2048
+
+  typedef struct
+  {
+    uint32_t updates;   /* light_driver_set_power() calls */
+    uint32_t refreshes;   /* frames sent to the strip */
+    uint32_t unchanged;   /* frames equal to the strip, not sent */
+    uint32_t coalesced;   /* updates folded into a frame not yet sent */
+    uint32_t tick_merges; /* refreshes held to the next tick */
+    uint64_t pixels;      /* written to led_strip, the dirty ranges */
+    uint64_t encode_us;   /* writing them, the CPU part of a refresh */
+    uint32_t refresh_errors;
+    uint32_t transitions; /* started with at least 2 frames, or hardware
+                             fades with the LEDC backend */
+    uint32_t frames;      /* refreshes made by the frame timer */
+    /* time spent by the caller, the Zigbee callback */
+    uint64_t update_us;
+    uint32_t update_max_us;
+    /* time spent by the refresh task, what the caller waited before */
+    uint64_t refresh_us;
+    uint32_t refresh_max_us;
+    /* output peripheral let go, dark light or sleep */
+    uint32_t releases;
+    /* taken again, supply and channel setup, what the first change after
+     * a release waits on top of its refresh */
+    uint32_t acquires;
+    uint64_t acquire_us;
+    uint32_t acquire_max_us;
+    uint32_t sleep_busy; /* sleeps with the peripherals kept for the strip */
+    /* added to the CAN_SLEEP path by light_driver_sleep_enter() */
+    uint32_t sleep_path_max_us;
+  } light_driver_stats_t;
+
+  /**
+   * @brief Set light power (on/off).
+   *
+   * Only records the state and wakes the refresh task, never waits for the
+   * strip. Updates made while a frame is pending are sent in that frame,
+   * with the transition time of the last one.
+   *
+   * @param  power  The light power to be set
+   * @param  transition_ds  fade time in tenths of a second, 0 for a jump
+   */
+  void light_driver_set_power(bool power, uint16_t transition_ds);
+
+  /**
+   * @brief Set the brightness, ZCL CurrentLevel up to LIGHT_LEVEL_MAX
+   *
+   * With the LEDC backend a transition is a hardware fade: the CPU only
+   * programs it, and a new call stops it where it is.
+   */
+  void light_driver_set_level(uint8_t level, uint16_t transition_ds);
+
+  /**
+   * @brief Set the color, ZCL CurrentX and CurrentY, ignored without
+   * LIGHT_DRIVER_HAS_COLOR
+   */
+  void light_driver_set_color_xy(
+      uint16_t x, uint16_t y, uint16_t transition_ds);
+
+  /**
+   * @brief color light driver init, be invoked where you want to use color
+   * light
+   *
+   * @param power power on/off
+   * @param level brightness, ZCL CurrentLevel
+   */
+  esp_err_t light_driver_init(bool power, uint8_t level);
+
+  /**
+   * @brief Call right before the light sleep, from the Zigbee task
+   *
+   * The strip backend gives its RMT channel back, the peripherals lose
+   * their state in sleep; while a refresh or a transition is running it
+   * keeps the channel and the peripherals powered through the sleep. The
+   * LEDC backend drops the sleep power domains once its output is dark.
+   */
+  void light_driver_sleep_enter(void);
 
-/**
-* @brief Set light power (on/off).
-*
-* @param  power  The light power to be set
-*/
-void light_driver_set_power(bool power);
-
-/**
-* @brief color light driver init, be invoked where you want to use color light
-*
-* @param power power on/off
-*/
-void light_driver_init(bool power);
+  /**
+   * @brief Snapshot of the update and refresh counters
+   */
+  void light_driver_get_stats(light_driver_stats_t* stats);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,237 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Single channel PWM light driver on LEDC with hardware fades
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "light_driver.h"
+
+#ifdef CONFIG_LIGHT_DRIVER_BACKEND_LEDC
+
+#include <inttypes.h>
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "light_power.h"
+#include "light_transition.h"
+#include "soc/soc_caps.h"
+
+#define LIGHT_DRIVER_LEDC_MODE LEDC_LOW_SPEED_MODE
+#define LIGHT_DRIVER_LEDC_TIMER LEDC_TIMER_0
+#define LIGHT_DRIVER_LEDC_CHANNEL LEDC_CHANNEL_0
+
+static const char* TAG = "light_driver";
+
+static const ledc_timer_config_t s_timer = {
+    .speed_mode = LIGHT_DRIVER_LEDC_MODE,
+    .duty_resolution = LIGHT_DRIVER_LEDC_RESOLUTION,
+    .timer_num = LIGHT_DRIVER_LEDC_TIMER,
+    .freq_hz = LIGHT_DRIVER_LEDC_FREQ_HZ,
+    /* the APB clock stops in light sleep, RC_FAST does not */
+    .clk_cfg = LEDC_USE_RC_FAST_CLK,
+};
+static const ledc_channel_config_t s_channel = {
+    .gpio_num = LIGHT_DRIVER_LEDC_GPIO,
+    .speed_mode = LIGHT_DRIVER_LEDC_MODE,
+    .channel = LIGHT_DRIVER_LEDC_CHANNEL,
+    .timer_sel = LIGHT_DRIVER_LEDC_TIMER,
+};
+
+/* only changed by the Zigbee task, LEDC has its own locks */
+static bool s_power;
+static uint8_t s_level;
+static bool s_ready;
+/* RC_FAST and the peripherals kept in sleep, the supply on */
+static bool s_acquired;
+static light_driver_stats_t s_stats;
+
+/* the gamma is applied to the ends of a fade, the hardware steps the duty
+ * linearly between them */
+static uint32_t light_driver_duty(void)
+{
+  uint16_t level;
+
+  if (!s_power)
+    level = 0;
+  else if (s_level >= LIGHT_LEVEL_MAX)
+    level = 0xff00;
+  else
+    level = s_level * 0xff00 / LIGHT_LEVEL_MAX;
+  return light_gamma(level) >> (16 - LIGHT_DRIVER_LEDC_RESOLUTION);
+}
+
+/* the PWM and its fades go on while the chip sleeps between polls: the
+ * clock, the peripherals and the pin are kept as they are; the timer and
+ * the channel are set again, they were lost if the peripherals were not */
+static esp_err_t light_driver_acquire(void)
+{
+  int64_t start_us = esp_timer_get_time();
+
+  ESP_RETURN_ON_ERROR(
+      esp_sleep_pd_config(ESP_PD_DOMAIN_RC_FAST, ESP_PD_OPTION_ON),
+      TAG,
+      "RC_FAST in sleep");
+#if SOC_PM_SUPPORT_TOP_PD
+  ESP_RETURN_ON_ERROR(
+      esp_sleep_pd_config(ESP_PD_DOMAIN_TOP, ESP_PD_OPTION_ON),
+      TAG,
+      "peripherals in sleep");
+#endif
+  s_acquired = true;
+  light_power_set(true);
+  gpio_hold_dis(LIGHT_DRIVER_LEDC_GPIO);
+  ESP_RETURN_ON_ERROR(ledc_timer_config(&s_timer), TAG, "timer");
+  ESP_RETURN_ON_ERROR(
+      ledc_channel_config(&s_channel),
+      TAG,
+      "channel on GPIO %d",
+      LIGHT_DRIVER_LEDC_GPIO);
+
+  uint32_t us = esp_timer_get_time() - start_us;
+  ++s_stats.acquires;
+  s_stats.acquire_us += us;
+  if (us > s_stats.acquire_max_us)
+    s_stats.acquire_max_us = us;
+  return ESP_OK;
+}
+
+/* dark: the pin is held low and the sleep may power everything down */
+static void light_driver_release(void)
+{
+  ledc_stop(LIGHT_DRIVER_LEDC_MODE, LIGHT_DRIVER_LEDC_CHANNEL, 0);
+  gpio_hold_en(LIGHT_DRIVER_LEDC_GPIO);
+  light_power_set(false);
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RC_FAST, ESP_PD_OPTION_OFF);
+#if SOC_PM_SUPPORT_TOP_PD
+  esp_sleep_pd_config(ESP_PD_DOMAIN_TOP, ESP_PD_OPTION_OFF);
+#endif
+  s_acquired = false;
+  ++s_stats.releases;
+}
+
+static void light_driver_apply(uint16_t transition_ds, int64_t start_us)
+{
+  uint32_t duty = light_driver_duty();
+  esp_err_t err;
+
+  if (!s_ready)
+    return;
+  if (!s_acquired && duty)
+  {
+    err = light_driver_acquire();
+    if (err != ESP_OK)
+    {
+      ++s_stats.refresh_errors;
+      ESP_LOGW(TAG, "Acquire failed: %s", esp_err_to_name(err));
+      return;
+    }
+  }
+  if (!s_acquired)
+    return;
+  /* a fade still running stops at its current duty, the next one starts
+   * from there */
+  ledc_fade_stop(LIGHT_DRIVER_LEDC_MODE, LIGHT_DRIVER_LEDC_CHANNEL);
+  if (transition_ds)
+  {
+    err = ledc_set_fade_time_and_start(
+        LIGHT_DRIVER_LEDC_MODE,
+        LIGHT_DRIVER_LEDC_CHANNEL,
+        duty,
+        transition_ds * 100,
+        LEDC_FADE_NO_WAIT);
+    if (err == ESP_OK)
+      ++s_stats.transitions;
+  }
+  else
+  {
+    err = ledc_set_duty(
+        LIGHT_DRIVER_LEDC_MODE, LIGHT_DRIVER_LEDC_CHANNEL, duty);
+    if (err == ESP_OK)
+      err = ledc_update_duty(
+          LIGHT_DRIVER_LEDC_MODE, LIGHT_DRIVER_LEDC_CHANNEL);
+  }
+  if (err != ESP_OK)
+  {
+    ++s_stats.refresh_errors;
+    ESP_LOGW(TAG, "Duty %" PRIu32 ": %s", duty, esp_err_to_name(err));
+  }
+  else if (!duty && !transition_ds)
+  {
+    light_driver_release();
+  }
+
+  uint32_t us = esp_timer_get_time() - start_us;
+  ++s_stats.updates;
+  s_stats.update_us += us;
+  if (us > s_stats.update_max_us)
+    s_stats.update_max_us = us;
+}
+
+void light_driver_set_power(bool power, uint16_t transition_ds)
+{
+  int64_t start_us = esp_timer_get_time();
+
+  s_power = power;
+  light_driver_apply(transition_ds, start_us);
+}
+
+void light_driver_set_level(uint8_t level, uint16_t transition_ds)
+{
+  int64_t start_us = esp_timer_get_time();
+
+  s_level = level;
+  light_driver_apply(transition_ds, start_us);
+}
+
+void light_driver_set_color_xy(
+    uint16_t x, uint16_t y, uint16_t transition_ds)
+{
+}
+
+void light_driver_sleep_enter(void)
+{
+  int64_t start_us = esp_timer_get_time();
+
+  /* a fade to dark ended since the last command */
+  if (!s_acquired || light_driver_duty() ||
+      ledc_get_duty(LIGHT_DRIVER_LEDC_MODE, LIGHT_DRIVER_LEDC_CHANNEL))
+    return;
+  light_driver_release();
+
+  uint32_t us = esp_timer_get_time() - start_us;
+  if (us > s_stats.sleep_path_max_us)
+    s_stats.sleep_path_max_us = us;
+}
+
+esp_err_t light_driver_init(bool power, uint8_t level)
+{
+  ESP_RETURN_ON_ERROR(light_power_init(), TAG, "supply");
+  /* taken for the fade service, let go below if the light is off */
+  ESP_RETURN_ON_ERROR(light_driver_acquire(), TAG, "first acquire");
+  ESP_RETURN_ON_ERROR(ledc_fade_func_install(0), TAG, "fade service");
+  ESP_RETURN_ON_ERROR(
+      gpio_sleep_sel_dis(LIGHT_DRIVER_LEDC_GPIO), TAG, "pin in sleep");
+  s_ready = true;
+  s_power = power;
+  s_level = level;
+  light_driver_apply(0, esp_timer_get_time());
+  ESP_RETURN_ON_FALSE(!s_stats.refresh_errors, ESP_FAIL, TAG, "first duty");
+  return ESP_OK;
+}
+
+void light_driver_get_stats(light_driver_stats_t* stats)
+{
+  *stats = s_stats;
+}
+
+#endif
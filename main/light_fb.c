@@ -0,0 +1,95 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * LED strip framebuffer with dirty range tracking
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "light_fb.h"
+#include <string.h>
+
+static void light_fb_mark(light_fb_t* fb, uint16_t first, uint16_t end)
+{
+  if (fb->dirty_first == fb->dirty_end)
+  {
+    fb->dirty_first = first;
+    fb->dirty_end = end;
+    return;
+  }
+  /* one range covering both, a strip is always sent from its start */
+  if (first < fb->dirty_first)
+    fb->dirty_first = first;
+  if (end > fb->dirty_end)
+    fb->dirty_end = end;
+}
+
+static bool light_fb_equal(
+    const light_fb_t* fb, uint16_t index, const uint8_t rgb[3])
+{
+  const uint8_t* p = &fb->pixels[index * LIGHT_FB_BYTES_PER_PIXEL];
+
+  return p[0] == rgb[0] && p[1] == rgb[1] && p[2] == rgb[2];
+}
+
+void light_fb_init(light_fb_t* fb, uint8_t* pixels, uint16_t count)
+{
+  fb->pixels = pixels;
+  fb->count = count;
+  memset(pixels, 0, count * LIGHT_FB_BYTES_PER_PIXEL);
+  light_fb_invalidate(fb);
+}
+
+void light_fb_invalidate(light_fb_t* fb)
+{
+  fb->dirty_first = 0;
+  fb->dirty_end = fb->count;
+}
+
+void light_fb_set(light_fb_t* fb, uint16_t index, const uint8_t rgb[3])
+{
+  light_fb_fill(fb, index, 1, rgb);
+}
+
+void light_fb_fill(
+    light_fb_t* fb, uint16_t first, uint16_t n, const uint8_t rgb[3])
+{
+  uint16_t end;
+
+  if (first >= fb->count)
+    return;
+  if (n > fb->count - first)
+    n = fb->count - first;
+  end = first + n;
+  /* trim the pixels already right at both ends, the rest is written in a
+   * straight loop: a fade changes every pixel, a still frame none */
+  while (first < end && light_fb_equal(fb, first, rgb))
+    ++first;
+  while (end > first && light_fb_equal(fb, end - 1, rgb))
+    --end;
+  if (first == end)
+    return;
+  for (uint16_t i = first; i < end; ++i)
+  {
+    uint8_t* p = &fb->pixels[i * LIGHT_FB_BYTES_PER_PIXEL];
+    p[0] = rgb[0];
+    p[1] = rgb[1];
+    p[2] = rgb[2];
+  }
+  light_fb_mark(fb, first, end);
+}
+
+bool light_fb_take_dirty(light_fb_t* fb, uint16_t* first, uint16_t* end)
+{
+  if (fb->dirty_first == fb->dirty_end)
+    return false;
+  *first = fb->dirty_first;
+  *end = fb->dirty_end;
+  fb->dirty_first = fb->dirty_end = 0;
+  return true;
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * LED strip framebuffer with dirty range tracking
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define LIGHT_FB_BYTES_PER_PIXEL 3
+
+  /**
+   * @brief Pixels of a strip and the range changed since the last refresh
+   *
+   * Writes equal to what the strip shows leave the range untouched. Plain
+   * data, also built on the host by tools/light_fb_bench.c.
+   */
+  typedef struct
+  {
+    uint8_t* pixels; /* red, green, blue */
+    uint16_t count;
+    uint16_t dirty_first;
+    uint16_t dirty_end; /* equal to dirty_first when clean */
+  } light_fb_t;
+
+  /**
+   * @brief Start with every pixel dirty, the strip content is unknown
+   *
+   * @param pixels  count * LIGHT_FB_BYTES_PER_PIXEL bytes.
+   */
+  void light_fb_init(light_fb_t* fb, uint8_t* pixels, uint16_t count);
+
+  /**
+   * @brief Mark every pixel dirty, the strip lost what it showed
+   */
+  void light_fb_invalidate(light_fb_t* fb);
+
+  void light_fb_set(light_fb_t* fb, uint16_t index, const uint8_t rgb[3]);
+
+  /**
+   * @brief Set n pixels from first, clipped to the strip
+   */
+  void light_fb_fill(
+      light_fb_t* fb, uint16_t first, uint16_t n, const uint8_t rgb[3]);
+
+  /**
+   * @brief Take the range to send and mark the strip clean
+   *
+   * @return false if nothing changed, the refresh can be skipped.
+   */
+  bool light_fb_take_dirty(light_fb_t* fb, uint16_t* first, uint16_t* end);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
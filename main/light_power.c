@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Supply switch of the LEDs, shared by the light driver backends
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "light_power.h"
+#include "driver/gpio.h"
+#include "esp_check.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+
+static const char* TAG = "light_power";
+
+static bool s_on;
+static int64_t s_off_since_us;
+static light_power_stats_t s_stats;
+
+esp_err_t light_power_init(void)
+{
+  s_off_since_us = esp_timer_get_time();
+#if CONFIG_LIGHT_POWER_GPIO >= 0
+  const gpio_config_t config = {
+      .pin_bit_mask = 1ULL << CONFIG_LIGHT_POWER_GPIO,
+      .mode = GPIO_MODE_OUTPUT,
+  };
+
+  ESP_RETURN_ON_ERROR(
+      gpio_set_level(CONFIG_LIGHT_POWER_GPIO, !LIGHT_POWER_ON_LEVEL),
+      TAG,
+      "level");
+  ESP_RETURN_ON_ERROR(
+      gpio_config(&config), TAG, "switch on GPIO %d", CONFIG_LIGHT_POWER_GPIO);
+  /* held, the peripherals and the GPIO matrix power down in light sleep */
+  ESP_RETURN_ON_ERROR(gpio_hold_en(CONFIG_LIGHT_POWER_GPIO), TAG, "hold");
+#endif
+  return ESP_OK;
+}
+
+void light_power_set(bool on)
+{
+  if (on == s_on)
+    return;
+  s_on = on;
+  if (on)
+  {
+    ++s_stats.switch_ons;
+    s_stats.off_us += esp_timer_get_time() - s_off_since_us;
+  }
+  else
+  {
+    s_off_since_us = esp_timer_get_time();
+  }
+#if CONFIG_LIGHT_POWER_GPIO >= 0
+  gpio_hold_dis(CONFIG_LIGHT_POWER_GPIO);
+  gpio_set_level(
+      CONFIG_LIGHT_POWER_GPIO,
+      on ? LIGHT_POWER_ON_LEVEL : !LIGHT_POWER_ON_LEVEL);
+  gpio_hold_en(CONFIG_LIGHT_POWER_GPIO);
+  /* short and bounded, a task delay would round up to a tick */
+  if (on)
+    esp_rom_delay_us(LIGHT_POWER_SETTLE_US);
+#endif
+}
+
+void light_power_get_stats(light_power_stats_t* stats)
+{
+  *stats = s_stats;
+  if (!s_on)
+    stats->off_us += esp_timer_get_time() - s_off_since_us;
+}
@@ -0,0 +1,55 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Supply switch of the LEDs, shared by the light driver backends
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* the load switch of the LED supply is on CONFIG_LIGHT_POWER_GPIO, -1 when
+ * the LEDs are always powered */
+#define LIGHT_POWER_ON_LEVEL 1
+/* rail rise and LED power on reset, before the first frame or duty */
+#define LIGHT_POWER_SETTLE_US 500
+
+  typedef struct
+  {
+    uint32_t switch_ons;
+    uint64_t off_us; /* supply off, the current period included */
+  } light_power_stats_t;
+
+  /**
+   * @brief Configure the switch, the supply starts off
+   */
+  esp_err_t light_power_init(void);
+
+  /**
+   * @brief Switch the supply, on waits LIGHT_POWER_SETTLE_US
+   *
+   * The level is held through light sleep. Nothing to do without
+   * CONFIG_LIGHT_POWER_GPIO.
+   */
+  void light_power_set(bool on);
+
+  void light_power_get_stats(light_power_stats_t* stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
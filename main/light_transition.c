@@ -0,0 +1,147 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Fixed-point brightness and color transitions
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "light_transition.h"
+
+/*
+ * Emitted light of each whole perceived level, folded into constants by
+ * the compiler: no table to generate, none computed at boot. Levels
+ * between two entries are interpolated.
+ */
+#define LIGHT_GAMMA_ENTRY(i) \
+  (uint16_t)(__builtin_pow((i) / 255.0, LIGHT_TRANSITION_GAMMA) * 65535.0 + 0.5)
+#define LIGHT_GAMMA_4(i)                               \
+  LIGHT_GAMMA_ENTRY(i), LIGHT_GAMMA_ENTRY((i) + 1),    \
+      LIGHT_GAMMA_ENTRY((i) + 2), LIGHT_GAMMA_ENTRY((i) + 3)
+#define LIGHT_GAMMA_16(i)                                          \
+  LIGHT_GAMMA_4(i), LIGHT_GAMMA_4((i) + 4), LIGHT_GAMMA_4((i) + 8), \
+      LIGHT_GAMMA_4((i) + 12)
+#define LIGHT_GAMMA_64(i)                                   \
+  LIGHT_GAMMA_16(i), LIGHT_GAMMA_16((i) + 16),              \
+      LIGHT_GAMMA_16((i) + 32), LIGHT_GAMMA_16((i) + 48)
+
+static const uint16_t s_gamma[256] = {
+    LIGHT_GAMMA_64(0),
+    LIGHT_GAMMA_64(64),
+    LIGHT_GAMMA_64(128),
+    LIGHT_GAMMA_64(192),
+};
+
+/* XYZ to linear sRGB (IEC 61966-2-1), 4.12 */
+static const int32_t s_xyz_to_rgb[3][3] = {
+    {13273, -6296, -2042},
+    {-3969, 7683, 170},
+    {228, -836, 4329},
+};
+
+uint16_t light_gamma(uint16_t level)
+{
+  uint32_t i = level >> 8;
+  uint32_t low = s_gamma[i];
+  uint32_t high = s_gamma[i < 255 ? i + 1 : 255];
+
+  return low + (((high - low) * (level & 0xff)) >> 8);
+}
+
+void light_transition_init(
+    light_transition_t* transition, const uint16_t value[LIGHT_CHANNELS])
+{
+  for (int c = 0; c < LIGHT_CHANNELS; ++c)
+  {
+    transition->value[c] = (uint32_t)value[c] << 16;
+    transition->step[c] = 0;
+    transition->target[c] = value[c];
+  }
+  transition->frames = 0;
+}
+
+void light_transition_start(
+    light_transition_t* transition,
+    const uint16_t target[LIGHT_CHANNELS],
+    uint32_t frames)
+{
+  for (int c = 0; c < LIGHT_CHANNELS; ++c)
+  {
+    transition->target[c] = target[c];
+    if (frames <= 1)
+    {
+      transition->value[c] = (uint32_t)target[c] << 16;
+      continue;
+    }
+    /* at least 2 frames, the step fits in 32 bits */
+    transition->step[c] =
+        (int32_t)((((int64_t)target[c] << 16) - transition->value[c]) /
+                  (int64_t)frames);
+  }
+  transition->frames = frames <= 1 ? 0 : frames;
+}
+
+bool light_transition_step(light_transition_t* transition)
+{
+  if (!transition->frames)
+    return false;
+  if (--transition->frames)
+  {
+    for (int c = 0; c < LIGHT_CHANNELS; ++c)
+      transition->value[c] += transition->step[c];
+    return true;
+  }
+  /* the last frame lands on the target, whatever the rounding */
+  for (int c = 0; c < LIGHT_CHANNELS; ++c)
+    transition->value[c] = (uint32_t)transition->target[c] << 16;
+  return false;
+}
+
+void light_transition_output(
+    const light_transition_t* transition, uint16_t rgb[3])
+{
+  uint32_t gain = light_gamma(transition->value[LIGHT_CHANNEL_LEVEL] >> 16);
+
+  for (int c = 0; c < 3; ++c)
+    rgb[c] = (gain * (transition->value[LIGHT_CHANNEL_RED + c] >> 16) +
+              0x8000) >>
+             16;
+}
+
+uint32_t light_transition_frames(uint16_t transition_ds)
+{
+  return ((uint32_t)transition_ds * 100 + LIGHT_TRANSITION_FRAME_MS / 2) /
+         LIGHT_TRANSITION_FRAME_MS;
+}
+
+void light_color_from_xy(uint16_t x, uint16_t y, uint16_t rgb[3])
+{
+  /* XYZ scaled by y, which the normalization below cancels */
+  int32_t xyz[3] = {x, y, 65536 - x - y};
+  int32_t linear[3];
+  int32_t max = 0;
+
+  if (!y || xyz[2] < 0)
+  {
+    rgb[0] = rgb[1] = rgb[2] = 0xffff;
+    return;
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    linear[c] = 0;
+    for (int i = 0; i < 3; ++i)
+      linear[c] += s_xyz_to_rgb[c][i] * xyz[i];
+    /* out of the sRGB gamut, clipped */
+    if (linear[c] < 0)
+      linear[c] = 0;
+    if (linear[c] > max)
+      max = linear[c];
+  }
+  for (int c = 0; c < 3; ++c)
+    rgb[c] = max ? (uint64_t)linear[c] * 0xffff / max : 0xffff;
+}
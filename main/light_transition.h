@@ -0,0 +1,103 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Fixed-point brightness and color transitions
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* one frame every 20 ms while a transition runs, none otherwise */
+#define LIGHT_TRANSITION_FRAME_MS 20
+/* exponent of the gamma table, from perceived to emitted light */
+#define LIGHT_TRANSITION_GAMMA 2.2
+
+  typedef enum
+  {
+    LIGHT_CHANNEL_LEVEL, /* perceived brightness, 8.8 */
+    LIGHT_CHANNEL_RED,   /* linear color, 0 to 0xffff */
+    LIGHT_CHANNEL_GREEN,
+    LIGHT_CHANNEL_BLUE,
+    LIGHT_CHANNELS,
+  } light_channel_t;
+
+  /**
+   * @brief Linear interpolation of every channel over a number of frames
+   *
+   * Plain data, also built on the host by tools/light_transition_bench.c.
+   */
+  typedef struct
+  {
+    uint32_t value[LIGHT_CHANNELS]; /* 16.16 */
+    int32_t step[LIGHT_CHANNELS];   /* added each frame, 16.16 */
+    uint16_t target[LIGHT_CHANNELS];
+    uint32_t frames; /* left before the target */
+  } light_transition_t;
+
+  void light_transition_init(
+      light_transition_t* transition, const uint16_t value[LIGHT_CHANNELS]);
+
+  /**
+   * @brief Head for target from the current value, over frames frames
+   *
+   * A transition still running is replaced, without a jump. 0 or 1 frame
+   * sets the target at once.
+   */
+  void light_transition_start(
+      light_transition_t* transition,
+      const uint16_t target[LIGHT_CHANNELS],
+      uint32_t frames);
+
+  /**
+   * @brief Advance one frame
+   *
+   * @return false once the target is reached, the frame timer can stop.
+   */
+  bool light_transition_step(light_transition_t* transition);
+
+  static inline bool light_transition_running(
+      const light_transition_t* transition)
+  {
+    return transition->frames != 0;
+  }
+
+  /**
+   * @brief Emitted red, green and blue of the current frame, 0 to 0xffff
+   */
+  void light_transition_output(
+      const light_transition_t* transition, uint16_t rgb[3]);
+
+  /**
+   * @brief Frames of a ZCL transition time, in tenths of a second
+   */
+  uint32_t light_transition_frames(uint16_t transition_ds);
+
+  /**
+   * @brief Emitted light of a perceived brightness, 8.8 to 0 - 0xffff
+   */
+  uint16_t light_gamma(uint16_t level);
+
+  /**
+   * @brief Linear sRGB of a CIE 1931 chromaticity, brightest channel 0xffff
+   *
+   * x and y are the ZCL CurrentX and CurrentY, in 1/65536.
+   */
+  void light_color_from_xy(uint16_t x, uint16_t y, uint16_t rgb[3]);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,848 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * OTA Upgrade client streaming the image to the inactive app partition
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "ota_client.h"
+#include <inttypes.h>
+#include <string.h>
+#include "energy_model.h"
+#include "esp_check.h"
+#include "esp_image_format.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "ota_decode.h"
+#include "ota_pacer.h"
+#include "poll_control.h"
+#include "sleep_tuner.h"
+#include "zboss_api.h"
+#include "zcl/zb_zcl_ota_upgrade.h"
+
+#define OTA_CLIENT_NVS_NAMESPACE "ota_client"
+#define OTA_CLIENT_NVS_KEY "checkpoint"
+/* tag id and length in front of each sub-element */
+#define OTA_CLIENT_TAG_HEADER_SIZE 6
+/* OTA header with all its optional fields, the first tag header and the
+ * header of a compressed image */
+#define OTA_CLIENT_HEAD_MAX \
+  (69 + OTA_CLIENT_TAG_HEADER_SIZE + OTA_DECODE_HEADER_SIZE)
+/* below the Zigbee task, it writes while the stack waits for the next block */
+/* Image Block Request sent by the stack: field control, manufacturer code,
+ * image type, file version, file offset and maximum data size */
+#define OTA_CLIENT_BLOCK_REQUEST_BYTES (ENERGY_MODEL_ZCL_HEADER_BYTES + 14)
+#define OTA_CLIENT_WRITER_PRIORITY 4
+#define OTA_CLIENT_WRITER_STACK 3072
+
+static const char* TAG = "ota_client";
+
+/* an OTA file and where its upgrade image stands, saved as the resume
+ * point */
+typedef struct
+{
+  uint16_t manufacturer;
+  uint16_t image_type;
+  uint32_t file_version;
+  uint32_t file_size;
+  uint16_t tag;         /* sub-element of the image */
+  uint32_t image_start; /* file offset of the image data, 0 until parsed */
+  uint32_t image_size;  /* image data in the file */
+  uint32_t consumed;    /* image data used */
+  uint32_t written;     /* image bytes in flash */
+  /* OTA_DECODE_TAG images */
+  ota_decode_state_t decoder;
+} ota_client_file_t;
+
+/* a block on its way to the flash writer */
+typedef struct
+{
+  uint32_t offset; /* file offset */
+  uint32_t len;
+  uint8_t data[OTA_CLIENT_MAX_DATA_SIZE];
+} ota_client_slot_t;
+
+static uint8_t s_endpoint;
+static const esp_partition_t* s_partition;
+static ota_client_file_t s_offer; /* last Query Next Image Response */
+static ota_client_file_t s_file;  /* transfer in progress */
+static bool s_active;
+static volatile bool s_failed; /* set by the writer too */
+static uint32_t s_next;        /* file offset expected next */
+static uint32_t s_erased;      /* image offset the flash is erased up to */
+static uint32_t s_written;     /* image offset the flash is written up to */
+static ota_client_slot_t s_slots[OTA_CLIENT_WRITE_SLOTS];
+static QueueHandle_t s_free;    /* slots the Zigbee task may fill */
+static QueueHandle_t s_pending; /* slots for the writer, in file order */
+static ota_pacer_t s_pacer;
+static int64_t s_block_us; /* last Image Block Response */
+static uint16_t s_server;  /* short address of the server that answered */
+static uint8_t s_head[OTA_CLIENT_HEAD_MAX];
+static int64_t s_start_us;
+static energy_model_stats_t s_energy; /* at the start of the transfer */
+/* the writer task updates offset, write_us, checkpoints and failures, the
+ * Zigbee task the rest; both take the lock for those and for a copy */
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static ota_client_stats_t s_stats;
+
+static bool ota_client_same_file(
+    const ota_client_file_t* a, const ota_client_file_t* b)
+{
+  return a->manufacturer == b->manufacturer &&
+         a->image_type == b->image_type &&
+         a->file_version == b->file_version && a->file_size == b->file_size;
+}
+
+static bool ota_client_load(ota_client_file_t* file)
+{
+  nvs_handle_t nvs;
+  size_t size = sizeof(*file);
+  esp_err_t err;
+
+  if (nvs_open(OTA_CLIENT_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    return false;
+  err = nvs_get_blob(nvs, OTA_CLIENT_NVS_KEY, file, &size);
+  nvs_close(nvs);
+  return err == ESP_OK && size == sizeof(*file);
+}
+
+static void ota_client_save(const ota_client_file_t* file)
+{
+  nvs_handle_t nvs;
+  esp_err_t err = nvs_open(OTA_CLIENT_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+
+  if (err == ESP_OK)
+  {
+    err = file ? nvs_set_blob(nvs, OTA_CLIENT_NVS_KEY, file, sizeof(*file))
+               : nvs_erase_key(nvs, OTA_CLIENT_NVS_KEY);
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND)
+      err = nvs_commit(nvs);
+    nvs_close(nvs);
+  }
+  if (err != ESP_OK)
+    ESP_LOGW(TAG, "Resume point not saved: %s", esp_err_to_name(err));
+}
+
+static uint32_t ota_client_per_mb(uint64_t us, uint32_t bytes)
+{
+  return bytes ? us * 1024 * 1024 / 1000 / bytes : 0;
+}
+
+/* a copy of the counters with the rates of the transfer in progress, from
+ * either task */
+static void ota_client_snapshot(ota_client_stats_t* stats)
+{
+  energy_model_stats_t now;
+
+  portENTER_CRITICAL(&s_stats_lock);
+  *stats = s_stats;
+  portEXIT_CRITICAL(&s_stats_lock);
+  if (!s_active)
+    return;
+  energy_model_get_stats(&now);
+  stats->elapsed_us = esp_timer_get_time() - s_start_us;
+  stats->radio_us = now.time_us[ENERGY_STATE_RADIO_RX] -
+                    s_energy.time_us[ENERGY_STATE_RADIO_RX] +
+                    now.time_us[ENERGY_STATE_RADIO_TX] -
+                    s_energy.time_us[ENERGY_STATE_RADIO_TX];
+  stats->awake_us = stats->elapsed_us -
+                    (now.time_us[ENERGY_STATE_LIGHT_SLEEP] -
+                     s_energy.time_us[ENERGY_STATE_LIGHT_SLEEP]);
+  stats->throughput_bps =
+      stats->elapsed_us ? stats->bytes * 1000000ULL / stats->elapsed_us : 0;
+  stats->radio_ms_per_mb = ota_client_per_mb(stats->radio_us, stats->bytes);
+  stats->awake_ms_per_mb = ota_client_per_mb(stats->awake_us, stats->bytes);
+}
+
+/* from either task */
+static void ota_client_fail(void)
+{
+  s_failed = true;
+  portENTER_CRITICAL(&s_stats_lock);
+  ++s_stats.failures;
+  portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void ota_client_log_progress(const char* what)
+{
+  ota_client_stats_t stats;
+
+  ota_client_snapshot(&stats);
+  ESP_LOGI(
+      TAG,
+      "%s at %" PRIu32 "/%" PRIu32 ": %" PRIu32 " B/s, radio %" PRIu32
+      " ms/MB, awake %" PRIu32 " ms/MB, %d byte blocks (%" PRIu32
+      " up, %" PRIu32 " down)",
+      what,
+      stats.offset,
+      stats.file_size,
+      stats.throughput_bps,
+      stats.radio_ms_per_mb,
+      stats.awake_ms_per_mb,
+      stats.block_size,
+      stats.grows,
+      stats.backoffs);
+}
+
+/* what the compressed or delta file saved against sending the image as is,
+ * the full image time is extrapolated from the throughput of the transfer */
+static void ota_client_log_saving(void)
+{
+  ota_client_stats_t stats;
+
+  ota_client_snapshot(&stats);
+  s_stats.transfer_pct =
+      stats.image_size ? stats.file_size * 100ULL / stats.image_size : 0;
+  s_stats.full_image_us =
+      stats.bytes ? stats.elapsed_us * stats.image_size / stats.bytes : 0;
+  ESP_LOGI(
+      TAG,
+      "File of %" PRIu32 " bytes for a %" PRIu32 " byte image (%" PRIu32
+      "%%), %" PRIu64 " ms against %" PRIu64 " ms for a full image",
+      stats.file_size,
+      stats.image_size,
+      s_stats.transfer_pct,
+      stats.elapsed_us / 1000,
+      s_stats.full_image_us / 1000);
+}
+
+/* from a write slot, or from the decoder window, to flash;
+ * the sectors are erased as the writes reach them like esp_ota_write does */
+static esp_err_t ota_client_flash_write(
+    uint32_t at, const uint8_t* data, uint32_t len)
+{
+  uint32_t end = at + len;
+
+  if (end > s_erased)
+  {
+    uint32_t erase_end =
+        (end + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+    ESP_RETURN_ON_ERROR(
+        esp_partition_erase_range(
+            s_partition, s_erased, erase_end - s_erased),
+        TAG,
+        "erase at %" PRIu32,
+        s_erased);
+    s_erased = erase_end;
+  }
+  ESP_RETURN_ON_ERROR(
+      esp_partition_write(s_partition, at, data, len),
+      TAG,
+      "write at %" PRIu32,
+      at);
+  s_written = end;
+  return ESP_OK;
+}
+
+/* image bytes produced so far, some may still be in the decoder window */
+static uint32_t ota_client_output(void)
+{
+  return s_file.tag == OTA_DECODE_TAG ? s_file.decoder.out : s_written;
+}
+
+/* save a resume point every OTA_CLIENT_CHECKPOINT_BYTES of image, between
+ * two blocks so the decoder state matches the data used up to next */
+static esp_err_t ota_client_checkpoint(uint32_t next)
+{
+  uint32_t output = ota_client_output();
+
+  if (!s_file.image_start ||
+      output / OTA_CLIENT_CHECKPOINT_BYTES ==
+          s_file.written / OTA_CLIENT_CHECKPOINT_BYTES)
+    return ESP_OK;
+  if (s_file.tag == OTA_DECODE_TAG)
+    ESP_RETURN_ON_ERROR(
+        ota_decode_flush(&s_file.decoder), TAG, "decoder flush");
+  s_file.consumed = next - s_file.image_start;
+  if (s_file.consumed > s_file.image_size)
+    s_file.consumed = s_file.image_size;
+  s_file.written = s_written;
+  ota_client_save(&s_file);
+  portENTER_CRITICAL(&s_stats_lock);
+  ++s_stats.checkpoints;
+  portEXIT_CRITICAL(&s_stats_lock);
+  ota_client_log_progress("Checkpoint");
+  return ESP_OK;
+}
+
+/* the OTA header and the tag of the upgrade image, collected byte by byte
+ * until the image offset is known */
+static esp_err_t ota_client_parse_head(uint32_t have)
+{
+  uint32_t header_len;
+  uint32_t start;
+  uint32_t size;
+  uint16_t tag;
+
+  if (have < 8)
+    return ESP_OK;
+  header_len = s_head[6] | s_head[7] << 8;
+  start = header_len + OTA_CLIENT_TAG_HEADER_SIZE;
+  ESP_RETURN_ON_FALSE(
+      start + OTA_DECODE_HEADER_SIZE <= OTA_CLIENT_HEAD_MAX,
+      ESP_ERR_INVALID_SIZE,
+      TAG,
+      "OTA header of %" PRIu32 " bytes",
+      header_len);
+  if (have < start)
+    return ESP_OK;
+  ESP_RETURN_ON_FALSE(
+      (s_head[0] | s_head[1] << 8 | s_head[2] << 16 |
+       (uint32_t)s_head[3] << 24) == ZB_ZCL_OTA_UPGRADE_FILE_HEADER_FILE_ID,
+      ESP_ERR_INVALID_ARG,
+      TAG,
+      "not an OTA file");
+  tag = s_head[header_len] | s_head[header_len + 1] << 8;
+  size = s_head[header_len + 2] | s_head[header_len + 3] << 8 |
+         s_head[header_len + 4] << 16 |
+         (uint32_t)s_head[header_len + 5] << 24;
+  ESP_RETURN_ON_FALSE(
+      start + size <= s_file.file_size,
+      ESP_ERR_INVALID_SIZE,
+      TAG,
+      "sub-element of %" PRIu32 " bytes",
+      size);
+  if (tag == OTA_DECODE_TAG)
+  {
+    if (have < start + OTA_DECODE_HEADER_SIZE)
+      return ESP_OK;
+    ESP_RETURN_ON_FALSE(
+        size > OTA_DECODE_HEADER_SIZE,
+        ESP_ERR_INVALID_SIZE,
+        TAG,
+        "empty compressed image");
+    ESP_RETURN_ON_ERROR(
+        ota_decode_begin(
+            &s_file.decoder,
+            &s_head[start],
+            s_partition,
+            ota_client_flash_write),
+        TAG,
+        "compressed image");
+    start += OTA_DECODE_HEADER_SIZE;
+    size -= OTA_DECODE_HEADER_SIZE;
+  }
+  else
+  {
+    ESP_RETURN_ON_FALSE(
+        tag == ZB_ZCL_OTA_UPGRADE_FILE_TAG_UPGRADE_IMAGE,
+        ESP_ERR_NOT_SUPPORTED,
+        TAG,
+        "first element 0x%04x",
+        tag);
+    ESP_RETURN_ON_FALSE(
+        size && size <= s_partition->size,
+        ESP_ERR_INVALID_SIZE,
+        TAG,
+        "image of %" PRIu32 " bytes",
+        size);
+  }
+  s_file.tag = tag;
+  s_file.image_start = start;
+  s_file.image_size = size;
+  ESP_LOGI(
+      TAG,
+      "Image data of %" PRIu32 " bytes at offset %" PRIu32 " to %s",
+      size,
+      start,
+      s_partition->label);
+  return ESP_OK;
+}
+
+/* file bytes from offset, in order */
+static esp_err_t ota_client_feed(
+    uint32_t offset, const uint8_t* data, uint32_t len)
+{
+  while (len && !s_file.image_start)
+  {
+    ESP_RETURN_ON_FALSE(
+        offset < OTA_CLIENT_HEAD_MAX,
+        ESP_ERR_INVALID_SIZE,
+        TAG,
+        "OTA header too long");
+    s_head[offset++] = *data++;
+    --len;
+    ESP_RETURN_ON_ERROR(ota_client_parse_head(offset), TAG, "OTA header");
+  }
+  /* the sub-elements after the image are not used */
+  if (!len || offset >= s_file.image_start + s_file.image_size)
+    return ESP_OK;
+  uint32_t at = offset - s_file.image_start;
+  if (len > s_file.image_size - at)
+    len = s_file.image_size - at;
+  if (s_file.tag == OTA_DECODE_TAG)
+    return ota_decode_feed(&s_file.decoder, data, len);
+  return ota_client_flash_write(at, data, len);
+}
+
+/* parsed by hand, ZB_ZCL_OTA_UPGRADE_GET_QUERY_NEXT_IMAGE_RES traces with
+ * the stack trace settings, not available to the application */
+static void ota_client_offer(zb_bufid_t bufid)
+{
+  const zb_zcl_ota_upgrade_query_next_image_res_t* res = zb_buf_begin(bufid);
+
+  if (zb_buf_len(bufid) < sizeof(*res) ||
+      res->status != ZB_ZCL_STATUS_SUCCESS)
+    return;
+  memset(&s_offer, 0, sizeof(s_offer));
+  ZB_HTOLE16(&s_offer.manufacturer, &res->manufacturer);
+  ZB_HTOLE16(&s_offer.image_type, &res->image_type);
+  ZB_HTOLE32(&s_offer.file_version, &res->file_version);
+  ZB_HTOLE32(&s_offer.file_size, &res->image_size);
+}
+
+/* the stack asks for the next block with the data size of its client
+ * variables */
+static void ota_client_set_block_size(uint8_t size)
+{
+  zb_zcl_attr_t* attr = zb_zcl_get_attr_desc_a(
+      s_endpoint,
+      ZB_ZCL_CLUSTER_ID_OTA_UPGRADE,
+      ZB_ZCL_CLUSTER_CLIENT_ROLE,
+      ZB_ZCL_ATTR_OTA_UPGRADE_CLIENT_DATA_ID);
+
+  if (attr)
+    ((zb_zcl_ota_upgrade_client_variable_t*)attr->data_p)->max_data_size =
+        size;
+  s_stats.block_size = size;
+}
+
+static void ota_client_pace(bool in_time)
+{
+  if (in_time ? ota_pacer_ok(&s_pacer) : ota_pacer_lost(&s_pacer))
+  {
+    ota_client_set_block_size(s_pacer.size);
+    s_stats.grows = s_pacer.grows;
+    s_stats.backoffs = s_pacer.backoffs;
+  }
+}
+
+/* flash writes and decoding run in their own task, so the stack sends the
+ * next Image Block Request while the block goes to flash */
+static void ota_client_writer(void* arg)
+{
+  ota_client_slot_t* slot;
+
+  for (;;)
+  {
+    xQueueReceive(s_pending, &slot, portMAX_DELAY);
+    if (!s_failed)
+    {
+      int64_t start_us = esp_timer_get_time();
+      if (ota_client_feed(slot->offset, slot->data, slot->len) != ESP_OK ||
+          ota_client_checkpoint(slot->offset + slot->len) != ESP_OK)
+        ota_client_fail();
+      portENTER_CRITICAL(&s_stats_lock);
+      s_stats.write_us += esp_timer_get_time() - start_us;
+      s_stats.offset = slot->offset + slot->len;
+      portEXIT_CRITICAL(&s_stats_lock);
+    }
+    xQueueSend(s_free, &slot, 0);
+  }
+}
+
+static esp_err_t ota_client_queue(
+    uint32_t offset, const uint8_t* data, uint32_t len)
+{
+  ota_client_slot_t* slot;
+
+  ESP_RETURN_ON_FALSE(
+      len <= sizeof(slot->data),
+      ESP_ERR_INVALID_SIZE,
+      TAG,
+      "block of %" PRIu32 " bytes",
+      len);
+  if (xQueueReceive(s_free, &slot, 0) != pdTRUE)
+  {
+    /* the writer is behind, the stack waits with it */
+    ++s_stats.write_waits;
+    ESP_RETURN_ON_FALSE(
+        xQueueReceive(
+            s_free, &slot, pdMS_TO_TICKS(OTA_CLIENT_WRITE_WAIT_MS)) ==
+            pdTRUE,
+        ESP_ERR_TIMEOUT,
+        TAG,
+        "flash writer stuck");
+  }
+  slot->offset = offset;
+  slot->len = len;
+  memcpy(slot->data, data, len);
+  xQueueSend(s_pending, &slot, 0);
+  return ESP_OK;
+}
+
+/* wait until the writer is idle, before the Zigbee task uses the image */
+static esp_err_t ota_client_drain(void)
+{
+  ota_client_slot_t* slots[OTA_CLIENT_WRITE_SLOTS];
+  esp_err_t err = ESP_OK;
+  int n = 0;
+
+  while (n < OTA_CLIENT_WRITE_SLOTS && err == ESP_OK)
+  {
+    if (xQueueReceive(
+            s_free, &slots[n], pdMS_TO_TICKS(OTA_CLIENT_WRITE_WAIT_MS)) ==
+        pdTRUE)
+      ++n;
+    else
+      err = ESP_ERR_TIMEOUT;
+  }
+  while (n--)
+    xQueueSend(s_free, &slots[n], 0);
+  return err;
+}
+
+static void ota_client_image_block(zb_bufid_t bufid)
+{
+  zb_zcl_ota_upgrade_image_block_res_t res;
+  zb_zcl_parse_status_t parsed;
+  uint32_t offset;
+  uint32_t size;
+  int64_t now_us = esp_timer_get_time();
+  bool late;
+
+  if (!s_active || s_failed)
+    return;
+  /* the stack sends the requests, each response answers one */
+  energy_model_radio_tx(OTA_CLIENT_BLOCK_REQUEST_BYTES);
+  ZB_ZCL_OTA_UPGRADE_GET_IMAGE_BLOCK_RES(&res, bufid, parsed);
+  if (parsed != ZB_ZCL_PARSE_STATUS_SUCCESS)
+    return;
+  /* the server or the parent holding the data is loaded */
+  if (res.status == ZB_ZCL_STATUS_WAIT_FOR_DATA)
+  {
+    ota_client_pace(false);
+    return;
+  }
+  if (res.status != ZB_ZCL_STATUS_SUCCESS ||
+      res.response.success.file_version != s_file.file_version)
+    return;
+  offset = res.response.success.file_offset;
+  size = res.response.success.data_size;
+  late = s_block_us && now_us - s_block_us > OTA_CLIENT_BLOCK_LATE_MS * 1000;
+  s_block_us = now_us;
+  ++s_stats.blocks;
+  s_stats.bytes += size;
+  poll_control_fast_poll(OTA_CLIENT_FAST_POLL_QS);
+  /* a block after a gap is dropped, the stack asks for it again */
+  if (offset > s_next)
+  {
+    ota_client_pace(false);
+    return;
+  }
+  if (offset + size <= s_next)
+  {
+    ++s_stats.duplicates;
+    /* asked again, unless the stack started over below the resume point */
+    if (offset >= s_stats.resumed_at)
+      ota_client_pace(false);
+    return;
+  }
+  ota_client_pace(!late);
+  /* only what is not in flash yet */
+  if (ota_client_queue(
+          s_next,
+          res.response.success.image_data + (s_next - offset),
+          offset + size - s_next) != ESP_OK)
+  {
+    ota_client_fail();
+    return;
+  }
+  s_next = offset + size;
+}
+
+/* ask the stack to go on from the resume point, should it request the file
+ * from the start anyway, the blocks already in flash are only counted */
+static void ota_client_set_file_offset(uint32_t offset)
+{
+  esp_zb_zcl_set_attribute_val(
+      s_endpoint,
+      ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE,
+      ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+      ESP_ZB_ZCL_ATTR_OTA_UPGRADE_FILE_OFFSET_ID,
+      &offset,
+      false);
+}
+
+static esp_err_t ota_client_begin(void)
+{
+  ota_client_file_t saved;
+
+  ESP_RETURN_ON_FALSE(
+      s_partition, ESP_ERR_NOT_FOUND, TAG, "no OTA partition");
+  ESP_RETURN_ON_FALSE(
+      s_offer.file_size, ESP_ERR_INVALID_STATE, TAG, "no image offered");
+  ESP_RETURN_ON_ERROR(ota_client_drain(), TAG, "flash writer");
+  if (ota_client_load(&saved) && saved.written &&
+      ota_client_same_file(&saved, &s_offer) &&
+      (saved.tag != OTA_DECODE_TAG ||
+       ota_decode_resume(
+           &saved.decoder, s_partition, ota_client_flash_write) == ESP_OK))
+  {
+    s_file = saved;
+    s_next = saved.image_start + saved.consumed;
+  }
+  else
+  {
+    s_file = s_offer;
+    s_next = 0;
+    ota_client_save(NULL);
+  }
+  /* the sector of the resume point was erased before it was saved, the
+   * bytes written after it are written again with the same values */
+  s_written = s_file.written;
+  s_erased = (s_written + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+  s_active = true;
+  s_failed = false;
+  portENTER_CRITICAL(&s_stats_lock);
+  s_stats.file_version = s_file.file_version;
+  s_stats.file_size = s_file.file_size;
+  s_stats.image_size = 0;
+  s_stats.transfer_pct = 0;
+  s_stats.full_image_us = 0;
+  s_stats.offset = s_next;
+  s_stats.resumed_at = s_next;
+  s_stats.blocks = 0;
+  s_stats.bytes = 0;
+  s_stats.duplicates = 0;
+  s_stats.link_failures = 0;
+  s_stats.checkpoints = 0;
+  s_stats.write_waits = 0;
+  s_stats.write_us = 0;
+  ++s_stats.transfers;
+  portEXIT_CRITICAL(&s_stats_lock);
+  ota_pacer_init(
+      &s_pacer,
+      OTA_CLIENT_BLOCK_MIN,
+      OTA_CLIENT_MAX_DATA_SIZE,
+      OTA_CLIENT_BLOCK_START);
+  ota_client_set_block_size(s_pacer.size);
+  s_stats.grows = 0;
+  s_stats.backoffs = 0;
+  s_block_us = 0;
+  s_start_us = esp_timer_get_time();
+  energy_model_get_stats(&s_energy);
+  sleep_tuner_set_busy(true);
+  poll_control_fast_poll(OTA_CLIENT_FAST_POLL_QS);
+  if (s_next)
+    ota_client_set_file_offset(s_next);
+  ESP_LOGI(
+      TAG,
+      "Download of file 0x%08" PRIx32 " (%" PRIu32 " bytes) from %" PRIu32,
+      s_file.file_version,
+      s_file.file_size,
+      s_next);
+  return ESP_OK;
+}
+
+static void ota_client_end(const char* how)
+{
+  ota_client_stats_t stats;
+
+  if (!s_active)
+    return;
+  if (ota_client_drain() != ESP_OK)
+    s_failed = true;
+  /* the rates of the transfer are kept for ota_client_get_stats() */
+  ota_client_snapshot(&stats);
+  portENTER_CRITICAL(&s_stats_lock);
+  s_stats = stats;
+  portEXIT_CRITICAL(&s_stats_lock);
+  s_active = false;
+  /* a broken image is downloaded again from the start */
+  if (s_failed)
+    ota_client_save(NULL);
+  ota_client_log_progress(how);
+  sleep_tuner_set_busy(false);
+  poll_control_fast_poll_stop();
+}
+
+static esp_err_t ota_client_check(void)
+{
+  esp_partition_pos_t pos;
+  esp_image_metadata_t image;
+
+  ESP_RETURN_ON_ERROR(ota_client_drain(), TAG, "flash writer");
+  ESP_RETURN_ON_FALSE(
+      s_active && !s_failed && s_file.image_start &&
+          s_next >= s_file.image_start + s_file.image_size,
+      ESP_ERR_INVALID_STATE,
+      TAG,
+      "image incomplete");
+  if (s_file.tag == OTA_DECODE_TAG &&
+      (ota_decode_flush(&s_file.decoder) != ESP_OK ||
+       !ota_decode_done(&s_file.decoder)))
+  {
+    ota_client_fail();
+    ESP_LOGE(TAG, "Compressed image incomplete");
+    return ESP_ERR_INVALID_SIZE;
+  }
+  s_stats.image_size = s_written;
+  pos.offset = s_partition->address;
+  pos.size = s_partition->size;
+  if (esp_image_verify(ESP_IMAGE_VERIFY, &pos, &image) != ESP_OK)
+  {
+    ota_client_fail();
+    ESP_LOGE(TAG, "Image in %s does not verify", s_partition->label);
+    return ESP_ERR_INVALID_CRC;
+  }
+  ota_client_log_saving();
+  return ESP_OK;
+}
+
+static esp_err_t ota_client_finish(void)
+{
+  ESP_RETURN_ON_ERROR(
+      esp_ota_set_boot_partition(s_partition), TAG, "boot partition");
+  ++s_stats.completed;
+  ota_client_save(NULL);
+  ota_client_end("Upgrade done");
+  ESP_LOGW(TAG, "Restarting on %s", s_partition->label);
+  esp_restart();
+  return ESP_OK;
+}
+
+esp_err_t ota_client_init(uint8_t endpoint)
+{
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  ota_client_file_t saved;
+
+  s_endpoint = endpoint;
+  s_partition = esp_ota_get_next_update_partition(NULL);
+  ESP_RETURN_ON_FALSE(
+      s_partition, ESP_ERR_NOT_FOUND, TAG, "no OTA partition");
+  s_free = xQueueCreate(OTA_CLIENT_WRITE_SLOTS, sizeof(ota_client_slot_t*));
+  s_pending = xQueueCreate(OTA_CLIENT_WRITE_SLOTS, sizeof(ota_client_slot_t*));
+  ESP_RETURN_ON_FALSE(
+      s_free && s_pending, ESP_ERR_NO_MEM, TAG, "writer queues");
+  for (int i = 0; i < OTA_CLIENT_WRITE_SLOTS; ++i)
+  {
+    ota_client_slot_t* slot = &s_slots[i];
+    xQueueSend(s_free, &slot, 0);
+  }
+  ESP_RETURN_ON_FALSE(
+      xTaskCreate(
+          ota_client_writer,
+          "ota_writer",
+          OTA_CLIENT_WRITER_STACK,
+          NULL,
+          OTA_CLIENT_WRITER_PRIORITY,
+          NULL) == pdPASS,
+      ESP_ERR_NO_MEM,
+      TAG,
+      "writer task");
+  ESP_LOGI(
+      TAG,
+      "Running from %s, upgrades go to %s",
+      running->label,
+      s_partition->label);
+  if (ota_client_load(&saved) && saved.written)
+    ESP_LOGI(
+        TAG,
+        "File 0x%08" PRIx32 " resumes at %" PRIu32 "/%" PRIu32,
+        saved.file_version,
+        saved.image_start + saved.consumed,
+        saved.file_size);
+  return ESP_OK;
+}
+
+void* ota_client_parameter(uint16_t hardware_version)
+{
+  esp_zb_ota_upgrade_client_parameter_t config = {
+      .query_timer = OTA_CLIENT_QUERY_INTERVAL_MIN,
+      .hardware_version = hardware_version,
+      .max_data_size = OTA_CLIENT_BLOCK_START,
+  };
+
+  return esp_zb_ota_client_parameter(&config);
+}
+
+bool ota_client_observe(uint8_t bufid)
+{
+  const zb_zcl_parsed_hdr_t* cmd_info =
+      ZB_BUF_GET_PARAM(bufid, zb_zcl_parsed_hdr_t);
+
+  if (cmd_info->cluster_id != ZB_ZCL_CLUSTER_ID_OTA_UPGRADE ||
+      cmd_info->is_common_command ||
+      cmd_info->cmd_direction != ZB_ZCL_FRAME_DIRECTION_TO_CLI ||
+      ZB_ZCL_PARSED_HDR_SHORT_DATA(cmd_info).dst_endpoint != s_endpoint)
+    return false;
+  s_server = ZB_ZCL_PARSED_HDR_SHORT_DATA(cmd_info).source.u.short_addr;
+  switch (cmd_info->cmd_id)
+  {
+  case ZB_ZCL_CMD_OTA_UPGRADE_QUERY_NEXT_IMAGE_RESP_ID:
+    ota_client_offer(bufid);
+    break;
+  case ZB_ZCL_CMD_OTA_UPGRADE_IMAGE_BLOCK_RESP_ID:
+    ota_client_image_block(bufid);
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+void ota_client_link_failed(uint16_t short_addr)
+{
+  if (!s_active || s_failed || short_addr != s_server)
+    return;
+  /* an Image Block Request the MAC or APS layer did not deliver */
+  energy_model_radio_tx(OTA_CLIENT_BLOCK_REQUEST_BYTES);
+  ++s_stats.link_failures;
+  ota_client_pace(false);
+}
+
+esp_err_t ota_client_status(esp_zb_zcl_ota_upgrade_status_t status)
+{
+  switch (status)
+  {
+  case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_START:
+    return ota_client_begin();
+  case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_RECEIVE:
+    /* the data was queued from the raw command handler */
+    return s_failed ? ESP_FAIL : ESP_OK;
+  case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_CHECK:
+    return ota_client_check();
+  case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_FINISH:
+    return ota_client_finish();
+  case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ABORT:
+    /* the resume point is kept, the next offer of the file resumes */
+    ota_client_end("Aborted");
+    return ESP_OK;
+  default:
+    ESP_LOGI(TAG, "Upgrade status %d", status);
+    return ESP_OK;
+  }
+}
+
+void ota_client_confirm(void)
+{
+  esp_ota_img_states_t state;
+
+  if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) ==
+          ESP_OK &&
+      state == ESP_OTA_IMG_PENDING_VERIFY)
+  {
+    esp_ota_mark_app_valid_cancel_rollback();
+    ESP_LOGI(TAG, "New firmware joined, rollback cancelled");
+  }
+}
+
+void ota_client_get_stats(ota_client_stats_t* stats)
+{
+  ota_client_snapshot(stats);
+}
@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * OTA Upgrade client streaming the image to the inactive app partition
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "zcl/esp_zigbee_zcl_ota.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* image data asked for in each Image Block Request: the size starts at
+ * OTA_CLIENT_BLOCK_START, grows up to the largest block an unfragmented
+ * Image Block Response carries while blocks arrive in time and is cut
+ * down to OTA_CLIENT_BLOCK_MIN when they do not: with long addresses or a
+ * source route in the frames, the largest block does not fit any more */
+#define OTA_CLIENT_MAX_DATA_SIZE 64
+#define OTA_CLIENT_BLOCK_START 32
+#define OTA_CLIENT_BLOCK_MIN 16
+/* a block arriving later than this after the previous one was asked again */
+#define OTA_CLIENT_BLOCK_LATE_MS 2000
+/* blocks received and waiting for flash, the stack stops asking beyond */
+#define OTA_CLIENT_WRITE_SLOTS 2
+#define OTA_CLIENT_WRITE_WAIT_MS 1000
+/* Query Next Image period, minutes */
+#define OTA_CLIENT_QUERY_INTERVAL_MIN \
+  ESP_ZB_ZCL_OTA_UPGRADE_QUERY_TIMER_COUNT_DEF
+/* image bytes between two resume points saved to NVS, whole flash sectors */
+#define OTA_CLIENT_CHECKPOINT_BYTES (16 * 1024)
+/* fast poll window kept open while blocks arrive, quarter seconds */
+#define OTA_CLIENT_FAST_POLL_QS (30 * 4)
+
+  typedef struct
+  {
+    uint32_t file_version; /* of the transfer in progress or the last one */
+    uint32_t file_size;
+    uint32_t image_size; /* written to flash, what a full image would send */
+    uint32_t offset;     /* file offset written up to */
+    uint32_t resumed_at; /* file offset the transfer resumed from */
+    uint32_t blocks;     /* Image Block Responses of the transfer */
+    uint32_t bytes;
+    uint32_t duplicates; /* blocks already in flash, sent again */
+    uint32_t link_failures; /* frames to the server not delivered */
+    uint32_t checkpoints;
+    uint8_t block_size; /* data size asked for now */
+    uint32_t grows;     /* block size changes of the transfer */
+    uint32_t backoffs;
+    uint32_t write_waits; /* blocks that waited for a free write slot */
+    uint64_t write_us;    /* flash and decoder time, off the Zigbee task */
+    uint32_t transfers; /* since boot, completed or not */
+    uint32_t completed;
+    uint32_t failures; /* flash errors and images that did not verify */
+    uint64_t elapsed_us;
+    uint64_t radio_us; /* radio RX and TX time of the energy model */
+    uint64_t awake_us;
+    uint32_t throughput_bps;  /* bytes per second */
+    uint32_t radio_ms_per_mb; /* radio time per MB received */
+    uint32_t awake_ms_per_mb;
+    uint32_t transfer_pct;  /* file size against the image size */
+    uint64_t full_image_us; /* estimated transfer time of a full image */
+  } ota_client_stats_t;
+
+  /**
+   * @brief Find the inactive app partition and the saved resume point
+   *
+   * @param endpoint    endpoint of the OTA Upgrade client cluster.
+   */
+  esp_err_t ota_client_init(uint8_t endpoint);
+
+  /**
+   * @brief Client parameter attribute value, built by the stack
+   *
+   * The value of ESP_ZB_ZCL_ATTR_OTA_UPGRADE_CLIENT_PARAMETER_ID, to add
+   * with the other attributes of the client cluster.
+   */
+  void* ota_client_parameter(uint16_t hardware_version);
+
+  /**
+   * @brief Write the image blocks to flash, call from the raw command
+   * handler
+   *
+   * The commands are only observed, the stack still runs the transfer.
+   *
+   * @return true for an OTA Upgrade command to the client endpoint
+   */
+  bool ota_client_observe(uint8_t bufid);
+
+  /**
+   * @brief Follow the upgrade, call from ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID
+   *
+   * @return an error to abort the transfer or refuse the image.
+   */
+  esp_err_t ota_client_status(esp_zb_zcl_ota_upgrade_status_t status);
+
+  /**
+   * @brief A frame was not acknowledged, call from
+   * ESP_ZB_ZDO_DEVICE_UNAVAILABLE
+   *
+   * During a transfer, a frame to the server cuts the block size like a
+   * late block.
+   *
+   * @param short_addr  destination of the frame.
+   */
+  void ota_client_link_failed(uint16_t short_addr);
+
+  /**
+   * @brief Cancel the rollback of a new firmware, call once joined
+   */
+  void ota_client_confirm(void);
+
+  void ota_client_get_stats(ota_client_stats_t* stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
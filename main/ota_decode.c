@@ -0,0 +1,276 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Streaming decoder of compressed and delta OTA images
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "ota_decode.h"
+#include <inttypes.h>
+#include <string.h>
+#include "esp_app_desc.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+
+/*
+ * The ops, after the header:
+ *   0x00-0x7f  literal, ctrl + 1 bytes follow
+ *   0x80-0xbf  window match of (ctrl & 0x3f) + 3 bytes, then the distance
+ *              minus one on 2 bytes
+ *   0xc0-0xff  base copy of ((ctrl & 0x3f) << 8 | byte) + 1 bytes, then the
+ *              offset in the running firmware on 3 bytes
+ * All values are little endian.
+ */
+#define OTA_DECODE_OP_MATCH 0x80
+#define OTA_DECODE_OP_BASE 0xc0
+#define OTA_DECODE_MATCH_MIN 3
+/* base bytes read at once */
+#define OTA_DECODE_BASE_CHUNK 64
+
+static const char* TAG = "ota_decode";
+
+/* the last decoded bytes, also the write buffer of the sink */
+static uint8_t s_window[1 << OTA_DECODE_WINDOW_BITS];
+static const esp_partition_t* s_base;
+static ota_decode_sink_t s_sink;
+
+static uint32_t ota_decode_le(const uint8_t* p, int bytes)
+{
+  uint32_t v = 0;
+
+  while (bytes--)
+    v = v << 8 | p[bytes];
+  return v;
+}
+
+static esp_err_t ota_decode_put(
+    ota_decode_state_t* state, const uint8_t* data, uint32_t len)
+{
+  uint32_t size = 1u << state->window_bits;
+
+  ESP_RETURN_ON_FALSE(
+      len <= state->image_size - state->out,
+      ESP_ERR_INVALID_SIZE,
+      TAG,
+      "data past the image end");
+  while (len)
+  {
+    /* the window is full of bytes the sink has not seen */
+    if (state->out - state->flushed == size)
+      ESP_RETURN_ON_ERROR(ota_decode_flush(state), TAG, "flush");
+    uint32_t at = state->out & (size - 1);
+    uint32_t n = size - at;
+    if (n > size - (state->out - state->flushed))
+      n = size - (state->out - state->flushed);
+    if (n > len)
+      n = len;
+    memcpy(&s_window[at], data, n);
+    state->out += n;
+    data += n;
+    len -= n;
+  }
+  return ESP_OK;
+}
+
+static esp_err_t ota_decode_match(ota_decode_state_t* state)
+{
+  uint32_t size = 1u << state->window_bits;
+  uint32_t len = (state->ctrl & 0x3f) + OTA_DECODE_MATCH_MIN;
+  uint32_t distance = ota_decode_le(state->arg, 2) + 1;
+
+  ESP_RETURN_ON_FALSE(
+      distance <= size && distance <= state->out,
+      ESP_ERR_INVALID_ARG,
+      TAG,
+      "match %" PRIu32 " bytes back at %" PRIu32,
+      distance,
+      state->out);
+  /* byte by byte, a match may overlap what it produces */
+  while (len--)
+  {
+    uint8_t byte = s_window[(state->out - distance) & (size - 1)];
+    ESP_RETURN_ON_ERROR(ota_decode_put(state, &byte, 1), TAG, "match");
+  }
+  return ESP_OK;
+}
+
+static esp_err_t ota_decode_base(ota_decode_state_t* state)
+{
+  uint8_t chunk[OTA_DECODE_BASE_CHUNK];
+  uint32_t len = ((state->ctrl & 0x3f) << 8 | state->arg[0]) + 1;
+  uint32_t from = ota_decode_le(&state->arg[1], 3);
+
+  ESP_RETURN_ON_FALSE(
+      from + len <= state->base_size,
+      ESP_ERR_INVALID_ARG,
+      TAG,
+      "base copy at %" PRIu32,
+      from);
+  while (len)
+  {
+    uint32_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+    ESP_RETURN_ON_ERROR(
+        esp_partition_read(s_base, from, chunk, n), TAG, "base read");
+    ESP_RETURN_ON_ERROR(ota_decode_put(state, chunk, n), TAG, "base copy");
+    from += n;
+    len -= n;
+  }
+  return ESP_OK;
+}
+
+esp_err_t ota_decode_begin(
+    ota_decode_state_t* state,
+    const uint8_t* header,
+    const esp_partition_t* target,
+    ota_decode_sink_t sink)
+{
+  memset(state, 0, sizeof(*state));
+  state->window_bits = header[1];
+  state->image_size = ota_decode_le(&header[2], 4);
+  state->base_size = ota_decode_le(&header[6], 4);
+  ESP_RETURN_ON_FALSE(
+      header[0] == OTA_DECODE_VERSION,
+      ESP_ERR_NOT_SUPPORTED,
+      TAG,
+      "version %d",
+      header[0]);
+  ESP_RETURN_ON_FALSE(
+      state->window_bits >= 8 &&
+          state->window_bits <= OTA_DECODE_WINDOW_BITS,
+      ESP_ERR_NOT_SUPPORTED,
+      TAG,
+      "window of %d bits",
+      state->window_bits);
+  ESP_RETURN_ON_FALSE(
+      state->image_size && state->image_size <= target->size,
+      ESP_ERR_INVALID_SIZE,
+      TAG,
+      "image of %" PRIu32 " bytes",
+      state->image_size);
+  if (state->base_size)
+  {
+    s_base = esp_ota_get_running_partition();
+    ESP_RETURN_ON_FALSE(
+        state->base_size <= s_base->size &&
+            !memcmp(
+                &header[10],
+                esp_app_get_description()->app_elf_sha256,
+                sizeof(esp_app_get_description()->app_elf_sha256)),
+        ESP_ERR_INVALID_VERSION,
+        TAG,
+        "delta against another firmware");
+  }
+  s_sink = sink;
+  ESP_LOGI(
+      TAG,
+      "%s image of %" PRIu32 " bytes, %d byte window",
+      state->base_size ? "Delta" : "Compressed",
+      state->image_size,
+      1 << state->window_bits);
+  return ESP_OK;
+}
+
+esp_err_t ota_decode_resume(
+    ota_decode_state_t* state,
+    const esp_partition_t* target,
+    ota_decode_sink_t sink)
+{
+  uint32_t size = 1u << state->window_bits;
+  uint32_t from = state->flushed > size ? state->flushed - size : 0;
+
+  ESP_RETURN_ON_FALSE(
+      state->out == state->flushed &&
+          state->window_bits <= OTA_DECODE_WINDOW_BITS,
+      ESP_ERR_INVALID_STATE,
+      TAG,
+      "saved state");
+  if (state->base_size)
+    s_base = esp_ota_get_running_partition();
+  s_sink = sink;
+  /* the window is the end of what is already in flash */
+  while (from < state->out)
+  {
+    uint32_t at = from & (size - 1);
+    uint32_t n = size - at;
+    if (n > state->out - from)
+      n = state->out - from;
+    ESP_RETURN_ON_ERROR(
+        esp_partition_read(target, from, &s_window[at], n),
+        TAG,
+        "window read");
+    from += n;
+  }
+  return ESP_OK;
+}
+
+esp_err_t ota_decode_feed(
+    ota_decode_state_t* state, const uint8_t* data, uint32_t len)
+{
+  while (len)
+  {
+    if (state->remaining)
+    {
+      uint32_t n = len < state->remaining ? len : state->remaining;
+      ESP_RETURN_ON_ERROR(ota_decode_put(state, data, n), TAG, "literal");
+      state->remaining -= n;
+      data += n;
+      len -= n;
+      continue;
+    }
+    if (!state->need)
+    {
+      uint8_t ctrl = *data++;
+      --len;
+      if (ctrl < OTA_DECODE_OP_MATCH)
+      {
+        state->remaining = ctrl + 1;
+        continue;
+      }
+      state->ctrl = ctrl;
+      state->have = 0;
+      state->need = ctrl < OTA_DECODE_OP_BASE ? 2 : 4;
+      continue;
+    }
+    state->arg[state->have++] = *data++;
+    --len;
+    if (--state->need)
+      continue;
+    ESP_RETURN_ON_ERROR(
+        state->ctrl < OTA_DECODE_OP_BASE ? ota_decode_match(state)
+                                         : ota_decode_base(state),
+        TAG,
+        "op 0x%02x",
+        state->ctrl);
+  }
+  return ESP_OK;
+}
+
+esp_err_t ota_decode_flush(ota_decode_state_t* state)
+{
+  uint32_t size = 1u << state->window_bits;
+
+  while (state->flushed < state->out)
+  {
+    uint32_t at = state->flushed & (size - 1);
+    uint32_t n = size - at;
+    if (n > state->out - state->flushed)
+      n = state->out - state->flushed;
+    ESP_RETURN_ON_ERROR(
+        s_sink(state->flushed, &s_window[at], n), TAG, "sink");
+    state->flushed += n;
+  }
+  return ESP_OK;
+}
+
+bool ota_decode_done(const ota_decode_state_t* state)
+{
+  return state->out == state->image_size && !state->remaining &&
+         !state->need;
+}
@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Streaming decoder of compressed and delta OTA images
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* manufacturer specific sub-element holding a compressed image, made by
+ * tools/ota_pack.py */
+#define OTA_DECODE_TAG 0xf000
+/* in front of the ops: version, window bits, image size, base size and
+ * ELF SHA-256 of the base firmware */
+#define OTA_DECODE_HEADER_SIZE 42
+#define OTA_DECODE_VERSION 1
+/* largest LZ window, the RAM of the decoder: files made with a larger
+ * window are refused */
+#define OTA_DECODE_WINDOW_BITS 12
+
+  /**
+   * @brief Receives the image in order, offset from the image start
+   */
+  typedef esp_err_t (*ota_decode_sink_t)(
+      uint32_t offset, const uint8_t* data, uint32_t len);
+
+  /**
+   * @brief Decoder state, small enough to be saved with a resume point
+   *
+   * The window is not part of it, it is read back from the image.
+   */
+  typedef struct
+  {
+    uint32_t image_size; /* decoded */
+    uint32_t base_size;  /* running firmware bytes referenced, 0 if none */
+    uint32_t out;        /* image bytes decoded */
+    uint32_t flushed;    /* image bytes handed to the sink */
+    uint32_t remaining;  /* literal bytes left in the current op */
+    uint8_t window_bits;
+    uint8_t ctrl; /* op waiting for its arguments */
+    uint8_t need; /* argument bytes still missing */
+    uint8_t have;
+    uint8_t arg[4];
+  } ota_decode_state_t;
+
+  /**
+   * @brief Start decoding an image
+   *
+   * @param header      OTA_DECODE_HEADER_SIZE bytes from the sub-element.
+   * @param target      partition the image is written to.
+   * @param sink        writes the decoded image, into target.
+   *
+   * @return ESP_ERR_INVALID_VERSION if the file is a delta against another
+   * firmware than the running one.
+   */
+  esp_err_t ota_decode_begin(
+      ota_decode_state_t* state,
+      const uint8_t* header,
+      const esp_partition_t* target,
+      ota_decode_sink_t sink);
+
+  /**
+   * @brief Go on from a saved state, the window is read back from target
+   */
+  esp_err_t ota_decode_resume(
+      ota_decode_state_t* state,
+      const esp_partition_t* target,
+      ota_decode_sink_t sink);
+
+  /**
+   * @brief Decode the next bytes of the sub-element, in any slicing
+   */
+  esp_err_t ota_decode_feed(
+      ota_decode_state_t* state, const uint8_t* data, uint32_t len);
+
+  /**
+   * @brief Hand the decoded bytes still in the window to the sink
+   */
+  esp_err_t ota_decode_flush(ota_decode_state_t* state);
+
+  bool ota_decode_done(const ota_decode_state_t* state);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
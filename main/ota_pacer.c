@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * OTA block size, grown while the link keeps up and cut on losses
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "ota_pacer.h"
+
+void ota_pacer_init(
+    ota_pacer_t* pacer, uint8_t min, uint8_t max, uint8_t start)
+{
+  pacer->min = min;
+  pacer->max = max;
+  pacer->size = start < min ? min : start > max ? max : start;
+  pacer->streak = 0;
+  pacer->ceiling = max;
+  pacer->good = 0;
+  pacer->since_loss = 0;
+  pacer->grows = 0;
+  pacer->backoffs = 0;
+}
+
+bool ota_pacer_ok(ota_pacer_t* pacer)
+{
+  /* below the size lost at last, until it is tried again */
+  uint8_t limit =
+      pacer->ceiling < pacer->max ? pacer->ceiling - 1 : pacer->max;
+
+  if (pacer->size > pacer->good)
+    pacer->good = pacer->size;
+  if (pacer->since_loss < OTA_PACER_PROBE_AFTER &&
+      ++pacer->since_loss == OTA_PACER_PROBE_AFTER)
+  {
+    pacer->ceiling = pacer->max;
+    pacer->good = pacer->size;
+  }
+  if (pacer->size >= limit || ++pacer->streak < OTA_PACER_GROW_AFTER)
+    return false;
+  pacer->streak = 0;
+  pacer->size = limit - pacer->size < OTA_PACER_STEP
+                    ? limit
+                    : pacer->size + OTA_PACER_STEP;
+  ++pacer->grows;
+  return true;
+}
+
+bool ota_pacer_lost(ota_pacer_t* pacer)
+{
+  pacer->streak = 0;
+  pacer->since_loss = 0;
+  /* a size that never went through does not fit the route, one that did
+   * met noise and is tried again on the next growth */
+  if (pacer->size > pacer->good)
+    pacer->ceiling = pacer->size;
+  if (pacer->size == pacer->min)
+    return false;
+  /* by a quarter only, most losses are noise a smaller block hardly helps */
+  pacer->size = pacer->size - pacer->size / 4;
+  if (pacer->size < pacer->min)
+    pacer->size = pacer->min;
+  ++pacer->backoffs;
+  return true;
+}
@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * OTA block size, grown while the link keeps up and cut on losses
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* blocks in a row received in time before the size grows */
+#define OTA_PACER_GROW_AFTER 4
+/* bytes added to the block size on growth */
+#define OTA_PACER_STEP 8
+/* blocks in time before the size lost at last is tried again */
+#define OTA_PACER_PROBE_AFTER 256
+
+  /**
+   * @brief Additive increase, multiplicative decrease of the block size
+   *
+   * Plain data, also built on the host by tools/ota_pacer_bench.c.
+   */
+  typedef struct
+  {
+    uint8_t size; /* data size of the next Image Block Request */
+    uint8_t min;
+    uint8_t max;
+    uint8_t streak;  /* blocks in time since the last change */
+    uint8_t ceiling; /* sizes from here were lost lately */
+    uint8_t good;    /* largest size received since the last probe */
+    uint16_t since_loss;
+    uint32_t grows;
+    uint32_t backoffs;
+  } ota_pacer_t;
+
+  void ota_pacer_init(
+      ota_pacer_t* pacer, uint8_t min, uint8_t max, uint8_t start);
+
+  /**
+   * @brief A block arrived in time
+   *
+   * @return true if the block size changed.
+   */
+  bool ota_pacer_ok(ota_pacer_t* pacer);
+
+  /**
+   * @brief A request timed out, was sent again or the server asked to wait
+   *
+   * @return true if the block size changed.
+   */
+  bool ota_pacer_lost(ota_pacer_t* pacer);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
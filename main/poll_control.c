@@ -0,0 +1,301 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Poll Control cluster server
+ *
+ * The cluster is a custom one for esp-zigbee, so its commands are taken
+ * from the raw command handler. The poll intervals are applied through
+ * zb_connectivity, which owns the ZBOSS poll manager settings: a fast poll
+ * window lowers the joined poll interval to the short poll interval and an
+ * alarm restores the long poll interval as soon as the window closes.
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "poll_control.h"
+#include <inttypes.h>
+#include "energy_model.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+#include "zboss_api.h"
+#include "zcl/zb_zcl_poll_control.h"
+
+static const char* TAG = "poll_control";
+
+static uint8_t s_endpoint;
+static int64_t s_checked_in_us;
+static int64_t s_fast_since_us; /* 0 when not fast polling */
+static int64_t s_fast_until_us;
+/* fast polling asked by a client or the application, not only the wait
+ * for the Check-in responses */
+static bool s_fast_granted;
+static poll_control_stats_t s_stats;
+
+static uint32_t poll_control_qs_to_ms(uint32_t qs)
+{
+  return qs * 250;
+}
+
+/* value held by the stack, clients may write the RW attributes */
+static const void* poll_control_attr(uint16_t attr_id)
+{
+  zb_zcl_attr_t* attr = zb_zcl_get_attr_desc_a(
+      s_endpoint,
+      ZB_ZCL_CLUSTER_ID_POLL_CONTROL,
+      ZB_ZCL_CLUSTER_SERVER_ROLE,
+      attr_id);
+
+  return attr ? attr->data_p : NULL;
+}
+
+static uint32_t poll_control_get_u32(uint16_t attr_id, uint32_t fallback)
+{
+  const void* value = poll_control_attr(attr_id);
+
+  return value ? *(const uint32_t*)value : fallback;
+}
+
+static uint16_t poll_control_get_u16(uint16_t attr_id, uint16_t fallback)
+{
+  const void* value = poll_control_attr(attr_id);
+
+  return value ? *(const uint16_t*)value : fallback;
+}
+
+static void poll_control_set(uint16_t attr_id, void* value)
+{
+  esp_zb_zcl_set_attribute_val(
+      s_endpoint,
+      ESP_ZB_ZCL_CLUSTER_ID_POLL_CONTROL,
+      ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+      attr_id,
+      value,
+      false);
+}
+
+static uint16_t poll_control_short_poll_qs(void)
+{
+  return poll_control_get_u16(
+      ZB_ZCL_ATTR_POLL_CONTROL_SHORT_POLL_INTERVAL_ID,
+      POLL_CONTROL_SHORT_POLL_INTERVAL_QS);
+}
+
+static void poll_control_fast_poll_end(uint8_t param)
+{
+  if (!s_fast_since_us)
+    return;
+  uint32_t ms = (esp_timer_get_time() - s_fast_since_us) / 1000;
+  s_stats.fast_poll_ms += ms;
+  s_fast_since_us = 0;
+  s_fast_granted = false;
+  zb_conn_set_fast_poll_ms(0);
+  ESP_LOGI(TAG, "Fast poll done after %" PRIu32 " ms, back to long poll", ms);
+}
+
+/* open or extend the window, it closes at the latest end asked for */
+static void poll_control_fast_poll_start(uint16_t timeout_qs)
+{
+  int64_t now = esp_timer_get_time();
+  int64_t until;
+
+  if (timeout_qs > POLL_CONTROL_FAST_POLL_TIMEOUT_MAX_QS)
+    timeout_qs = POLL_CONTROL_FAST_POLL_TIMEOUT_MAX_QS;
+  until = now + poll_control_qs_to_ms(timeout_qs) * 1000LL;
+  if (!s_fast_since_us)
+  {
+    s_fast_since_us = now;
+    s_fast_until_us = 0;
+    ++s_stats.fast_polls;
+  }
+  zb_conn_set_fast_poll_ms(poll_control_qs_to_ms(poll_control_short_poll_qs()));
+  if (until <= s_fast_until_us)
+    return;
+  s_fast_until_us = until;
+  esp_zb_scheduler_alarm_cancel(poll_control_fast_poll_end, 0);
+  esp_zb_scheduler_alarm(
+      poll_control_fast_poll_end, 0, poll_control_qs_to_ms(timeout_qs));
+}
+
+void poll_control_fast_poll(uint16_t timeout_qs)
+{
+  s_fast_granted = true;
+  poll_control_fast_poll_start(timeout_qs);
+}
+
+void poll_control_fast_poll_stop(void)
+{
+  esp_zb_scheduler_alarm_cancel(poll_control_fast_poll_end, 0);
+  poll_control_fast_poll_end(0);
+}
+
+bool poll_control_is_fast_polling(void)
+{
+  return s_fast_since_us != 0;
+}
+
+static zb_uint8_t poll_control_check_in_response(zb_bufid_t bufid)
+{
+  zb_zcl_poll_control_check_in_res_t res;
+  zb_zcl_parse_status_t parsed;
+
+  ZB_ZCL_POLL_CONTROL_GET_CHECK_IN_RES(&res, bufid, parsed);
+  if (parsed != ZB_ZCL_PARSE_STATUS_SUCCESS)
+    return ZB_ZCL_STATUS_MALFORMED_CMD;
+  ++s_stats.check_in_responses;
+  if (!res.is_start)
+  {
+    /* nobody asked for a session yet, stop waiting for one */
+    if (!s_fast_granted)
+      poll_control_fast_poll_stop();
+    return ZB_ZCL_STATUS_SUCCESS;
+  }
+  if (res.timeout > POLL_CONTROL_FAST_POLL_TIMEOUT_MAX_QS)
+  {
+    ++s_stats.rejected;
+    return ZB_ZCL_STATUS_INVALID_VALUE;
+  }
+  if (!res.timeout)
+    res.timeout = poll_control_get_u16(
+        ZB_ZCL_ATTR_POLL_CONTROL_FAST_POLL_TIMEOUT_ID,
+        POLL_CONTROL_FAST_POLL_TIMEOUT_QS);
+  poll_control_fast_poll(res.timeout);
+  return ZB_ZCL_STATUS_SUCCESS;
+}
+
+static zb_uint8_t poll_control_set_long_poll(zb_bufid_t bufid)
+{
+  zb_zcl_poll_control_set_long_poll_interval_t req;
+  zb_zcl_parse_status_t parsed;
+  uint32_t check_in = poll_control_get_u32(
+      ZB_ZCL_ATTR_POLL_CONTROL_CHECKIN_INTERVAL_ID,
+      POLL_CONTROL_CHECK_IN_INTERVAL_QS);
+
+  ZB_ZCL_POLL_CONTROL_GET_SET_LONG_POLL_INTERVAL_REQ(&req, bufid, parsed);
+  if (parsed != ZB_ZCL_PARSE_STATUS_SUCCESS)
+    return ZB_ZCL_STATUS_MALFORMED_CMD;
+  if (req.interval < ZB_ZCL_POLL_CONTROL_LONG_POLL_INTERVAL_MIN_VALUE ||
+      req.interval > ZB_ZCL_POLL_CONTROL_LONG_POLL_INTERVAL_MAX_VALUE ||
+      req.interval < poll_control_short_poll_qs() ||
+      (check_in && req.interval > check_in))
+  {
+    ++s_stats.rejected;
+    return ZB_ZCL_STATUS_INVALID_VALUE;
+  }
+  poll_control_set(
+      ZB_ZCL_ATTR_POLL_CONTROL_LONG_POLL_INTERVAL_ID, &req.interval);
+  zb_conn_set_long_poll_ms(poll_control_qs_to_ms(req.interval));
+  ESP_LOGI(TAG, "Long poll interval %" PRIu32 " qs", req.interval);
+  return ZB_ZCL_STATUS_SUCCESS;
+}
+
+static zb_uint8_t poll_control_set_short_poll(zb_bufid_t bufid)
+{
+  zb_zcl_poll_control_set_short_poll_interval_t req;
+  zb_zcl_parse_status_t parsed;
+  uint32_t long_poll = poll_control_get_u32(
+      ZB_ZCL_ATTR_POLL_CONTROL_LONG_POLL_INTERVAL_ID,
+      POLL_CONTROL_LONG_POLL_INTERVAL_QS);
+
+  ZB_ZCL_POLL_CONTROL_GET_SET_SHORT_POLL_INTERVAL_REQ(&req, bufid, parsed);
+  if (parsed != ZB_ZCL_PARSE_STATUS_SUCCESS)
+    return ZB_ZCL_STATUS_MALFORMED_CMD;
+  if (req.interval < ZB_ZCL_POLL_CONTROL_SHORT_POLL_INTERVAL_MIN_VALUE ||
+      req.interval > long_poll)
+  {
+    ++s_stats.rejected;
+    return ZB_ZCL_STATUS_INVALID_VALUE;
+  }
+  poll_control_set(
+      ZB_ZCL_ATTR_POLL_CONTROL_SHORT_POLL_INTERVAL_ID, &req.interval);
+  if (s_fast_since_us)
+    zb_conn_set_fast_poll_ms(poll_control_qs_to_ms(req.interval));
+  ESP_LOGI(TAG, "Short poll interval %u qs", req.interval);
+  return ZB_ZCL_STATUS_SUCCESS;
+}
+
+void poll_control_init(uint8_t endpoint)
+{
+  s_endpoint = endpoint;
+  zb_conn_set_long_poll_ms(
+      poll_control_qs_to_ms(POLL_CONTROL_LONG_POLL_INTERVAL_QS));
+}
+
+bool poll_control_handle(uint8_t bufid)
+{
+  /* copied, the buffer is reused by the default response */
+  zb_zcl_parsed_hdr_t cmd_info = *ZB_BUF_GET_PARAM(bufid, zb_zcl_parsed_hdr_t);
+  zb_uint8_t status;
+
+  if (cmd_info.cluster_id != ZB_ZCL_CLUSTER_ID_POLL_CONTROL ||
+      cmd_info.is_common_command ||
+      cmd_info.cmd_direction != ZB_ZCL_FRAME_DIRECTION_TO_SRV ||
+      ZB_ZCL_PARSED_HDR_SHORT_DATA(&cmd_info).dst_endpoint != s_endpoint)
+    return false;
+
+  switch (cmd_info.cmd_id)
+  {
+  case ZB_ZCL_CMD_POLL_CONTROL_CHECK_IN_RESPONSE_ID:
+    status = poll_control_check_in_response(bufid);
+    break;
+  case ZB_ZCL_CMD_POLL_CONTROL_FAST_POLL_STOP_ID:
+    if (s_fast_since_us)
+      ++s_stats.fast_poll_stops;
+    poll_control_fast_poll_stop();
+    status = ZB_ZCL_STATUS_SUCCESS;
+    break;
+  case ZB_ZCL_CMD_POLL_CONTROL_SET_LONG_POLL_INTERVAL_ID:
+    status = poll_control_set_long_poll(bufid);
+    break;
+  case ZB_ZCL_CMD_POLL_CONTROL_SET_SHORT_POLL_INTERVAL_ID:
+    status = poll_control_set_short_poll(bufid);
+    break;
+  default:
+    return false;
+  }
+  ZB_ZCL_PROCESS_COMMAND_FINISH(bufid, &cmd_info, status);
+  return true;
+}
+
+void poll_control_on_wake(void)
+{
+  int64_t now = esp_timer_get_time();
+  uint32_t interval = poll_control_get_u32(
+      ZB_ZCL_ATTR_POLL_CONTROL_CHECKIN_INTERVAL_ID,
+      POLL_CONTROL_CHECK_IN_INTERVAL_QS);
+  zb_uint16_t dst = 0;
+
+  /* 0 disables the Check-in, the first one goes out once joined */
+  if (!interval ||
+      (s_checked_in_us &&
+       now - s_checked_in_us < poll_control_qs_to_ms(interval) * 1000LL))
+    return;
+  zb_bufid_t buf = zb_buf_get_out();
+  if (!buf)
+    return;
+  s_checked_in_us = now;
+  ++s_stats.check_ins;
+  /* sent to the bindings of the endpoint */
+  ZB_ZCL_POLL_CONTROL_SEND_CHECK_IN_REQ(
+      buf,
+      dst,
+      ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT,
+      0,
+      s_endpoint,
+      ZB_AF_HA_PROFILE_ID,
+      NULL);
+  energy_model_radio_tx(ENERGY_MODEL_ZCL_HEADER_BYTES);
+  poll_control_fast_poll_start(POLL_CONTROL_CHECK_IN_WAIT_QS);
+}
+
+void poll_control_get_stats(poll_control_stats_t* stats)
+{
+  *stats = s_stats;
+  if (s_fast_since_us)
+    stats->fast_poll_ms += (esp_timer_get_time() - s_fast_since_us) / 1000;
+}
@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Poll Control cluster server
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "zb_connectivity.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* attribute defaults, all intervals in quarter seconds as on the air */
+#define POLL_CONTROL_CHECK_IN_INTERVAL_QS (60 * 60 * 4)
+#define POLL_CONTROL_LONG_POLL_INTERVAL_QS (ZB_CONN_JOINED_POLL_MS / 250)
+#define POLL_CONTROL_SHORT_POLL_INTERVAL_QS 2
+#define POLL_CONTROL_FAST_POLL_TIMEOUT_QS (10 * 4)
+/* bound of a fast poll window, whatever the client asks for */
+#define POLL_CONTROL_FAST_POLL_TIMEOUT_MAX_QS (5 * 60 * 4)
+/* fast poll after a Check-in while the clients answer, the spec gives
+ * them 7.68 s */
+#define POLL_CONTROL_CHECK_IN_WAIT_QS (8 * 4)
+
+  typedef struct
+  {
+    uint32_t check_ins;
+    uint32_t check_in_responses;
+    uint32_t fast_polls;       /* fast poll windows opened */
+    uint32_t fast_poll_stops;  /* closed by Fast Poll Stop before timeout */
+    uint64_t fast_poll_ms;     /* time spent fast polling */
+    uint32_t rejected;         /* commands with an out of range value */
+  } poll_control_stats_t;
+
+  /**
+   * @brief Serve the Poll Control cluster of an endpoint
+   *
+   * The cluster and its attributes are built by the application from the
+   * POLL_CONTROL_* defaults, this module keeps them up to date.
+   */
+  void poll_control_init(uint8_t endpoint);
+
+  /**
+   * @brief Handle a Poll Control command, call from the raw command handler
+   *
+   * @return true if the command was consumed, the buffer is then released.
+   */
+  bool poll_control_handle(uint8_t bufid);
+
+  /**
+   * @brief Send the Check-in when its interval elapsed, call from a wake up
+   * that happens anyway while joined
+   */
+  void poll_control_on_wake(void);
+
+  /**
+   * @brief Poll at the short poll interval for a while, for sessions the
+   * device starts itself (OTA, ...)
+   *
+   * @param timeout_qs  window length, capped to the fast poll maximum.
+   */
+  void poll_control_fast_poll(uint16_t timeout_qs);
+
+  /**
+   * @brief Close the fast poll window, back to the long poll interval
+   */
+  void poll_control_fast_poll_stop(void);
+
+  bool poll_control_is_fast_polling(void);
+
+  void poll_control_get_stats(poll_control_stats_t* stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * CPU frequency policy and boost locks
+ *
+ * With CONFIG_POWER_SAVE_POLICY_SCALED the CPU runs at the XTAL frequency
+ * whenever it is awake and only goes to CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+ * inside boost sections (frame processing, button frames, LED refresh).
+ * Crypto and MAC processing inside the stack are covered by the boost taken
+ * around the Zigbee callbacks, the raw command handler and the button alarm
+ * callbacks, and by the locks the radio driver holds itself.
+ * CONFIG_POWER_SAVE_POLICY_FIXED pins the CPU at full speed.
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "power_save.h"
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#ifdef CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#include "esp_private/esp_clk.h"
+#endif
+
+static const char* TAG = "power_save";
+
+#ifdef CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t s_boost_lock;
+#endif
+static portMUX_TYPE s_boost_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_boost_depth;
+static int64_t s_boost_start_us;
+static power_save_stats_t s_stats;
+
+esp_err_t power_save_init(void)
+{
+  esp_err_t rc = ESP_OK;
+  s_stats.max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+  s_stats.min_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+#ifdef CONFIG_PM_ENABLE
+#ifdef CONFIG_POWER_SAVE_POLICY_SCALED
+  s_stats.min_freq_mhz = esp_clk_xtal_freq() / 1000000;
+#endif
+  esp_pm_config_t pm_config = {
+    .max_freq_mhz = s_stats.max_freq_mhz,
+    .min_freq_mhz = s_stats.min_freq_mhz,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    .light_sleep_enable = true
+#endif
+  };
+  rc = esp_pm_configure(&pm_config);
+  if (rc != ESP_OK)
+    return rc;
+  rc = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "boost", &s_boost_lock);
+#endif
+  ESP_LOGI(
+      TAG,
+      "CPU frequency %" PRIu32 "-%" PRIu32 " MHz",
+      s_stats.min_freq_mhz,
+      s_stats.max_freq_mhz);
+  return rc;
+}
+
+void power_save_boost_acquire(void)
+{
+  /* pm locks count their acquisitions, the depth only tracks boost time */
+#ifdef CONFIG_PM_ENABLE
+  if (s_boost_lock)
+    esp_pm_lock_acquire(s_boost_lock);
+#endif
+  portENTER_CRITICAL(&s_boost_mux);
+  if (s_boost_depth++ == 0)
+  {
+    s_boost_start_us = esp_timer_get_time();
+    ++s_stats.boost_count;
+  }
+  portEXIT_CRITICAL(&s_boost_mux);
+}
+
+void power_save_boost_release(void)
+{
+  portENTER_CRITICAL(&s_boost_mux);
+  if (s_boost_depth > 0 && --s_boost_depth == 0)
+    s_stats.boost_time_us += esp_timer_get_time() - s_boost_start_us;
+  portEXIT_CRITICAL(&s_boost_mux);
+#ifdef CONFIG_PM_ENABLE
+  if (s_boost_lock)
+    esp_pm_lock_release(s_boost_lock);
+#endif
+}
+
+void power_save_get_stats(power_save_stats_t* stats)
+{
+  portENTER_CRITICAL(&s_boost_mux);
+  *stats = s_stats;
+  portEXIT_CRITICAL(&s_boost_mux);
+}
@@ -0,0 +1,54 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * CPU frequency policy and boost locks
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct
+  {
+    uint32_t boost_count;
+    uint64_t boost_time_us;
+    uint32_t min_freq_mhz;
+    uint32_t max_freq_mhz;
+  } power_save_stats_t;
+
+  /**
+   * @brief Configure power management (frequency range and light sleep)
+   */
+  esp_err_t power_save_init(void);
+
+  /**
+   * @brief Run the CPU at full speed until the matching release
+   *
+   * Calls nest, from the Zigbee task and the LED refresh task, so a single
+   * lock is shared.
+   */
+  void power_save_boost_acquire(void);
+
+  void power_save_boost_release(void);
+
+  /**
+   * @brief Snapshot of the boost counters
+   */
+  void power_save_get_stats(power_save_stats_t* stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,132 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Wake up cause attribution and sleep duration histograms
+ *
+ * Everything is a fixed size counter updated in O(1) from the sleep path,
+ * the only log is a periodic summary, so it can stay enabled in production.
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "sleep_stats.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char* TAG = "sleep_stats";
+
+static sleep_stats_t s_stats;
+static int64_t s_sleep_since_us;
+static int64_t s_awake_since_us;
+static int64_t s_logged_us;
+static sleep_wake_source_t s_source = SLEEP_WAKE_OTHER;
+static volatile bool s_worked = true;
+
+static uint8_t sleep_stats_bucket(int64_t us)
+{
+  uint32_t ms = us / 1000;
+  uint8_t bucket = ms ? 32 - __builtin_clz(ms) : 0;
+
+  return bucket < SLEEP_STATS_BUCKETS ? bucket : SLEEP_STATS_BUCKETS - 1;
+}
+
+static sleep_wake_source_t sleep_stats_source(esp_sleep_wakeup_cause_t cause)
+{
+  switch (cause)
+  {
+  case ESP_SLEEP_WAKEUP_GPIO:
+    return SLEEP_WAKE_GPIO;
+  case ESP_SLEEP_WAKEUP_TIMER:
+    return SLEEP_WAKE_TIMER;
+  case ESP_SLEEP_WAKEUP_UART:
+    return SLEEP_WAKE_UART;
+  case ESP_SLEEP_WAKEUP_UNDEFINED:
+    return SLEEP_WAKE_REJECTED;
+  default:
+    return SLEEP_WAKE_OTHER;
+  }
+}
+
+static void sleep_stats_log_hist(const char* name, const uint32_t* hist)
+{
+  char line[SLEEP_STATS_BUCKETS * 11 + 1];
+  int len = 0;
+
+  for (int i = 0; i < SLEEP_STATS_BUCKETS; ++i)
+    len += snprintf(
+        line + len, sizeof(line) - len, " %" PRIu32, hist[i]);
+  ESP_LOGI(TAG, "%s ms log2 histogram:%s", name, line);
+}
+
+static void sleep_stats_log(void)
+{
+  for (int i = 0; i < SLEEP_WAKE_COUNT; ++i)
+    ESP_LOGI(
+        TAG,
+        "wake %s: %" PRIu32 " (%" PRIu32 " spurious)",
+        sleep_wake_source_to_string(i),
+        s_stats.wakes[i],
+        s_stats.spurious[i]);
+  sleep_stats_log_hist("sleep", s_stats.sleep_hist);
+  sleep_stats_log_hist("awake", s_stats.awake_hist);
+}
+
+void sleep_stats_sleep_enter(void)
+{
+  int64_t now = esp_timer_get_time();
+
+  if (s_awake_since_us)
+  {
+    ++s_stats.awake_hist[sleep_stats_bucket(now - s_awake_since_us)];
+    if (!s_worked)
+      ++s_stats.spurious[s_source];
+  }
+  s_sleep_since_us = now;
+}
+
+void sleep_stats_wake(esp_sleep_wakeup_cause_t cause)
+{
+  int64_t now = esp_timer_get_time();
+
+  s_source = sleep_stats_source(cause);
+  ++s_stats.wakes[s_source];
+  ++s_stats.sleep_hist[sleep_stats_bucket(now - s_sleep_since_us)];
+  s_awake_since_us = now;
+  s_worked = false;
+
+  if (now - s_logged_us >= SLEEP_STATS_LOG_PERIOD_MS * 1000LL)
+  {
+    s_logged_us = now;
+    sleep_stats_log();
+  }
+}
+
+void sleep_stats_note_work(void)
+{
+  s_worked = true;
+}
+
+void sleep_stats_get(sleep_stats_t* stats)
+{
+  *stats = s_stats;
+}
+
+const char* sleep_wake_source_to_string(sleep_wake_source_t source)
+{
+  static const char* names[SLEEP_WAKE_COUNT] = {
+      [SLEEP_WAKE_GPIO] = "gpio",
+      [SLEEP_WAKE_TIMER] = "timer",
+      [SLEEP_WAKE_UART] = "uart",
+      [SLEEP_WAKE_OTHER] = "other",
+      [SLEEP_WAKE_REJECTED] = "rejected",
+  };
+  return source < SLEEP_WAKE_COUNT ? names[source] : "unknown";
+}
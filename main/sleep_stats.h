@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Wake up cause attribution and sleep duration histograms
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_sleep.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* log2 buckets in ms: 0 is < 1 ms, n is [2^(n-1), 2^n), the last is open */
+#define SLEEP_STATS_BUCKETS 16
+/* period of the summary log, written from a wake up */
+#define SLEEP_STATS_LOG_PERIOD_MS (10 * 60 * 1000)
+
+  typedef enum
+  {
+    SLEEP_WAKE_GPIO,
+    SLEEP_WAKE_TIMER, /* next stack event, data polls included */
+    SLEEP_WAKE_UART,
+    SLEEP_WAKE_OTHER,
+    SLEEP_WAKE_REJECTED, /* sleep aborted, no wake up cause */
+    SLEEP_WAKE_COUNT,
+  } sleep_wake_source_t;
+
+  typedef struct
+  {
+    uint32_t wakes[SLEEP_WAKE_COUNT];
+    /* wake ups followed by sleep without any sleep_stats_note_work() */
+    uint32_t spurious[SLEEP_WAKE_COUNT];
+    uint32_t sleep_hist[SLEEP_STATS_BUCKETS];
+    uint32_t awake_hist[SLEEP_STATS_BUCKETS];
+  } sleep_stats_t;
+
+  /**
+   * @brief Call right before the light sleep, closes the awake period
+   */
+  void sleep_stats_sleep_enter(void);
+
+  /**
+   * @brief Call right after the light sleep
+   *
+   * @param cause       value of esp_sleep_get_wakeup_cause().
+   */
+  void sleep_stats_wake(esp_sleep_wakeup_cause_t cause);
+
+  /**
+   * @brief Mark the current awake period as useful (frame, button, ...)
+   */
+  void sleep_stats_note_work(void);
+
+  void sleep_stats_get(sleep_stats_t* stats);
+
+  const char* sleep_wake_source_to_string(sleep_wake_source_t source);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
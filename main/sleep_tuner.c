@@ -0,0 +1,99 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Adaptive Zigbee sleep threshold
+ *
+ * On a timer wake up the device should be back exactly sleep_tmo after
+ * CAN_SLEEP, anything above is the cost of preparing, entering and leaving
+ * light sleep. During that time the chip draws about its active current, so
+ * sleeping only saves energy when the sleep is longer than that cost: the
+ * break-even point. The threshold follows the filtered cost with a margin.
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "sleep_tuner.h"
+#include <inttypes.h>
+#include "binlog.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+
+static const char* TAG = "sleep_tuner";
+
+static int64_t s_begin_us;
+static uint32_t s_tmo_ms;
+static sleep_tuner_filter_t s_filter;
+static bool s_busy;
+static sleep_tuner_stats_t s_stats = {
+    .threshold_ms = ESP_ZB_SLEEP_MINIMUM_THRESHOLD_MS,
+};
+
+_Static_assert(
+    SLEEP_TUNER_MIN_THRESHOLD_MS == ESP_ZB_SLEEP_MINIMUM_THRESHOLD_MS,
+    "stack floor");
+
+static void sleep_tuner_apply(void)
+{
+  uint32_t target = sleep_tuner_target_ms(
+      s_stats.overhead_us, s_busy, s_stats.threshold_ms);
+
+  if (target == s_stats.threshold_ms)
+    return;
+  if (esp_zb_sleep_set_threshold(target) != ESP_OK)
+    return;
+  ESP_LOGI(
+      TAG,
+      "Sleep threshold %" PRIu32 " -> %" PRIu32 " ms (overhead %" PRIu32
+      " us%s)",
+      s_stats.threshold_ms,
+      target,
+      s_stats.overhead_us,
+      s_busy ? ", busy" : "");
+  s_stats.threshold_ms = target;
+  ++s_stats.retunes;
+}
+
+void sleep_tuner_begin(uint32_t sleep_tmo_ms)
+{
+  s_begin_us = esp_timer_get_time();
+  s_tmo_ms = sleep_tmo_ms;
+}
+
+void sleep_tuner_end(esp_sleep_wakeup_cause_t cause)
+{
+  int64_t elapsed = esp_timer_get_time() - s_begin_us;
+
+  /* other wake ups end before the planned time and tell nothing */
+  if (cause != ESP_SLEEP_WAKEUP_TIMER)
+    return;
+  /* the trace tools/sleep_tuner_bench.c replays */
+  BINLOG(
+      TAG,
+      "Wake: %" PRIu32 " ms granted, %" PRIu32 " us away, busy %d",
+      s_tmo_ms,
+      (uint32_t)elapsed,
+      s_busy);
+  s_stats.overhead_us =
+      sleep_tuner_filter(&s_filter, elapsed - s_tmo_ms * 1000LL);
+  s_stats.samples = s_filter.samples;
+  sleep_tuner_apply();
+}
+
+void sleep_tuner_set_busy(bool busy)
+{
+  if (s_busy == busy)
+    return;
+  s_busy = busy;
+  sleep_tuner_apply();
+}
+
+void sleep_tuner_get_stats(sleep_tuner_stats_t* stats)
+{
+  *stats = s_stats;
+}
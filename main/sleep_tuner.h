@@ -0,0 +1,55 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Adaptive Zigbee sleep threshold
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_sleep.h"
+#include "sleep_tuner_policy.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct
+  {
+    uint32_t threshold_ms;
+    uint32_t overhead_us; /* filtered enter + exit cost of one sleep */
+    uint32_t samples;
+    uint32_t retunes;
+  } sleep_tuner_stats_t;
+
+  /**
+   * @brief Call when CAN_SLEEP is received, before any sleep preparation
+   *
+   * @param sleep_tmo_ms    sleep duration granted by the stack.
+   */
+  void sleep_tuner_begin(uint32_t sleep_tmo_ms);
+
+  /**
+   * @brief Call right after the wake up, timer wake ups are measured
+   */
+  void sleep_tuner_end(esp_sleep_wakeup_cause_t cause);
+
+  /**
+   * @brief Raise the threshold while a transfer keeps the device busy
+   */
+  void sleep_tuner_set_busy(bool busy);
+
+  void sleep_tuner_get_stats(sleep_tuner_stats_t* stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
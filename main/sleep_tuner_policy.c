@@ -0,0 +1,41 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Cost filter and threshold rule of the adaptive sleep threshold
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "sleep_tuner_policy.h"
+
+uint32_t sleep_tuner_filter(sleep_tuner_filter_t* filter, int64_t overshoot_us)
+{
+  if (overshoot_us < 0)
+    overshoot_us = 0;
+  if (!filter->samples++)
+    filter->overhead = overshoot_us << SLEEP_TUNER_EMA_SHIFT;
+  else
+    filter->overhead +=
+        overshoot_us - (filter->overhead >> SLEEP_TUNER_EMA_SHIFT);
+  return filter->overhead >> SLEEP_TUNER_EMA_SHIFT;
+}
+
+uint32_t sleep_tuner_target_ms(
+    uint32_t overhead_us, bool busy, uint32_t threshold_ms)
+{
+  uint32_t margin = busy ? SLEEP_TUNER_BUSY_MARGIN_PCT : SLEEP_TUNER_MARGIN_PCT;
+  uint32_t target = (uint64_t)overhead_us * margin / 100 / 1000;
+  uint32_t diff;
+
+  if (target < SLEEP_TUNER_MIN_THRESHOLD_MS)
+    target = SLEEP_TUNER_MIN_THRESHOLD_MS;
+  diff = target > threshold_ms ? target - threshold_ms : threshold_ms - target;
+  if (diff * 100 <= threshold_ms * SLEEP_TUNER_HYSTERESIS_PCT)
+    return threshold_ms;
+  return target;
+}
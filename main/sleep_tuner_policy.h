@@ -0,0 +1,67 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Cost filter and threshold rule of the adaptive sleep threshold
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* threshold = measured transition cost * margin */
+#define SLEEP_TUNER_MARGIN_PCT 150
+/* EMA weight of a new measurement is 1 / 2^SLEEP_TUNER_EMA_SHIFT */
+#define SLEEP_TUNER_EMA_SHIFT 3
+/* relative change needed before the stack threshold is updated */
+#define SLEEP_TUNER_HYSTERESIS_PCT 12
+/* margin while busy (OTA), a late wake up also delays the next block */
+#define SLEEP_TUNER_BUSY_MARGIN_PCT 300
+/* ESP_ZB_SLEEP_MINIMUM_THRESHOLD_MS, the stack refuses less */
+#define SLEEP_TUNER_MIN_THRESHOLD_MS 20
+
+  /*
+   * Plain functions, also built on the host by tools/sleep_tuner_bench.c.
+   */
+
+  typedef struct
+  {
+    uint32_t overhead; /* filtered overhead in us << SLEEP_TUNER_EMA_SHIFT */
+    uint32_t samples;
+  } sleep_tuner_filter_t;
+
+  /**
+   * @brief Add the overshoot of a timer wake up to the filter
+   *
+   * @param overshoot_us    time away beyond the granted sleep, negative
+   * values count as 0.
+   *
+   * @return the filtered enter + exit cost in us
+   */
+  uint32_t sleep_tuner_filter(
+      sleep_tuner_filter_t* filter, int64_t overshoot_us);
+
+  /**
+   * @brief Threshold for a filtered cost
+   *
+   * @param threshold_ms    threshold in use, returned as is when the new
+   * one is within SLEEP_TUNER_HYSTERESIS_PCT of it.
+   */
+  uint32_t sleep_tuner_target_ms(
+      uint32_t overhead_us, bool busy, uint32_t threshold_ms);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
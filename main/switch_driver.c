@@ -37,6 +37,7 @@
 
 #include "switch_driver.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
@@ -61,6 +62,9 @@ static switch_func_pair_t* switch_func_pair;
 static esp_switch_callback_t func_ptr;
 /* which button is pressed */
 static uint8_t switch_num;
+/* when the event passed to the callback was detected */
+static int64_t switch_event_us;
+static switch_event_t switch_event;
 static const char* TAG = "ESP_ZB_SWITCH";
 
 static void IRAM_ATTR gpio_isr_handler(void* arg)
@@ -103,12 +107,25 @@ static void switch_driver_gpios_intr_enabled(bool enabled)
  *
  * @param arg      Unused value.
  */
+static void switch_driver_emit(
+    switch_func_pair_t* button_func_pair, switch_event_t event, int64_t us)
+{
+  switch_event = event;
+  switch_event_us = us;
+  /* callback to button_handler */
+  (*func_ptr)(button_func_pair);
+}
+
 static void switch_driver_button_detected(void* arg)
 {
   gpio_num_t io_num = GPIO_NUM_NC;
   switch_func_pair_t button_func_pair;
   static switch_state_t switch_state = SWITCH_IDLE;
   bool evt_flag = false;
+  bool gestures = false;
+  bool long_sent = false;
+  bool second = false; /* press after a short one, within the window */
+  int64_t since_us = 0;
 
   for (;;)
   {
@@ -117,26 +134,71 @@ static void switch_driver_button_detected(void* arg)
     if (xQueueReceive(gpio_evt_queue, &button_func_pair, portMAX_DELAY))
     {
       io_num = button_func_pair.pin;
+      gestures = button_func_pair.func == SWITCH_EVENT_CONTROL;
       switch_driver_gpios_intr_enabled(false);
       evt_flag = true;
     }
     while (evt_flag)
     {
       bool value = gpio_get_level(io_num);
+      int64_t now_us = esp_timer_get_time();
       switch (switch_state)
       {
       case SWITCH_IDLE:
         switch_state = (value == GPIO_INPUT_LEVEL_ON) ? SWITCH_PRESS_DETECTED
                                                       : SWITCH_IDLE;
+        since_us = now_us;
+        long_sent = false;
+        second = false;
         break;
       case SWITCH_PRESS_DETECTED:
-        switch_state = (value == GPIO_INPUT_LEVEL_ON) ? SWITCH_PRESS_DETECTED
-                                                      : SWITCH_RELEASE_DETECTED;
+        if (value == GPIO_INPUT_LEVEL_ON)
+        {
+          if (gestures && !second && !long_sent &&
+              now_us - since_us >= SWITCH_LONG_PRESS_MS * 1000LL)
+          {
+            long_sent = true;
+            switch_driver_emit(&button_func_pair, SWITCH_EVENT_LONG, now_us);
+          }
+          break;
+        }
+        if (!gestures)
+        {
+          switch_state = SWITCH_RELEASE_DETECTED;
+          switch_event = SWITCH_EVENT_SINGLE;
+          switch_event_us = now_us;
+          break;
+        }
+        switch_state = SWITCH_IDLE;
+        if (long_sent)
+          switch_driver_emit(&button_func_pair, SWITCH_EVENT_RELEASE, now_us);
+        else if (second)
+          switch_driver_emit(&button_func_pair, SWITCH_EVENT_DOUBLE, now_us);
+        else
+        {
+          /* wait for a second press */
+          switch_state = SWITCH_RELEASE_DETECTED;
+          since_us = now_us;
+        }
         break;
       case SWITCH_RELEASE_DETECTED:
-        switch_state = SWITCH_IDLE;
-        /* callback to button_handler */
-        (*func_ptr)(&button_func_pair);
+        if (!gestures)
+        {
+          switch_state = SWITCH_IDLE;
+          /* callback to button_handler */
+          (*func_ptr)(&button_func_pair);
+          break;
+        }
+        if (value == GPIO_INPUT_LEVEL_ON)
+        {
+          switch_state = SWITCH_PRESS_DETECTED;
+          second = true;
+        }
+        else if (now_us - since_us >= SWITCH_DOUBLE_PRESS_MS * 1000LL)
+        {
+          switch_state = SWITCH_IDLE;
+          switch_driver_emit(&button_func_pair, SWITCH_EVENT_SINGLE, now_us);
+        }
         break;
       default:
         break;
@@ -212,3 +274,13 @@ bool switch_driver_init(
   func_ptr = cb;
   return true;
 }
+
+int64_t switch_driver_event_time_us(void)
+{
+  return switch_event_us;
+}
+
+switch_event_t switch_driver_event(void)
+{
+  return switch_event;
+}
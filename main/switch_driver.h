@@ -57,6 +57,11 @@ extern "C"
 
 #define ESP_INTR_FLAG_DEFAULT 0
 
+/* SWITCH_EVENT_CONTROL gestures: held this long is a long press, a second
+ * press within the window after a release is a double press */
+#define SWITCH_LONG_PRESS_MS 800
+#define SWITCH_DOUBLE_PRESS_MS 300
+
 #define PAIR_SIZE(TYPE_STR_PAIR) \
   (sizeof(TYPE_STR_PAIR) / sizeof(TYPE_STR_PAIR[0]))
 
@@ -78,8 +83,18 @@ extern "C"
     SWITCH_LEVEL_DOWN_CONTROL,
     SWITCH_LEVEL_CYCLE_CONTROL,
     SWITCH_COLOR_CONTROL,
+    SWITCH_EVENT_CONTROL, /* callback per gesture, see switch_event_t */
   } switch_func_t;
 
+  /* gestures, the values are the Multistate Input states of the events */
+  typedef enum
+  {
+    SWITCH_EVENT_SINGLE = 1,
+    SWITCH_EVENT_DOUBLE,
+    SWITCH_EVENT_LONG,    /* still held */
+    SWITCH_EVENT_RELEASE, /* end of a long press */
+  } switch_event_t;
+
   typedef struct
   {
     uint32_t pin;
@@ -100,6 +115,18 @@ extern "C"
       uint8_t button_num,
       esp_switch_callback_t cb);
 
+  /**
+   * @brief Time the event being handled by the callback was detected, in
+   * esp_timer microseconds
+   */
+  int64_t switch_driver_event_time_us(void);
+
+  /**
+   * @brief Gesture being handled by the callback, SWITCH_EVENT_SINGLE for
+   * the buttons that are not SWITCH_EVENT_CONTROL
+   */
+  switch_event_t switch_driver_event(void);
+
   void check_gpio(switch_func_pair_t* button_func_pair, uint8_t button_num);
 
 #ifdef __cplusplus
@@ -0,0 +1,175 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Static arena for the Zigbee attribute, cluster and endpoint lists
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "zb_arena.h"
+#include <stdint.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define ZB_ARENA_ALIGN 8
+#define ZB_ARENA_ROUND(n) (((n) + ZB_ARENA_ALIGN - 1) & ~(ZB_ARENA_ALIGN - 1))
+/* each block is preceded by its size, realloc() needs it */
+#define ZB_ARENA_HEADER ZB_ARENA_ROUND(sizeof(size_t))
+
+static const char* TAG = "zb_arena";
+
+static struct
+{
+  TaskHandle_t owner; /* NULL outside zb_arena_begin() / zb_arena_end() */
+  uint8_t* last;      /* last block, the only one that can grow in place */
+  zb_arena_stats_t stats;
+#if CONFIG_ZB_ARENA_SIZE > 0
+  uint8_t pool[CONFIG_ZB_ARENA_SIZE] __attribute__((aligned(ZB_ARENA_ALIGN)));
+#endif
+} arena = {.stats.size = CONFIG_ZB_ARENA_SIZE};
+
+#if CONFIG_ZB_ARENA_SIZE > 0
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+static inline bool zb_arena_active(void)
+{
+  return arena.owner && arena.owner == xTaskGetCurrentTaskHandle();
+}
+
+static inline size_t zb_arena_block_size(const uint8_t* block)
+{
+  return *(const size_t*)(block - ZB_ARENA_HEADER);
+}
+
+static void* zb_arena_alloc(size_t size)
+{
+  size_t need = ZB_ARENA_HEADER + ZB_ARENA_ROUND(size);
+
+  if (need > arena.stats.size - arena.stats.used)
+  {
+    arena.stats.overflows++;
+    arena.stats.overflow_bytes += size;
+    return NULL;
+  }
+  uint8_t* block = arena.pool + arena.stats.used + ZB_ARENA_HEADER;
+  *(size_t*)(block - ZB_ARENA_HEADER) = size;
+  arena.stats.used += need;
+  arena.stats.allocations++;
+  arena.last = block;
+  return block;
+}
+
+bool zb_arena_owns(const void* ptr)
+{
+  return (const uint8_t*)ptr >= arena.pool &&
+         (const uint8_t*)ptr < arena.pool + CONFIG_ZB_ARENA_SIZE;
+}
+
+void* __wrap_malloc(size_t size)
+{
+  void* ptr = zb_arena_active() ? zb_arena_alloc(size) : NULL;
+
+  return ptr ? ptr : __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size)
+{
+  if (zb_arena_active() && (size == 0 || n <= SIZE_MAX / size))
+  {
+    /* the pool is zeroed .bss and blocks are never reused */
+    void* ptr = zb_arena_alloc(n * size);
+    if (ptr)
+      return ptr;
+  }
+  return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+  if (!zb_arena_owns(ptr))
+    return __real_realloc(ptr, size);
+
+  uint8_t* block = ptr;
+  size_t old = zb_arena_block_size(block);
+  if (size <= old)
+    return ptr;
+  if (zb_arena_active() && block == arena.last)
+  {
+    size_t grow = ZB_ARENA_ROUND(size) - ZB_ARENA_ROUND(old);
+    if (grow <= arena.stats.size - arena.stats.used)
+    {
+      *(size_t*)(block - ZB_ARENA_HEADER) = size;
+      arena.stats.used += grow;
+      return ptr;
+    }
+  }
+  void* moved = __wrap_malloc(size);
+  if (moved)
+    memcpy(moved, ptr, old);
+  return moved;
+}
+
+void __wrap_free(void* ptr)
+{
+  /* arena blocks are not reused */
+  if (!zb_arena_owns(ptr))
+    __real_free(ptr);
+}
+#else
+/* nothing is wrapped, the lists come from the heap */
+bool zb_arena_owns(const void* ptr)
+{
+  return false;
+}
+#endif
+
+void zb_arena_begin(void)
+{
+  arena.owner = xTaskGetCurrentTaskHandle();
+}
+
+void zb_arena_end(void)
+{
+  arena.owner = NULL;
+  if (arena.stats.overflows)
+    ESP_LOGW(
+        TAG,
+        "%u allocations (%u bytes) did not fit, raise CONFIG_ZB_ARENA_SIZE",
+        (unsigned)arena.stats.overflows,
+        (unsigned)arena.stats.overflow_bytes);
+}
+
+void zb_arena_get_stats(zb_arena_stats_t* stats)
+{
+  *stats = arena.stats;
+}
+
+void zb_arena_log_heap(const char* stage)
+{
+  multi_heap_info_t info;
+
+  heap_caps_get_info(&info, MALLOC_CAP_DEFAULT);
+  ESP_LOGI(
+      TAG,
+      "%s: arena %u/%u bytes in %u blocks, heap free %u largest %u, "
+      "%u free / %u allocated blocks",
+      stage,
+      (unsigned)arena.stats.used,
+      (unsigned)arena.stats.size,
+      (unsigned)arena.stats.allocations,
+      (unsigned)info.total_free_bytes,
+      (unsigned)info.largest_free_block,
+      (unsigned)info.free_blocks,
+      (unsigned)info.allocated_blocks);
+}
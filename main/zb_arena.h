@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Static arena for the Zigbee attribute, cluster and endpoint lists
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct
+  {
+    size_t size;
+    size_t used;
+    size_t allocations;
+    /* requests that did not fit and went to the heap */
+    size_t overflows;
+    size_t overflow_bytes;
+  } zb_arena_stats_t;
+
+  /**
+   * @brief Route the allocations of the calling task to the arena
+   *
+   * The esp-zigbee list constructors are prebuilt and call malloc() and
+   * friends, so with CONFIG_ZB_ARENA_SIZE above 0 these are wrapped at link
+   * time for the whole firmware (see CMakeLists.txt). The window is the only
+   * place the wrappers act: zb_desc_build() opens it around the list
+   * constructors and nothing else does. Between begin and end the calling
+   * task is served from the arena, other tasks and requests that no longer
+   * fit keep using the heap. Outside the window malloc() and calloc() test
+   * one pointer and go to the heap, realloc() and free() test whether the
+   * block is in the arena. Blocks are never given back, the lists live as
+   * long as the device.
+   */
+  void zb_arena_begin(void);
+
+  void zb_arena_end(void);
+
+  /**
+   * @brief True if ptr was allocated from the arena
+   */
+  bool zb_arena_owns(const void* ptr);
+
+  void zb_arena_get_stats(zb_arena_stats_t* stats);
+
+  /**
+   * @brief Log the arena usage and the default heap layout
+   *
+   * @param stage       boot stage printed with the figures.
+   */
+  void zb_arena_log_heap(const char* stage);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Rejoin backoff, admission slots and pacing of the connectivity state machine
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "zb_conn_policy.h"
+
+uint32_t zb_conn_admission_delay_ms(
+    uint32_t ieee_hash, uint8_t attempt, uint32_t outage_ms, uint16_t pace)
+{
+  uint64_t window =
+      ZB_CONN_ADMIT_BASE_WINDOW_MS + outage_ms / ZB_CONN_ADMIT_OUTAGE_DIVISOR;
+
+  window = window * pace / ZB_CONN_PACE_UNIT;
+  if (window > ZB_CONN_ADMIT_MAX_WINDOW_MS)
+    window = ZB_CONN_ADMIT_MAX_WINDOW_MS;
+  /* move to another slot on each attempt so that two devices colliding once
+   * do not keep colliding */
+  ieee_hash ^= attempt * 0x9e3779b9u;
+  ieee_hash ^= ieee_hash >> 16;
+  ieee_hash *= 0x45d9f3bu;
+  ieee_hash ^= ieee_hash >> 16;
+  return ieee_hash % (uint32_t)window;
+}
+
+uint32_t zb_conn_backoff_ms(uint8_t failures)
+{
+  if (failures <= ZB_CONN_FAST_REJOIN_ATTEMPTS)
+    return ZB_CONN_FAST_REJOIN_BASE_MS << (failures - 1);
+
+  uint8_t shift = failures - ZB_CONN_FAST_REJOIN_ATTEMPTS - 1;
+  uint32_t delay = ZB_CONN_SLOW_REJOIN_BASE_MS;
+  while (shift-- && delay < ZB_CONN_SLOW_REJOIN_MAX_MS)
+    delay <<= 1;
+  return delay < ZB_CONN_SLOW_REJOIN_MAX_MS ? delay
+                                            : ZB_CONN_SLOW_REJOIN_MAX_MS;
+}
+
+/* multiplicative increase on failure, slow decrease on success */
+uint16_t zb_conn_pace_failure(uint16_t pace)
+{
+  return pace * 2 < ZB_CONN_PACE_MAX ? pace * 2 : ZB_CONN_PACE_MAX;
+}
+
+uint16_t zb_conn_pace_link_failure(uint16_t pace)
+{
+  return pace + ZB_CONN_PACE_LINK_STEP < ZB_CONN_PACE_MAX
+             ? pace + ZB_CONN_PACE_LINK_STEP
+             : ZB_CONN_PACE_MAX;
+}
+
+uint16_t zb_conn_pace_success(uint16_t pace)
+{
+  pace -= (pace - ZB_CONN_PACE_UNIT) / 8;
+  if (pace > ZB_CONN_PACE_UNIT && pace - ZB_CONN_PACE_UNIT < 8)
+    pace = ZB_CONN_PACE_UNIT;
+  return pace;
+}
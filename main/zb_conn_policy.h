@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Rejoin backoff, admission slots and pacing of the connectivity state machine
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* rejoin attempts retried with a short backoff before backing off hard */
+#define ZB_CONN_FAST_REJOIN_ATTEMPTS 3
+#define ZB_CONN_FAST_REJOIN_BASE_MS 1000
+#define ZB_CONN_SLOW_REJOIN_BASE_MS 30000
+#define ZB_CONN_SLOW_REJOIN_MAX_MS (15 * 60 * 1000)
+/* rejoin admission window: base + outage duration / divisor, capped */
+#define ZB_CONN_ADMIT_BASE_WINDOW_MS 500
+#define ZB_CONN_ADMIT_OUTAGE_DIVISOR 2
+#define ZB_CONN_ADMIT_MAX_WINDOW_MS 60000
+/* admission pacing factor in 1/16 units, raised on poll, rejoin and MAC
+ * level failures */
+#define ZB_CONN_PACE_UNIT 16
+#define ZB_CONN_PACE_MAX (16 * ZB_CONN_PACE_UNIT)
+/* added by a frame the MAC or NWK layer failed to deliver, failures of the
+ * link itself double the factor */
+#define ZB_CONN_PACE_LINK_STEP (ZB_CONN_PACE_UNIT / 4)
+
+  /*
+   * Plain functions without state, also built on the host by
+   * tools/zb_connectivity_bench.c.
+   */
+
+  /**
+   * @brief Delay before a rejoin attempt is admitted
+   *
+   * The slot inside the window is derived from the IEEE address so that a
+   * fleet losing its coordinator at the same time spreads its rejoins, the
+   * window grows with the outage duration and with the pacing factor.
+   *
+   * @param ieee_hash   hash of the device IEEE address.
+   * @param attempt     rejoin attempt number since the parent was lost.
+   * @param outage_ms   time since the parent was lost.
+   * @param pace        pacing factor, ZB_CONN_PACE_UNIT is 1x.
+   */
+  uint32_t zb_conn_admission_delay_ms(
+      uint32_t ieee_hash, uint8_t attempt, uint32_t outage_ms, uint16_t pace);
+
+  /**
+   * @brief Wait after a number of failed rejoins in a row, at least 1
+   */
+  uint32_t zb_conn_backoff_ms(uint8_t failures);
+
+  /**
+   * @brief Pacing factor after a failed poll or rejoin, doubled
+   */
+  uint16_t zb_conn_pace_failure(uint16_t pace);
+
+  /**
+   * @brief Pacing factor after a frame lost at the MAC or NWK layer
+   */
+  uint16_t zb_conn_pace_link_failure(uint16_t pace);
+
+  /**
+   * @brief Pacing factor after a successful rejoin, an eighth closer to 1x
+   */
+  uint16_t zb_conn_pace_success(uint16_t pace);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
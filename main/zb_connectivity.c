@@ -0,0 +1,331 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee end device connectivity state machine
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "zb_connectivity.h"
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+#include "string.h"
+#include "zboss_api.h"
+
+/**
+ * @brief:
+ * JOINED     parent answers, long poll, radio duty cycled.
+ * DEGRADED   a poll failed, poll faster until the parent answers again or
+ *            ZB_CONN_POLL_FAIL_LIMIT consecutive polls fail.
+ * ORPHANED   parent lost, sleep until the rejoin admission delay expires.
+ * REJOINING  rejoin in progress, the radio has to stay on.
+ * DORMANT    rejoin failed, sleep with the radio off until the next attempt.
+ */
+
+typedef struct
+{
+  uint32_t poll_interval_ms; /* long poll interval, 0 if not on a network */
+  bool sleep_enabled;        /* false keeps the radio on */
+} zb_conn_profile_t;
+
+static const zb_conn_profile_t s_profiles[ZB_CONN_STATE_COUNT] = {
+    [ZB_CONN_STATE_JOINED] = {ZB_CONN_JOINED_POLL_MS, true},
+    [ZB_CONN_STATE_DEGRADED] = {ZB_CONN_DEGRADED_POLL_MS, true},
+    [ZB_CONN_STATE_ORPHANED] = {0, true},
+    [ZB_CONN_STATE_REJOINING] = {0, false},
+    [ZB_CONN_STATE_DORMANT] = {0, true},
+};
+
+static const char* TAG = "ZB_CONN";
+
+static zb_conn_stats_t s_stats;
+static uint64_t s_state_enter_ms;
+static uint64_t s_outage_start_ms;
+static uint8_t s_consecutive_poll_failures;
+/* failed attempts since the parent was lost, drives the backoff */
+static uint8_t s_rejoin_failures_in_row;
+static uint32_t s_ieee_hash;
+/* joined long poll, and a faster interval while a fast poll window is
+ * open (0 if none), both from the Poll Control cluster */
+static uint32_t s_long_poll_ms = ZB_CONN_JOINED_POLL_MS;
+static uint32_t s_fast_poll_ms;
+
+static uint64_t zb_conn_now_ms(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+static uint32_t zb_conn_poll_interval_ms(zb_conn_state_t state)
+{
+  uint32_t ms = state == ZB_CONN_STATE_JOINED
+                    ? s_long_poll_ms
+                    : s_profiles[state].poll_interval_ms;
+
+  if (ms && s_fast_poll_ms && s_fast_poll_ms < ms)
+    ms = s_fast_poll_ms;
+  return ms;
+}
+
+/* apply the poll interval of the current state, if it polls */
+static void zb_conn_poll_changed(void)
+{
+  uint32_t ms = zb_conn_poll_interval_ms(s_stats.state);
+
+  if (ms)
+    zb_zdo_pim_set_long_poll_interval(ms);
+}
+
+static void zb_conn_enter(zb_conn_state_t state)
+{
+  uint64_t now = zb_conn_now_ms();
+  zb_conn_state_t prev = s_stats.state;
+  const zb_conn_profile_t* profile = &s_profiles[state];
+
+  s_stats.time_in_state_ms[prev] += now - s_state_enter_ms;
+  s_state_enter_ms = now;
+  s_stats.state = state;
+  ++s_stats.enter_count[state];
+
+  zb_conn_poll_changed();
+  esp_zb_sleep_enable(profile->sleep_enabled);
+
+  if (prev != state)
+    ESP_LOGI(
+        TAG,
+        "%s -> %s",
+        zb_conn_state_to_string(prev),
+        zb_conn_state_to_string(state));
+}
+
+static void zb_conn_degraded_timeout_cb(uint8_t param)
+{
+  if (s_stats.state == ZB_CONN_STATE_DEGRADED)
+  {
+    s_consecutive_poll_failures = 0;
+    zb_conn_enter(ZB_CONN_STATE_JOINED);
+  }
+}
+
+static void zb_conn_rejoin_timeout_cb(uint8_t param)
+{
+  if (s_stats.state == ZB_CONN_STATE_REJOINING)
+  {
+    ESP_LOGW(TAG, "Rejoin timed out");
+    zb_conn_join_failed(ESP_ERR_TIMEOUT);
+  }
+}
+
+static void zb_conn_dormant_timeout_cb(uint8_t param)
+{
+  if (s_stats.state == ZB_CONN_STATE_DORMANT ||
+      s_stats.state == ZB_CONN_STATE_ORPHANED)
+    zb_conn_rejoin_now();
+}
+
+/* wait for an admission slot before the next rejoin, radio off */
+static void zb_conn_schedule_rejoin(zb_conn_state_t state, uint32_t min_ms)
+{
+  uint32_t outage = zb_conn_now_ms() - s_outage_start_ms;
+  uint32_t delay = min_ms + zb_conn_admission_delay_ms(
+                                s_ieee_hash,
+                                s_rejoin_failures_in_row,
+                                outage,
+                                s_stats.pace);
+
+  s_stats.last_admission_delay_ms = delay;
+  zb_conn_enter(state);
+  esp_zb_scheduler_alarm_cancel(zb_conn_dormant_timeout_cb, 0);
+  esp_zb_scheduler_alarm(zb_conn_dormant_timeout_cb, 0, delay);
+}
+
+static uint32_t zb_conn_hash_ieee(void)
+{
+  esp_zb_ieee_addr_t addr;
+  uint32_t hash = 2166136261u;
+
+  esp_zb_get_long_address(addr);
+  for (size_t i = 0; i < sizeof(addr); ++i)
+  {
+    hash ^= addr[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void zb_conn_init(void)
+{
+  memset(&s_stats, 0, sizeof(s_stats));
+  s_stats.state = ZB_CONN_STATE_DORMANT;
+  s_state_enter_ms = zb_conn_now_ms();
+  s_outage_start_ms = s_state_enter_ms;
+  s_consecutive_poll_failures = 0;
+  s_rejoin_failures_in_row = 0;
+  s_ieee_hash = zb_conn_hash_ieee();
+  s_stats.pace = ZB_CONN_PACE_UNIT;
+}
+
+void zb_conn_rejoin_now(void)
+{
+  esp_zb_scheduler_alarm_cancel(zb_conn_dormant_timeout_cb, 0);
+  zb_conn_enter(ZB_CONN_STATE_REJOINING);
+  ++s_stats.rejoin_attempts;
+  ESP_LOGI(TAG, "Start network steering");
+  if (esp_zb_bdb_start_top_level_commissioning(
+          ESP_ZB_BDB_MODE_NETWORK_STEERING) != ESP_OK)
+    zb_conn_join_failed(ESP_FAIL);
+}
+
+void zb_conn_joined(void)
+{
+  esp_zb_scheduler_alarm_cancel(zb_conn_rejoin_timeout_cb, 0);
+  esp_zb_scheduler_alarm_cancel(zb_conn_dormant_timeout_cb, 0);
+  if (s_stats.state != ZB_CONN_STATE_JOINED &&
+      s_stats.state != ZB_CONN_STATE_DEGRADED)
+  {
+    s_stats.last_outage_ms = zb_conn_now_ms() - s_outage_start_ms;
+    ESP_LOGI(
+        TAG, "Network recovered after %" PRIu32 " ms", s_stats.last_outage_ms);
+  }
+  s_consecutive_poll_failures = 0;
+  s_rejoin_failures_in_row = 0;
+  s_stats.pace = zb_conn_pace_success(s_stats.pace);
+  zb_conn_enter(ZB_CONN_STATE_JOINED);
+}
+
+void zb_conn_join_failed(esp_err_t status)
+{
+  esp_zb_scheduler_alarm_cancel(zb_conn_rejoin_timeout_cb, 0);
+  ++s_stats.rejoin_failures;
+  if (s_rejoin_failures_in_row < UINT8_MAX)
+    ++s_rejoin_failures_in_row;
+
+  s_stats.pace = zb_conn_pace_failure(s_stats.pace);
+  zb_conn_schedule_rejoin(
+      ZB_CONN_STATE_DORMANT, zb_conn_backoff_ms(s_rejoin_failures_in_row));
+  ESP_LOGI(
+      TAG,
+      "Rejoin failed (status: %s), next attempt in %" PRIu32 " ms",
+      esp_err_to_name(status),
+      s_stats.last_admission_delay_ms);
+}
+
+void zb_conn_poll_failed(void)
+{
+  ++s_stats.poll_failures;
+  if (s_stats.state != ZB_CONN_STATE_JOINED &&
+      s_stats.state != ZB_CONN_STATE_DEGRADED)
+    return;
+
+  if (++s_consecutive_poll_failures >= ZB_CONN_POLL_FAIL_LIMIT)
+  {
+    s_stats.pace = zb_conn_pace_failure(s_stats.pace);
+    esp_zb_scheduler_alarm_cancel(zb_conn_degraded_timeout_cb, 0);
+    zb_conn_parent_lost(false);
+    return;
+  }
+  if (s_stats.state == ZB_CONN_STATE_JOINED)
+    zb_conn_enter(ZB_CONN_STATE_DEGRADED);
+  esp_zb_scheduler_alarm_cancel(zb_conn_degraded_timeout_cb, 0);
+  esp_zb_scheduler_alarm(
+      zb_conn_degraded_timeout_cb, 0, ZB_CONN_DEGRADED_HOLD_MS);
+}
+
+void zb_conn_nlme_status(uint8_t status)
+{
+  switch (status)
+  {
+  case ZB_NWK_COMMAND_STATUS_PARENT_LINK_FAILURE:
+    zb_conn_poll_failed();
+    break;
+  case ZB_NWK_COMMAND_STATUS_NO_ROUTE_AVAILABLE:
+  case ZB_NWK_COMMAND_STATUS_TREE_LINK_FAILURE:
+  case ZB_NWK_COMMAND_STATUS_NONE_TREE_LINK_FAILURE:
+  case ZB_NWK_COMMAND_STATUS_INDIRECT_TRANSACTION_EXPIRY:
+  case ZB_NWK_COMMAND_STATUS_TARGET_DEVICE_UNAVAILABLE:
+    zb_conn_link_failed();
+    break;
+  default:
+    break;
+  }
+}
+
+void zb_conn_link_failed(void)
+{
+  ++s_stats.link_failures;
+  s_stats.pace = zb_conn_pace_link_failure(s_stats.pace);
+}
+
+void zb_conn_parent_lost(bool stack_rejoins)
+{
+  ++s_stats.parent_losses;
+  s_outage_start_ms = zb_conn_now_ms();
+  s_consecutive_poll_failures = 0;
+  s_rejoin_failures_in_row = 0;
+
+  if (stack_rejoins)
+  {
+    /* the stack is already rejoining, only watch for it to give up */
+    zb_conn_enter(ZB_CONN_STATE_ORPHANED);
+    zb_conn_enter(ZB_CONN_STATE_REJOINING);
+    ++s_stats.rejoin_attempts;
+    esp_zb_scheduler_alarm(
+        zb_conn_rejoin_timeout_cb, 0, ZB_CONN_REJOIN_TIMEOUT_MS);
+  }
+  else
+  {
+    zb_conn_schedule_rejoin(ZB_CONN_STATE_ORPHANED, 0);
+  }
+}
+
+void zb_conn_removed(void)
+{
+  esp_zb_scheduler_alarm_cancel(zb_conn_degraded_timeout_cb, 0);
+  esp_zb_scheduler_alarm_cancel(zb_conn_rejoin_timeout_cb, 0);
+  esp_zb_scheduler_alarm_cancel(zb_conn_dormant_timeout_cb, 0);
+  s_consecutive_poll_failures = 0;
+  s_rejoin_failures_in_row = 0;
+  zb_conn_enter(ZB_CONN_STATE_DORMANT);
+}
+
+void zb_conn_set_long_poll_ms(uint32_t ms)
+{
+  s_long_poll_ms = ms;
+  zb_conn_poll_changed();
+}
+
+void zb_conn_set_fast_poll_ms(uint32_t ms)
+{
+  s_fast_poll_ms = ms;
+  zb_conn_poll_changed();
+}
+
+zb_conn_state_t zb_conn_get_state(void)
+{
+  return s_stats.state;
+}
+
+void zb_conn_get_stats(zb_conn_stats_t* stats)
+{
+  *stats = s_stats;
+  stats->time_in_state_ms[s_stats.state] +=
+      zb_conn_now_ms() - s_state_enter_ms;
+}
+
+const char* zb_conn_state_to_string(zb_conn_state_t state)
+{
+  static const char* const names[ZB_CONN_STATE_COUNT] = {
+      [ZB_CONN_STATE_JOINED] = "joined",
+      [ZB_CONN_STATE_DEGRADED] = "degraded",
+      [ZB_CONN_STATE_ORPHANED] = "orphaned",
+      [ZB_CONN_STATE_REJOINING] = "rejoining",
+      [ZB_CONN_STATE_DORMANT] = "dormant",
+  };
+  return state < ZB_CONN_STATE_COUNT ? names[state] : "unknown";
+}
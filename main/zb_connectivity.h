@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Zigbee end device connectivity state machine
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "zb_conn_policy.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* default long poll interval while the parent answers normally */
+#define ZB_CONN_JOINED_POLL_MS 7500
+/* faster poll interval used to confirm or clear a suspected parent loss */
+#define ZB_CONN_DEGRADED_POLL_MS 1000
+/* consecutive poll failures before the parent is considered lost */
+#define ZB_CONN_POLL_FAIL_LIMIT 3
+/* time without poll failure before leaving the degraded state */
+#define ZB_CONN_DEGRADED_HOLD_MS 5000
+/* how long to wait for a rejoin started by the stack itself */
+#define ZB_CONN_REJOIN_TIMEOUT_MS 10000
+
+  typedef enum
+  {
+    ZB_CONN_STATE_JOINED,
+    ZB_CONN_STATE_DEGRADED,
+    ZB_CONN_STATE_ORPHANED,
+    ZB_CONN_STATE_REJOINING,
+    ZB_CONN_STATE_DORMANT,
+    ZB_CONN_STATE_COUNT,
+  } zb_conn_state_t;
+
+  typedef struct
+  {
+    zb_conn_state_t state;
+    uint32_t enter_count[ZB_CONN_STATE_COUNT];
+    uint64_t time_in_state_ms[ZB_CONN_STATE_COUNT];
+    uint32_t poll_failures;
+    uint32_t parent_losses;
+    uint32_t rejoin_attempts;
+    uint32_t rejoin_failures;
+    uint32_t link_failures; /* frames lost at the MAC or NWK layer */
+    uint32_t last_outage_ms;
+    uint32_t last_admission_delay_ms;
+    uint16_t pace; /* current pacing factor, ZB_CONN_PACE_UNIT is 1x */
+  } zb_conn_stats_t;
+
+  /**
+   * @brief Reset the state machine, the device starts dormant (not joined)
+   *
+   * @note Must run after esp_zb_init(), the IEEE address seeds the rejoin
+   * admission jitter.
+   */
+  void zb_conn_init(void);
+
+  /**
+   * @brief Start a (re)join attempt right away
+   */
+  void zb_conn_rejoin_now(void);
+
+  /**
+   * @brief Notify that the device is on the network
+   */
+  void zb_conn_joined(void);
+
+  /**
+   * @brief Notify that a join or rejoin attempt failed
+   *
+   * @param status      status reported by the stack.
+   */
+  void zb_conn_join_failed(esp_err_t status);
+
+  /**
+   * @brief Notify that a data poll to the parent failed
+   */
+  void zb_conn_poll_failed(void);
+
+  /**
+   * @brief Notify an NLME-STATUS.indication
+   *
+   * A parent link failure counts as a failed poll, the other delivery
+   * failures as link failures.
+   */
+  void zb_conn_nlme_status(uint8_t status);
+
+  /**
+   * @brief Notify a frame the MAC or NWK layer failed to deliver, no ACK or
+   * no route, ZDO device unavailable
+   *
+   * Raises the pacing factor, so the next rejoins spread further, without
+   * changing the state.
+   */
+  void zb_conn_link_failed(void);
+
+  /**
+   * @brief Notify that the device lost its parent or left the network
+   *
+   * @param stack_rejoins true if the stack already started a rejoin itself.
+   */
+  void zb_conn_parent_lost(bool stack_rejoins);
+
+  /**
+   * @brief Notify that the coordinator removed the device, leave without
+   * rejoin
+   *
+   * No rejoin is scheduled: the device stays dormant, radio off, until it
+   * is reset and joins again as a new device.
+   */
+  void zb_conn_removed(void);
+
+  /**
+   * @brief Long poll interval while joined, ZB_CONN_JOINED_POLL_MS until
+   * changed
+   */
+  void zb_conn_set_long_poll_ms(uint32_t ms);
+
+  /**
+   * @brief Poll at least that often while on the network, 0 goes back to
+   * the interval of the current state
+   */
+  void zb_conn_set_fast_poll_ms(uint32_t ms);
+
+  zb_conn_state_t zb_conn_get_state(void);
+
+  /**
+   * @brief Snapshot of the counters, time_in_state_ms includes the current
+   * state up to now
+   */
+  void zb_conn_get_stats(zb_conn_stats_t* stats);
+
+  const char* zb_conn_state_to_string(zb_conn_state_t state);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
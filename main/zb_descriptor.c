@@ -0,0 +1,120 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Table driven endpoint, cluster and attribute descriptors
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "zb_descriptor.h"
+#include <inttypes.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "zb_arena.h"
+
+static const char* TAG = "zb_descriptor";
+
+static esp_err_t zb_desc_build_cluster(
+    const zb_cluster_desc_t* cluster, esp_zb_cluster_list_t* cluster_list)
+{
+  esp_zb_attribute_list_t* attr_list = esp_zb_zcl_attr_list_create(cluster->id);
+
+  ESP_RETURN_ON_FALSE(
+      attr_list, ESP_ERR_NO_MEM, TAG, "cluster 0x%04x", cluster->id);
+  for (int i = 0; i < cluster->attr_count; ++i)
+  {
+    const zb_attr_desc_t* attr = &cluster->attrs[i];
+    esp_err_t err =
+        cluster->add_attr
+            ? cluster->add_attr(attr_list, attr->id, attr->value)
+            : esp_zb_custom_cluster_add_custom_attr(
+                  attr_list, attr->id, attr->type, attr->access, attr->value);
+    ESP_RETURN_ON_ERROR(
+        err,
+        TAG,
+        "cluster 0x%04x attribute 0x%04x",
+        cluster->id,
+        attr->id);
+  }
+  return cluster->add_cluster(cluster_list, attr_list, cluster->role);
+}
+
+static esp_err_t zb_desc_build_lists(
+    const zb_endpoint_desc_t* endpoints,
+    size_t count,
+    esp_zb_ep_list_t** ep_list,
+    int* clusters,
+    int* attrs)
+{
+
+  *ep_list = esp_zb_ep_list_create();
+  ESP_RETURN_ON_FALSE(*ep_list, ESP_ERR_NO_MEM, TAG, "endpoint list");
+  for (size_t e = 0; e < count; ++e)
+  {
+    const zb_endpoint_desc_t* endpoint = &endpoints[e];
+    esp_zb_cluster_list_t* cluster_list = esp_zb_zcl_cluster_list_create();
+
+    ESP_RETURN_ON_FALSE(cluster_list, ESP_ERR_NO_MEM, TAG, "cluster list");
+    for (int c = 0; c < endpoint->cluster_count; ++c)
+    {
+      ESP_RETURN_ON_ERROR(
+          zb_desc_build_cluster(&endpoint->clusters[c], cluster_list),
+          TAG,
+          "endpoint %d",
+          endpoint->endpoint);
+      *attrs += endpoint->clusters[c].attr_count;
+    }
+    *clusters += endpoint->cluster_count;
+    ESP_RETURN_ON_ERROR(
+        esp_zb_ep_list_add_ep(
+            *ep_list,
+            cluster_list,
+            endpoint->endpoint,
+            endpoint->profile_id,
+            endpoint->device_id),
+        TAG,
+        "endpoint %d",
+        endpoint->endpoint);
+  }
+  return ESP_OK;
+}
+
+esp_err_t zb_desc_build(
+    const zb_endpoint_desc_t* endpoints,
+    size_t count,
+    esp_zb_ep_list_t** ep_list)
+{
+  int64_t start = esp_timer_get_time();
+  uint32_t heap = esp_get_free_heap_size();
+  zb_arena_stats_t before, after;
+  int clusters = 0;
+  int attrs = 0;
+
+  zb_arena_get_stats(&before);
+  /* the lists are never freed, keep them out of the heap; the only arena
+   * window of the firmware, nothing but the list constructors runs in it */
+  zb_arena_begin();
+  esp_err_t err =
+      zb_desc_build_lists(endpoints, count, ep_list, &clusters, &attrs);
+  zb_arena_end();
+  ESP_RETURN_ON_ERROR(err, TAG, "descriptor build");
+  zb_arena_get_stats(&after);
+  ESP_LOGI(
+      TAG,
+      "%d endpoints, %d clusters, %d attributes built in %" PRId64
+      " us, %u bytes of arena, %" PRIu32 " bytes of heap",
+      (int)count,
+      clusters,
+      attrs,
+      esp_timer_get_time() - start,
+      (unsigned)(after.used - before.used),
+      heap - esp_get_free_heap_size());
+  return ESP_OK;
+}
@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Table driven endpoint, cluster and attribute descriptors
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_zigbee_core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define ZB_DESC_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+/* attribute of a standard cluster, type and access come from the stack */
+#define ZB_DESC_ATTR(attr_id, storage) \
+  {                                    \
+    .id = (attr_id), .value = (storage) \
+  }
+/* attribute of a custom cluster */
+#define ZB_DESC_CUSTOM_ATTR(attr_id, attr_type, attr_access, storage)     \
+  {                                                                       \
+    .id = (attr_id), .type = (attr_type), .access = (attr_access),        \
+    .value = (storage)                                                    \
+  }
+/* standard cluster, kind is the esp_zb_<kind>_cluster_add_attr() name */
+#define ZB_DESC_CLUSTER(cluster_id, cluster_role, kind, attr_table) \
+  {                                                                 \
+    .id = (cluster_id), .role = (cluster_role),                     \
+    .add_attr = esp_zb_##kind##_cluster_add_attr,                   \
+    .add_cluster = esp_zb_cluster_list_add_##kind##_cluster,        \
+    .attrs = (attr_table), .attr_count = ZB_DESC_COUNT(attr_table)  \
+  }
+/* standard cluster without attribute, usually a client */
+#define ZB_DESC_EMPTY_CLUSTER(cluster_id, cluster_role, kind) \
+  {                                                           \
+    .id = (cluster_id), .role = (cluster_role),               \
+    .add_cluster = esp_zb_cluster_list_add_##kind##_cluster   \
+  }
+#define ZB_DESC_CUSTOM_CLUSTER(cluster_id, cluster_role, attr_table) \
+  {                                                                  \
+    .id = (cluster_id), .role = (cluster_role),                      \
+    .add_cluster = esp_zb_cluster_list_add_custom_cluster,           \
+    .attrs = (attr_table), .attr_count = ZB_DESC_COUNT(attr_table)   \
+  }
+
+  typedef struct
+  {
+    uint16_t id;
+    uint8_t type;   /* custom clusters only, esp_zb_zcl_attr_type_t */
+    uint8_t access; /* custom clusters only, esp_zb_zcl_attr_access_t */
+    /* initial value, the stack copies it into each endpoint built from the
+     * table, so one table can be shared by several endpoints */
+    void* value;
+  } zb_attr_desc_t;
+
+  typedef struct
+  {
+    uint16_t id;
+    uint8_t role;
+    /* NULL for custom clusters, esp_zb_custom_cluster_add_custom_attr() is
+     * used with the attribute type and access */
+    esp_err_t (*add_attr)(
+        esp_zb_attribute_list_t* attr_list, uint16_t attr_id, void* value_p);
+    esp_err_t (*add_cluster)(
+        esp_zb_cluster_list_t* cluster_list,
+        esp_zb_attribute_list_t* attr_list,
+        uint8_t role_mask);
+    const zb_attr_desc_t* attrs;
+    uint8_t attr_count;
+  } zb_cluster_desc_t;
+
+  typedef struct
+  {
+    uint8_t endpoint;
+    uint16_t profile_id;
+    uint16_t device_id;
+    const zb_cluster_desc_t* clusters;
+    uint8_t cluster_count;
+  } zb_endpoint_desc_t;
+
+  /**
+   * @brief Expand endpoint descriptors into an endpoint list
+   *
+   * @param endpoints   descriptor table.
+   * @param count       number of endpoints in the table.
+   * @param ep_list     endpoint list ready for esp_zb_device_register().
+   */
+  esp_err_t zb_desc_build(
+      const zb_endpoint_desc_t* endpoints,
+      size_t count,
+      esp_zb_ep_list_t** ep_list);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
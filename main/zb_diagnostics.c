@@ -0,0 +1,124 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Diagnostics cluster data: stack counters and press to send latency
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "zb_diagnostics.h"
+#include <string.h>
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "zboss_api.h"
+#include "zcl/zb_zcl_diagnostics.h"
+
+static const char* TAG = "zb_diag";
+
+static zb_diag_counters_t* s_counters;
+static void (*s_done)(void);
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t s_latency_ms[ZB_DIAG_LATENCY_WINDOW];
+static uint32_t s_latency_count;
+
+/* the stack filled diagnostics_ctx_zcl */
+static void zb_diag_synced(zb_uint8_t param)
+{
+  const zb_mac_diagnostic_info_t* mac = &diagnostics_ctx_zcl.mac_data;
+  const zdo_diagnostics_info_t* zdo = &diagnostics_ctx_zcl.zdo_data;
+  zb_diag_counters_t* c = s_counters;
+  void (*done)(void) = s_done;
+
+  c->number_of_resets = zdo->number_of_resets;
+  c->mac_rx_bcast = mac->mac_rx_bcast;
+  c->mac_tx_bcast = mac->mac_tx_bcast;
+  c->mac_rx_ucast = mac->mac_rx_ucast;
+  c->mac_tx_ucast = mac->mac_tx_ucast_total_zcl;
+  c->mac_tx_ucast_retry = mac->mac_tx_ucast_retries_zcl;
+  c->mac_tx_ucast_fail = mac->mac_tx_ucast_failures_zcl;
+  c->aps_tx_bcast = zdo->aps_tx_bcast;
+  c->aps_tx_ucast_success = zdo->aps_tx_ucast_success;
+  c->aps_tx_ucast_retry = zdo->aps_tx_ucast_retry;
+  c->aps_tx_ucast_fail = zdo->aps_tx_ucast_fail;
+  c->packet_buffer_allocate_failures = zdo->packet_buffer_allocate_failures;
+  c->average_mac_retry_per_aps = zdo->average_mac_retry_per_aps_message_sent;
+  c->last_lqi = mac->last_msg_lqi;
+  c->last_rssi = mac->last_msg_rssi;
+  c->nwk_retry_overflow = zdo->nwk_retry_overflow;
+  c->phy_cca_failures = mac->phy_cca_fail_count;
+  c->bcast_table_full = zdo->nwk_bcast_table_full;
+  s_counters = NULL;
+  s_done = NULL;
+  done();
+}
+
+esp_err_t zb_diag_sync(zb_diag_counters_t* counters, void (*done)(void))
+{
+  ESP_RETURN_ON_FALSE(
+      !s_counters, ESP_ERR_INVALID_STATE, TAG, "sync in progress");
+  s_counters = counters;
+  s_done = done;
+  if (zb_zcl_diagnostics_sync_counters(0, zb_diag_synced) != RET_OK)
+  {
+    s_counters = NULL;
+    s_done = NULL;
+    ESP_LOGW(TAG, "Failed to sync the stack counters");
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+void zb_diag_latency_add(int64_t us)
+{
+  /* rounded up, a sample is never 0 ms */
+  int64_t ms = (us + 999) / 1000;
+  uint16_t sample = ms > UINT16_MAX ? UINT16_MAX : ms;
+
+  portENTER_CRITICAL(&s_mux);
+  s_latency_ms[s_latency_count++ % ZB_DIAG_LATENCY_WINDOW] = sample;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+/* nearest rank percentile of sorted samples */
+static uint16_t zb_diag_percentile(const uint16_t* sorted, int n, int pct)
+{
+  int rank = (n * pct + 99) / 100;
+
+  return sorted[rank ? rank - 1 : 0];
+}
+
+void zb_diag_latency_get(zb_diag_latency_t* latency)
+{
+  uint16_t sorted[ZB_DIAG_LATENCY_WINDOW];
+  uint32_t count;
+
+  portENTER_CRITICAL(&s_mux);
+  count = s_latency_count;
+  memcpy(sorted, s_latency_ms, sizeof(sorted));
+  portEXIT_CRITICAL(&s_mux);
+
+  memset(latency, 0, sizeof(*latency));
+  latency->count = count;
+  int n = count < ZB_DIAG_LATENCY_WINDOW ? count : ZB_DIAG_LATENCY_WINDOW;
+  if (!n)
+    return;
+  /* insertion sort, the window is small */
+  for (int i = 1; i < n; ++i)
+  {
+    uint16_t v = sorted[i];
+    int j = i;
+    for (; j > 0 && sorted[j - 1] > v; --j)
+      sorted[j] = sorted[j - 1];
+    sorted[j] = v;
+  }
+  latency->p50_ms = zb_diag_percentile(sorted, n, 50);
+  latency->p90_ms = zb_diag_percentile(sorted, n, 90);
+  latency->p99_ms = zb_diag_percentile(sorted, n, 99);
+  latency->max_ms = sorted[n - 1];
+}
@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Diagnostics cluster data: stack counters and press to send latency
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* latency samples the percentiles are computed on, the most recent ones */
+#define ZB_DIAG_LATENCY_WINDOW 64
+
+  /**
+   * @brief Stack counters, one field per Diagnostics attribute with the
+   * attribute type, ready to be used as attribute storage
+   */
+  typedef struct
+  {
+    uint16_t number_of_resets;
+    uint32_t mac_rx_bcast;
+    uint32_t mac_tx_bcast;
+    uint32_t mac_rx_ucast;
+    uint32_t mac_tx_ucast;
+    uint16_t mac_tx_ucast_retry;
+    uint16_t mac_tx_ucast_fail;
+    uint16_t aps_tx_bcast;
+    uint16_t aps_tx_ucast_success;
+    uint16_t aps_tx_ucast_retry;
+    uint16_t aps_tx_ucast_fail;
+    uint16_t packet_buffer_allocate_failures;
+    uint16_t average_mac_retry_per_aps;
+    uint8_t last_lqi;
+    int8_t last_rssi;
+    /* ZBOSS specific counters, attributes 0xff00 to 0xff02 */
+    uint16_t nwk_retry_overflow;
+    uint16_t phy_cca_failures;
+    uint16_t bcast_table_full;
+  } zb_diag_counters_t;
+
+  typedef struct
+  {
+    uint32_t count; /* samples since boot */
+    uint16_t p50_ms;
+    uint16_t p90_ms;
+    uint16_t p99_ms;
+    uint16_t max_ms; /* over the window */
+  } zb_diag_latency_t;
+
+  /**
+   * @brief Copy the MAC, NWK and APS counters of the stack
+   *
+   * The stack collects its MAC counters asynchronously: counters is written
+   * and done called later from the Zigbee task. Call from the Zigbee task.
+   *
+   * @param counters    written before done is called, must stay valid.
+   * @param done        called once counters is up to date.
+   *
+   * @return ESP_ERR_INVALID_STATE if a copy is already in progress.
+   */
+  esp_err_t zb_diag_sync(zb_diag_counters_t* counters, void (*done)(void));
+
+  /**
+   * @brief Record the time from a button event to the command handed to
+   * the stack, callable from any task
+   */
+  void zb_diag_latency_add(int64_t us);
+
+  void zb_diag_latency_get(zb_diag_latency_t* latency);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,385 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Typed decoding of ZCL attribute values and attribute records
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#include "zcl_decode.h"
+#include <math.h>
+#include <string.h>
+#include "zcl/esp_zigbee_zcl_common.h"
+
+/* nesting accepted inside arrays and structures */
+#define ZCL_DECODE_MAX_DEPTH 4
+
+typedef struct
+{
+  uint8_t known : 1;
+  uint8_t kind : 7;
+  uint8_t width; /* 0 for variable size types */
+} zcl_type_info_t;
+
+#define ZCL_FIXED(k, w) {.known = 1, .kind = (k), .width = (w)}
+#define ZCL_VARIABLE(k) {.known = 1, .kind = (k)}
+
+/* indexed by type, ranges follow the ZCL data type table */
+static const zcl_type_info_t zcl_types[256] = {
+    [ESP_ZB_ZCL_ATTR_TYPE_NULL] = ZCL_VARIABLE(ZCL_VALUE_NULL),
+    [ESP_ZB_ZCL_ATTR_TYPE_8BIT] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 1),
+    [ESP_ZB_ZCL_ATTR_TYPE_16BIT] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 2),
+    [ESP_ZB_ZCL_ATTR_TYPE_24BIT] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 3),
+    [ESP_ZB_ZCL_ATTR_TYPE_32BIT] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 4),
+    [ESP_ZB_ZCL_ATTR_TYPE_40BIT] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 5),
+    [ESP_ZB_ZCL_ATTR_TYPE_48BIT] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 6),
+    [ESP_ZB_ZCL_ATTR_TYPE_56BIT] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 7),
+    [ESP_ZB_ZCL_ATTR_TYPE_64BIT] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 8),
+    [ESP_ZB_ZCL_ATTR_TYPE_BOOL] = ZCL_FIXED(ZCL_VALUE_BOOL, 1),
+    [ESP_ZB_ZCL_ATTR_TYPE_8BITMAP] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 1),
+    [ESP_ZB_ZCL_ATTR_TYPE_16BITMAP] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 2),
+    [ESP_ZB_ZCL_ATTR_TYPE_24BITMAP] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 3),
+    [ESP_ZB_ZCL_ATTR_TYPE_32BITMAP] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 4),
+    [ESP_ZB_ZCL_ATTR_TYPE_40BITMAP] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 5),
+    [ESP_ZB_ZCL_ATTR_TYPE_48BITMAP] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 6),
+    [ESP_ZB_ZCL_ATTR_TYPE_56BITMAP] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 7),
+    [ESP_ZB_ZCL_ATTR_TYPE_64BITMAP] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 8),
+    [ESP_ZB_ZCL_ATTR_TYPE_U8] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 1),
+    [ESP_ZB_ZCL_ATTR_TYPE_U16] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 2),
+    [ESP_ZB_ZCL_ATTR_TYPE_U24] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 3),
+    [ESP_ZB_ZCL_ATTR_TYPE_U32] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 4),
+    [ESP_ZB_ZCL_ATTR_TYPE_U40] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 5),
+    [ESP_ZB_ZCL_ATTR_TYPE_U48] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 6),
+    [ESP_ZB_ZCL_ATTR_TYPE_U56] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 7),
+    [ESP_ZB_ZCL_ATTR_TYPE_U64] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 8),
+    [ESP_ZB_ZCL_ATTR_TYPE_S8] = ZCL_FIXED(ZCL_VALUE_SIGNED, 1),
+    [ESP_ZB_ZCL_ATTR_TYPE_S16] = ZCL_FIXED(ZCL_VALUE_SIGNED, 2),
+    [ESP_ZB_ZCL_ATTR_TYPE_S24] = ZCL_FIXED(ZCL_VALUE_SIGNED, 3),
+    [ESP_ZB_ZCL_ATTR_TYPE_S32] = ZCL_FIXED(ZCL_VALUE_SIGNED, 4),
+    [ESP_ZB_ZCL_ATTR_TYPE_S40] = ZCL_FIXED(ZCL_VALUE_SIGNED, 5),
+    [ESP_ZB_ZCL_ATTR_TYPE_S48] = ZCL_FIXED(ZCL_VALUE_SIGNED, 6),
+    [ESP_ZB_ZCL_ATTR_TYPE_S56] = ZCL_FIXED(ZCL_VALUE_SIGNED, 7),
+    [ESP_ZB_ZCL_ATTR_TYPE_S64] = ZCL_FIXED(ZCL_VALUE_SIGNED, 8),
+    [ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 1),
+    [ESP_ZB_ZCL_ATTR_TYPE_16BIT_ENUM] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 2),
+    [ESP_ZB_ZCL_ATTR_TYPE_SEMI] = ZCL_FIXED(ZCL_VALUE_FLOAT, 2),
+    [ESP_ZB_ZCL_ATTR_TYPE_SINGLE] = ZCL_FIXED(ZCL_VALUE_FLOAT, 4),
+    [ESP_ZB_ZCL_ATTR_TYPE_DOUBLE] = ZCL_FIXED(ZCL_VALUE_DOUBLE, 8),
+    [ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING] = ZCL_VARIABLE(ZCL_VALUE_STRING),
+    [ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING] = ZCL_VARIABLE(ZCL_VALUE_STRING),
+    [ESP_ZB_ZCL_ATTR_TYPE_LONG_OCTET_STRING] = ZCL_VARIABLE(ZCL_VALUE_STRING),
+    [ESP_ZB_ZCL_ATTR_TYPE_LONG_CHAR_STRING] = ZCL_VARIABLE(ZCL_VALUE_STRING),
+    [ESP_ZB_ZCL_ATTR_TYPE_ARRAY] = ZCL_VARIABLE(ZCL_VALUE_ARRAY),
+    [ESP_ZB_ZCL_ATTR_TYPE_STRUCTURE] = ZCL_VARIABLE(ZCL_VALUE_STRUCT),
+    [ESP_ZB_ZCL_ATTR_TYPE_SET] = ZCL_VARIABLE(ZCL_VALUE_ARRAY),
+    [ESP_ZB_ZCL_ATTR_TYPE_BAG] = ZCL_VARIABLE(ZCL_VALUE_ARRAY),
+    [ESP_ZB_ZCL_ATTR_TYPE_TIME_OF_DAY] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 4),
+    [ESP_ZB_ZCL_ATTR_TYPE_DATE] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 4),
+    [ESP_ZB_ZCL_ATTR_TYPE_UTC_TIME] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 4),
+    [ESP_ZB_ZCL_ATTR_TYPE_CLUSTER_ID] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 2),
+    [ESP_ZB_ZCL_ATTR_TYPE_ATTRIBUTE_ID] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 2),
+    [ESP_ZB_ZCL_ATTR_TYPE_BACNET_OID] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 4),
+    [ESP_ZB_ZCL_ATTR_TYPE_IEEE_ADDR] = ZCL_FIXED(ZCL_VALUE_UNSIGNED, 8),
+    [ESP_ZB_ZCL_ATTR_TYPE_128_BIT_KEY] = ZCL_FIXED(ZCL_VALUE_BYTES, 16),
+};
+
+static inline uint64_t zcl_get_le(const uint8_t* p, uint8_t width)
+{
+  uint64_t u = 0;
+
+  for (uint8_t i = width; i-- > 0;)
+    u = (u << 8) | p[i];
+  return u;
+}
+
+static float zcl_semi_to_float(uint16_t h)
+{
+  int exp = (h >> 10) & 0x1f;
+  float mant = h & 0x3ff;
+  float f;
+
+  if (exp == 0x1f)
+    f = mant ? NAN : INFINITY;
+  else if (exp == 0)
+    f = ldexpf(mant, -24);
+  else
+    f = ldexpf(mant + 1024, exp - 25);
+  return (h & 0x8000) ? -f : f;
+}
+
+static bool zcl_decode_scalar(
+    zcl_type_info_t info, const uint8_t* buf, zcl_value_t* value)
+{
+  uint64_t u = zcl_get_le(buf, info.width);
+
+  value->data = buf;
+  value->len = value->size = info.width;
+  switch (info.kind)
+  {
+  case ZCL_VALUE_BOOL:
+    value->v.b = u != 0;
+    break;
+  case ZCL_VALUE_SIGNED:
+  {
+    unsigned shift = 64 - 8 * info.width;
+    value->v.s = (int64_t)(u << shift) >> shift;
+    break;
+  }
+  case ZCL_VALUE_FLOAT:
+    if (info.width == 2)
+      value->v.f = zcl_semi_to_float((uint16_t)u);
+    else
+    {
+      uint32_t bits = (uint32_t)u;
+      memcpy(&value->v.f, &bits, sizeof(bits));
+    }
+    break;
+  case ZCL_VALUE_DOUBLE:
+    memcpy(&value->v.d, &u, sizeof(u));
+    break;
+  case ZCL_VALUE_BYTES:
+    break;
+  default:
+    value->v.u = u;
+    break;
+  }
+  return true;
+}
+
+static bool zcl_decode_depth(
+    uint8_t type,
+    const uint8_t* buf,
+    size_t len,
+    zcl_value_t* value,
+    int depth);
+
+static bool zcl_decode_string(
+    uint8_t type, const uint8_t* buf, size_t len, zcl_value_t* value)
+{
+  bool is_long = type == ESP_ZB_ZCL_ATTR_TYPE_LONG_OCTET_STRING ||
+                 type == ESP_ZB_ZCL_ATTR_TYPE_LONG_CHAR_STRING;
+  size_t prefix = is_long ? 2 : 1;
+
+  if (len < prefix)
+    return false;
+  size_t n = zcl_get_le(buf, prefix);
+  if (n == (is_long ? 0xffffu : 0xffu))
+  {
+    /* invalid value, the string is absent */
+    value->kind = ZCL_VALUE_NULL;
+    value->size = prefix;
+    return true;
+  }
+  if (n > len - prefix)
+    return false;
+  value->data = buf + prefix;
+  value->len = n;
+  value->size = prefix + n;
+  return true;
+}
+
+static bool zcl_decode_collection(
+    uint8_t type,
+    const uint8_t* buf,
+    size_t len,
+    zcl_value_t* value,
+    int depth)
+{
+  size_t header = type == ESP_ZB_ZCL_ATTR_TYPE_STRUCTURE ? 2 : 3;
+  zcl_elem_iter_t it;
+  zcl_value_t elem;
+
+  if (len < header || depth >= ZCL_DECODE_MAX_DEPTH)
+    return false;
+  value->elem_type = header == 3 ? buf[0] : 0;
+  if (header == 3 && (value->elem_type == ESP_ZB_ZCL_ATTR_TYPE_NULL ||
+                      !zcl_types[value->elem_type].known))
+    return false;
+  value->count = zcl_get_le(buf + header - 2, 2);
+  value->data = buf + header;
+  if (value->count == 0xffff)
+  {
+    value->kind = ZCL_VALUE_NULL;
+    value->count = 0;
+    value->size = header;
+    return true;
+  }
+
+  uint8_t width = zcl_type_width(value->elem_type);
+  if (width)
+  {
+    /* fixed size elements, no need to walk them */
+    if ((size_t)value->count * width > len - header)
+      return false;
+    value->len = value->count * width;
+    value->size = header + value->len;
+    return true;
+  }
+  /* walk the elements to find the end of the value */
+  it.pos = value->data;
+  it.end = buf + len;
+  it.elem_type = value->elem_type;
+  it.left = value->count;
+  while (it.left)
+  {
+    uint8_t elem_type = it.elem_type;
+    if (!elem_type)
+    {
+      if (it.pos >= it.end)
+        return false;
+      elem_type = *it.pos++;
+    }
+    if (!zcl_decode_depth(
+            elem_type, it.pos, it.end - it.pos, &elem, depth + 1))
+      return false;
+    it.pos += elem.size;
+    it.left--;
+  }
+  value->len = it.pos - value->data;
+  value->size = header + value->len;
+  return true;
+}
+
+static bool zcl_decode_depth(
+    uint8_t type,
+    const uint8_t* buf,
+    size_t len,
+    zcl_value_t* value,
+    int depth)
+{
+  zcl_type_info_t info = zcl_types[type];
+
+  if (!info.known)
+    return false;
+  value->type = type;
+  value->kind = info.kind;
+  value->elem_type = 0;
+  value->count = 0;
+  if (info.width)
+    return len >= info.width && zcl_decode_scalar(info, buf, value);
+
+  value->data = buf;
+  value->len = 0;
+  value->size = 0;
+  switch (info.kind)
+  {
+  case ZCL_VALUE_NULL:
+    return true;
+  case ZCL_VALUE_STRING:
+    return zcl_decode_string(type, buf, len, value);
+  default:
+    return zcl_decode_collection(type, buf, len, value, depth);
+  }
+}
+
+bool zcl_decode(
+    uint8_t type, const uint8_t* buf, size_t len, zcl_value_t* value)
+{
+  return zcl_decode_depth(type, buf, len, value, 0);
+}
+
+uint8_t zcl_type_width(uint8_t type)
+{
+  return zcl_types[type].width;
+}
+
+void zcl_records_init(
+    zcl_record_iter_t* it,
+    const uint8_t* payload,
+    size_t len,
+    bool with_status)
+{
+  it->pos = payload;
+  it->end = payload + len;
+  it->with_status = with_status;
+  it->error = false;
+}
+
+bool zcl_records_next(zcl_record_iter_t* it, zcl_attr_record_t* record)
+{
+  size_t left = it->end - it->pos;
+
+  if (!left)
+    return false;
+  /* attribute id then type, or status for read responses */
+  if (left < 3)
+    goto error;
+  record->attr_id = zcl_get_le(it->pos, 2);
+  it->pos += 2;
+  record->status = ESP_ZB_ZCL_STATUS_SUCCESS;
+  if (it->with_status)
+  {
+    record->status = *it->pos++;
+    if (record->status != ESP_ZB_ZCL_STATUS_SUCCESS)
+    {
+      /* failed reads carry neither type nor value */
+      record->value.type = ESP_ZB_ZCL_ATTR_TYPE_NULL;
+      record->value.kind = ZCL_VALUE_NULL;
+      record->value.size = 0;
+      return true;
+    }
+    if (it->pos >= it->end)
+      goto error;
+  }
+
+  uint8_t type = *it->pos++;
+  if (!zcl_decode(type, it->pos, it->end - it->pos, &record->value))
+    goto error;
+  it->pos += record->value.size;
+  return true;
+
+error:
+  it->error = true;
+  it->pos = it->end;
+  return false;
+}
+
+void zcl_elems_init(zcl_elem_iter_t* it, const zcl_value_t* container)
+{
+  it->pos = container->data;
+  it->end = container->data + container->len;
+  it->elem_type = container->kind == ZCL_VALUE_ARRAY ? container->elem_type : 0;
+  it->left = container->count;
+}
+
+bool zcl_elems_next(zcl_elem_iter_t* it, zcl_value_t* value)
+{
+  uint8_t type = it->elem_type;
+
+  if (!it->left)
+    return false;
+  if (!type)
+  {
+    if (it->pos >= it->end)
+      return false;
+    type = *it->pos++;
+  }
+  if (!zcl_decode(type, it->pos, it->end - it->pos, value))
+  {
+    it->left = 0;
+    return false;
+  }
+  it->pos += value->size;
+  it->left--;
+  return true;
+}
+
+zcl_attr_handler_t zcl_route_find(
+    const zcl_attr_route_t* routes,
+    size_t count,
+    uint16_t cluster_id,
+    uint16_t attr_id)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (routes[i].cluster_id == cluster_id &&
+        (routes[i].attr_id == attr_id || routes[i].attr_id == ZCL_ATTR_ANY))
+      return routes[i].handler;
+  }
+  return NULL;
+}
@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Typed decoding of ZCL attribute values and attribute records
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* matches any attribute of the cluster in a zcl_attr_route_t */
+#define ZCL_ATTR_ANY 0xffff
+
+  typedef enum
+  {
+    ZCL_VALUE_NULL,     /* no data, or the ZCL invalid value of a string */
+    ZCL_VALUE_BOOL,     /* v.b */
+    ZCL_VALUE_UNSIGNED, /* v.u: uint, data, bitmap, enum, time, ids */
+    ZCL_VALUE_SIGNED,   /* v.s, sign extended */
+    ZCL_VALUE_FLOAT,    /* v.f: semi and single precision */
+    ZCL_VALUE_DOUBLE,   /* v.d */
+    ZCL_VALUE_STRING,   /* data and len: contents without the length */
+    ZCL_VALUE_ARRAY,    /* array, set, bag: elem_type, count, data */
+    ZCL_VALUE_STRUCT,   /* count, data: typed elements */
+    ZCL_VALUE_BYTES,    /* opaque fixed size value, 128-bit key */
+  } zcl_value_kind_t;
+
+  /**
+   * @brief Decoded value, data points into the decoded buffer, nothing is
+   * copied
+   */
+  typedef struct
+  {
+    uint8_t type; /* esp_zb_zcl_attr_type_t */
+    uint8_t kind; /* zcl_value_kind_t */
+    uint8_t elem_type;
+    uint16_t count;
+    uint16_t len;  /* bytes at data */
+    uint16_t size; /* encoded size, type specific headers included */
+    const uint8_t* data;
+    union
+    {
+      bool b;
+      uint64_t u;
+      int64_t s;
+      float f;
+      double d;
+    } v;
+  } zcl_value_t;
+
+  /**
+   * @brief One record of a Report Attributes or Read Attributes Response
+   * payload
+   */
+  typedef struct
+  {
+    uint16_t attr_id;
+    uint8_t status; /* always success in reports */
+    zcl_value_t value;
+  } zcl_attr_record_t;
+
+  typedef struct
+  {
+    const uint8_t* pos;
+    const uint8_t* end;
+    bool with_status; /* read responses carry a status per record */
+    bool error;       /* set when a record is truncated or unknown */
+  } zcl_record_iter_t;
+
+  /**
+   * @brief Iterator over the elements of an array, set, bag or structure
+   */
+  typedef struct
+  {
+    const uint8_t* pos;
+    const uint8_t* end;
+    uint8_t elem_type; /* 0 for structures, each element has its own type */
+    uint16_t left;
+  } zcl_elem_iter_t;
+
+  /**
+   * @brief Decode one value in ZCL wire format (little endian)
+   *
+   * @param type        ZCL data type.
+   * @param buf         encoded value.
+   * @param len         bytes available at buf.
+   * @param value       decoded value, views into buf.
+   *
+   * @return false if the type is unknown or the value is truncated.
+   */
+  bool zcl_decode(
+      uint8_t type, const uint8_t* buf, size_t len, zcl_value_t* value);
+
+  /**
+   * @brief Encoded size of a fixed size type, 0 if the size depends on the
+   * value or the type is unknown
+   */
+  uint8_t zcl_type_width(uint8_t type);
+
+  void zcl_records_init(
+      zcl_record_iter_t* it,
+      const uint8_t* payload,
+      size_t len,
+      bool with_status);
+
+  /**
+   * @brief Decode the next attribute record
+   *
+   * @return false at the end of the payload or on error, see it->error.
+   */
+  bool zcl_records_next(zcl_record_iter_t* it, zcl_attr_record_t* record);
+
+  void zcl_elems_init(zcl_elem_iter_t* it, const zcl_value_t* container);
+
+  bool zcl_elems_next(zcl_elem_iter_t* it, zcl_value_t* value);
+
+  /**
+   * @brief Source of a decoded attribute
+   */
+  typedef struct
+  {
+    uint16_t short_addr;
+    uint8_t src_endpoint;
+    uint8_t dst_endpoint;
+    uint16_t cluster_id;
+  } zcl_attr_src_t;
+
+  typedef void (*zcl_attr_handler_t)(
+      const zcl_attr_src_t* src,
+      uint16_t attr_id,
+      const zcl_value_t* value);
+
+  typedef struct
+  {
+    uint16_t cluster_id;
+    uint16_t attr_id; /* ZCL_ATTR_ANY for the whole cluster */
+    zcl_attr_handler_t handler;
+  } zcl_attr_route_t;
+
+  /**
+   * @brief First route of the table matching the cluster and attribute
+   *
+   * @return NULL if no route matches.
+   */
+  zcl_attr_handler_t zcl_route_find(
+      const zcl_attr_route_t* routes,
+      size_t count,
+      uint16_t cluster_id,
+      uint16_t attr_id);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,188 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host test of the attribute report scheduler (main/attr_report_policy.c)
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * Build and run from the project directory:
+ *
+ *   cc -O2 -I main tools/attr_report_test.c main/attr_report_policy.c \
+ *     -o attr_report_test
+ *   ./attr_report_test
+ *
+ * Runs the reported attributes of the device (battery voltage and
+ * percentage, average current) through a day of wake ups: a data poll
+ * every TEST_POLL_MS and a button now and then. The values move on some
+ * wake ups, the current only in the first half of the day. test_update()
+ * and test_on_wake() do what attr_report_update() and attr_report_on_wake()
+ * do around the stack calls. Checked:
+ *
+ * - once a wake up ran the scheduler, nothing is due until the next one,
+ *   no report ever waits for a timer;
+ * - two reports of an attribute are at least its min interval apart;
+ * - a periodic report comes at most one poll after its max interval;
+ * - a reportable change goes out at most one poll after it is allowed;
+ * - a report aligned early only goes out with another report.
+ *
+ * Exits with 1 on the first failure.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "attr_report_policy.h"
+
+/* ZB_CONN_JOINED_POLL_MS */
+#define TEST_POLL_MS 7500
+#define TEST_DAY_MS (24 * 3600 * 1000LL)
+#define TEST_S(s) ((s) * 1000000LL)
+
+static uint16_t s_voltage = 30; /* 100 mV */
+static uint8_t s_percentage = 200;
+static uint32_t s_current_ua = 400;
+
+/* battery_monitor.h and esp_zb_light.h */
+static const attr_report_desc_t s_descs[] = {
+    {.cluster_id = 0x0001,
+     .attr_id = 0x0020,
+     .value = &s_voltage,
+     .size = sizeof(s_voltage),
+     .min_interval_s = 60,
+     .max_interval_s = 6 * 60 * 60,
+     .change = 1},
+    {.cluster_id = 0x0001,
+     .attr_id = 0x0021,
+     .value = &s_percentage,
+     .size = sizeof(s_percentage),
+     .min_interval_s = 60,
+     .max_interval_s = 6 * 60 * 60,
+     .change = 4},
+    {.cluster_id = 0x0b05,
+     .attr_id = 0xff00,
+     .value = &s_current_ua,
+     .size = sizeof(s_current_ua),
+     .min_interval_s = 60,
+     .max_interval_s = 3600,
+     .change = 20},
+};
+#define TEST_COUNT ((int)(sizeof(s_descs) / sizeof(s_descs[0])))
+
+static attr_report_slot_t s_slots[TEST_COUNT];
+/* since when a marked change may go out, 0 when none waits */
+static int64_t s_allowed_us[TEST_COUNT];
+static uint32_t s_reports[ATTR_REPORT_ALIGNED + 1];
+static uint32_t s_wakes;
+static uint32_t s_rng = 0x2545f491;
+
+static uint32_t test_random(uint32_t range)
+{
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng % range;
+}
+
+static void test_fail(const char* what, int slot, int64_t now_us)
+{
+  printf(
+      "FAIL at %.1f s, attribute 0x%04x: %s\n",
+      now_us / 1e6,
+      s_descs[slot].attr_id,
+      what);
+  exit(1);
+}
+
+static void test_update(int i, int64_t now_us)
+{
+  attr_report_mark_t mark = attr_report_mark(&s_slots[i], now_us);
+  int64_t allowed =
+      s_slots[i].last_us + TEST_S(s_descs[i].min_interval_s);
+
+  if (mark == ATTR_REPORT_MARKED || mark == ATTR_REPORT_HELD)
+    s_allowed_us[i] = allowed > now_us ? allowed : now_us;
+}
+
+static void test_on_wake(int64_t now_us)
+{
+  attr_report_reason_t reasons[ATTR_REPORT_MAX];
+  int due = attr_report_select(s_slots, TEST_COUNT, now_us, reasons);
+  int aligned = 0;
+
+  ++s_wakes;
+  for (int i = 0; i < TEST_COUNT; ++i)
+  {
+    const attr_report_slot_t* slot = &s_slots[i];
+    int64_t elapsed = now_us - slot->last_us;
+
+    if (reasons[i] == ATTR_REPORT_NONE)
+    {
+      if (slot->sent_once && s_descs[i].max_interval_s &&
+          elapsed > TEST_S(s_descs[i].max_interval_s) + TEST_POLL_MS * 1000LL)
+        test_fail("periodic report late", i, now_us);
+      if (s_allowed_us[i] &&
+          now_us > s_allowed_us[i] + TEST_POLL_MS * 1000LL)
+        test_fail("change report late", i, now_us);
+      continue;
+    }
+    if (slot->sent_once && elapsed < TEST_S(s_descs[i].min_interval_s))
+      test_fail("min interval", i, now_us);
+    if (reasons[i] == ATTR_REPORT_ALIGNED)
+      ++aligned;
+    ++s_reports[reasons[i]];
+  }
+  if (due && aligned == due)
+    test_fail("aligned report alone", 0, now_us);
+  for (int i = 0; i < TEST_COUNT; ++i)
+    if (reasons[i] != ATTR_REPORT_NONE)
+    {
+      attr_report_sent(&s_slots[i], now_us);
+      s_allowed_us[i] = 0;
+    }
+  if (attr_report_select(s_slots, TEST_COUNT, now_us, reasons))
+    test_fail("still due after the wake up", 0, now_us);
+}
+
+int main(void)
+{
+  int64_t now_ms = 0;
+
+  for (int i = 0; i < TEST_COUNT; ++i)
+    s_slots[i] = (attr_report_slot_t){.desc = &s_descs[i], .pending = true};
+  while (now_ms < TEST_DAY_MS)
+  {
+    /* a poll, or a button press before it */
+    now_ms += test_random(20) ? TEST_POLL_MS : 1 + test_random(TEST_POLL_MS);
+    if (!test_random(40) && s_voltage > 20)
+    {
+      --s_voltage;
+      test_update(0, now_ms * 1000);
+    }
+    if (!test_random(30))
+    {
+      s_percentage = s_voltage * 200 / 30 - test_random(3);
+      test_update(1, now_ms * 1000);
+    }
+    /* quiet in the second half, periodic reports only */
+    if (now_ms < TEST_DAY_MS / 2 && !test_random(4))
+    {
+      s_current_ua = 400 + test_random(60);
+      test_update(2, now_ms * 1000);
+    }
+    test_on_wake(now_ms * 1000);
+  }
+  printf(
+      "%u wake ups, reports: %u change, %u periodic, %u aligned\n",
+      s_wakes,
+      s_reports[ATTR_REPORT_CHANGE],
+      s_reports[ATTR_REPORT_PERIODIC],
+      s_reports[ATTR_REPORT_ALIGNED]);
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+#
+# SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: CC0-1.0
+#
+# Decode the "BL:" lines printed by binlog_flush() using the strings of the
+# firmware ELF.
+#
+# usage: idf.py monitor | tools/binlog_decode.py build/light_bulb.elf
+
+import argparse
+import re
+import sys
+
+from elftools.elf.elffile import ELFFile
+from elftools.elf.constants import SH_FLAGS
+
+# printf conversion, length modifiers dropped since every argument is 32 bit
+CONVERSION = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z|j|t)?([diouxXcsp%])')
+
+
+class StringTable:
+    def __init__(self, path):
+        self.sections = []
+        with open(path, 'rb') as f:
+            elf = ELFFile(f)
+            for section in elf.iter_sections():
+                if section['sh_flags'] & SH_FLAGS.SHF_ALLOC and section['sh_type'] == 'SHT_PROGBITS':
+                    self.sections.append((section['sh_addr'], section.data()))
+
+    def string(self, addr):
+        for base, data in self.sections:
+            if base <= addr < base + len(data):
+                end = data.index(b'\0', addr - base)
+                return data[addr - base:end].decode('utf-8', 'replace')
+        return '<0x%08x>' % addr
+
+
+def format_entry(strings, fmt, args):
+    args = iter(args)
+
+    def convert(match):
+        flags, conv = match.groups()
+        if conv == '%':
+            return '%'
+        value = next(args, 0)
+        if conv == 's':
+            return strings.string(value)
+        if conv == 'p':
+            return '0x%08x' % value
+        if conv in 'di':
+            value = value - (1 << 32) if value & 0x80000000 else value
+        return ('%' + flags + conv) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode binlog entries')
+    parser.add_argument('elf', help='firmware ELF file')
+    parser.add_argument('input', nargs='?', type=argparse.FileType('r'), default=sys.stdin,
+                        help='console capture, stdin by default')
+    args = parser.parse_args()
+
+    strings = StringTable(args.elf)
+    for line in args.input:
+        marker = line.find('BL:')
+        if marker < 0:
+            sys.stdout.write(line)
+            continue
+        words = [int(w, 16) for w in line[marker + 3:].split()]
+        if len(words) < 4:
+            continue
+        ms, tag, fmt = words[1:4]
+        print('B (%d) %s: %s' % (ms, strings.string(tag),
+                                 format_entry(strings, strings.string(fmt), words[4:])))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,209 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host benchmark of the LED strip framebuffer (main/light_fb.c)
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * Build and run from the project directory:
+ *
+ *   cc -O2 -I main tools/light_fb_bench.c main/light_fb.c \
+ *     main/light_transition.c -o light_fb_bench
+ *   ./light_fb_bench
+ *
+ * Drives strips of 1, 60 and 300 pixels through a fade of the whole strip,
+ * frames that do not change and a single moving pixel, at one frame every
+ * LIGHT_TRANSITION_FRAME_MS. The refresh path of the light driver is
+ * replayed with a stand-in for led_strip_set_pixel() (GRB copy into the
+ * RMT buffer), once writing every pixel of every frame as before, once
+ * through the framebuffer. The transfer is not simulated: its time and the
+ * RMT refill interrupts follow from the WS2812 timing.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "light_fb.h"
+#include "light_transition.h"
+
+#define BENCH_MAX_PIXELS 300
+#define BENCH_FRAMES 100
+#define BENCH_ROUNDS 200
+/* 24 bits of 1.25 us per pixel, then the 50 us reset code of led_strip */
+#define BENCH_PIXEL_NS 30000
+#define BENCH_RESET_NS 50000
+/* SOC_RMT_MEM_WORDS_PER_CHANNEL on the ESP32-C6, refilled by halves */
+#define BENCH_RMT_SYMBOLS 48
+
+typedef enum
+{
+  BENCH_FADE,
+  BENCH_STILL,
+  BENCH_CHASE,
+  BENCH_SCENES,
+} bench_scene_t;
+
+static const char* const s_scene_names[] = {
+    "fade",
+    "still",
+    "chase",
+};
+
+typedef struct
+{
+  uint64_t cpu_ns;
+  uint64_t pixels;
+  uint32_t refreshes;
+} bench_result_t;
+
+static uint8_t s_rmt[BENCH_MAX_PIXELS * 3];
+
+static uint64_t bench_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* what led_strip_set_pixel() does for a WS2812, a call into the
+ * component with its argument checks */
+__attribute__((noinline)) static int bench_set_pixel(
+    uint16_t index, const uint8_t* rgb)
+{
+  uint8_t* p = &s_rmt[index * 3];
+
+  if (index >= BENCH_MAX_PIXELS)
+    return -1;
+  p[0] = rgb[1];
+  p[1] = rgb[0];
+  p[2] = rgb[2];
+  return 0;
+}
+
+/* the frame the light driver draws, one color or a dot on a dark strip */
+static void bench_frame(
+    bench_scene_t scene,
+    light_transition_t* transition,
+    int frame,
+    uint16_t count,
+    uint8_t color[3],
+    int* dot)
+{
+  uint16_t rgb[3];
+
+  *dot = -1;
+  if (scene == BENCH_CHASE)
+  {
+    color[0] = color[1] = color[2] = 0;
+    *dot = frame % count;
+    return;
+  }
+  if (scene == BENCH_FADE)
+    light_transition_step(transition);
+  light_transition_output(transition, rgb);
+  for (int c = 0; c < 3; ++c)
+    color[c] = rgb[c] >> 8;
+}
+
+static void bench_run(
+    bench_scene_t scene, uint16_t count, bool use_fb, bench_result_t* result)
+{
+  static const uint8_t white[3] = {255, 255, 255};
+  static uint8_t pixels[BENCH_MAX_PIXELS * LIGHT_FB_BYTES_PER_PIXEL];
+  uint16_t off[LIGHT_CHANNELS] = {0, 0xffff, 0xffff, 0xffff};
+  uint16_t on[LIGHT_CHANNELS] = {0xff00, 0xffff, 0x8000, 0x2000};
+  light_transition_t transition;
+  light_fb_t fb;
+
+  memset(result, 0, sizeof(*result));
+  light_fb_init(&fb, pixels, count);
+  for (int round = 0; round < BENCH_ROUNDS; ++round)
+  {
+    light_transition_init(&transition, scene == BENCH_STILL ? on : off);
+    light_transition_start(&transition, on, BENCH_FRAMES);
+    for (int frame = 0; frame < BENCH_FRAMES; ++frame)
+    {
+      uint8_t color[3];
+      uint16_t first;
+      uint16_t end;
+      int dot;
+      uint64_t t0 = bench_ns();
+
+      bench_frame(scene, &transition, frame, count, color, &dot);
+      if (!use_fb)
+      {
+        for (uint16_t i = 0; i < count; ++i)
+          bench_set_pixel(i, (int)i == dot ? white : color);
+        first = 0;
+        end = count;
+      }
+      else
+      {
+        light_fb_fill(&fb, 0, count, color);
+        if (dot >= 0)
+          light_fb_set(&fb, dot, white);
+        if (!light_fb_take_dirty(&fb, &first, &end))
+        {
+          result->cpu_ns += bench_ns() - t0;
+          continue;
+        }
+        for (uint16_t i = first; i < end; ++i)
+          bench_set_pixel(i, &pixels[i * LIGHT_FB_BYTES_PER_PIXEL]);
+      }
+      result->cpu_ns += bench_ns() - t0;
+      result->pixels += end - first;
+      ++result->refreshes;
+    }
+  }
+}
+
+int main(void)
+{
+  static const uint16_t counts[] = {1, 60, 300};
+  uint32_t frames = BENCH_ROUNDS * BENCH_FRAMES;
+
+  printf(
+      "%d frames per case, one every %d ms; transfer and refill interrupts "
+      "per frame\n",
+      BENCH_FRAMES,
+      LIGHT_TRANSITION_FRAME_MS);
+  for (unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+  {
+    uint16_t count = counts[i];
+    uint64_t wire_ns = (uint64_t)count * BENCH_PIXEL_NS + BENCH_RESET_NS;
+    uint32_t refills = (count * 24 + BENCH_RMT_SYMBOLS / 2 - 1) /
+                       (BENCH_RMT_SYMBOLS / 2);
+
+    printf(
+        "%3u pixels: %5.2f ms on the wire per refresh, %3.0f%% of a frame, "
+        "%u refill interrupts\n",
+        count,
+        wire_ns / 1e6,
+        wire_ns / 1e4 / LIGHT_TRANSITION_FRAME_MS,
+        refills);
+    for (int scene = BENCH_FADE; scene < BENCH_SCENES; ++scene)
+    {
+      bench_result_t all, fb;
+      bench_run(scene, count, false, &all);
+      bench_run(scene, count, true, &fb);
+      printf(
+          "  %-5s every pixel: %7.1f ns, %5.1f px, %3u%% sent;"
+          "  framebuffer: %7.1f ns, %5.1f px, %3u%% sent\n",
+          s_scene_names[scene],
+          (double)all.cpu_ns / frames,
+          (double)all.pixels / frames,
+          (unsigned)(all.refreshes * 100ULL / frames),
+          (double)fb.cpu_ns / frames,
+          (double)fb.pixels / frames,
+          (unsigned)(fb.refreshes * 100ULL / frames));
+    }
+  }
+  return 0;
+}
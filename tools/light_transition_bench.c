@@ -0,0 +1,218 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host benchmark of the light transition engine (main/light_transition.c)
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * Build and run from the project directory:
+ *
+ *   cc -O2 -I main tools/light_transition_bench.c main/light_transition.c \
+ *     -lm -o light_transition_bench
+ *   ./light_transition_bench
+ *
+ * Times one frame (step and output of a pixel) of the fixed-point engine
+ * against the same interpolation in float with powf() per frame, the way
+ * a straightforward driver would do it, and checks the gamma table and
+ * the end of each transition against the float result. The ESP32-C6 has
+ * no FPU, so on the device the gap is far larger than on the host.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "light_transition.h"
+
+#define BENCH_TRANSITIONS 20000
+/* 2 s, 100 frames */
+#define BENCH_TRANSITION_DS 20
+
+typedef struct
+{
+  float value[LIGHT_CHANNELS];
+  float step[LIGHT_CHANNELS];
+  float target[LIGHT_CHANNELS];
+  uint32_t frames;
+} bench_float_t;
+
+static uint32_t s_rng = 0x12345678;
+
+static uint16_t bench_random(void)
+{
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng;
+}
+
+static uint64_t bench_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_target(uint16_t target[LIGHT_CHANNELS])
+{
+  target[LIGHT_CHANNEL_LEVEL] = bench_random() & 0xff00;
+  for (int c = LIGHT_CHANNEL_RED; c < LIGHT_CHANNELS; ++c)
+    target[c] = bench_random();
+}
+
+static void bench_float_start(
+    bench_float_t* t, const uint16_t target[LIGHT_CHANNELS], uint32_t frames)
+{
+  for (int c = 0; c < LIGHT_CHANNELS; ++c)
+  {
+    t->target[c] = target[c];
+    t->step[c] = (t->target[c] - t->value[c]) / frames;
+  }
+  t->frames = frames;
+}
+
+static int bench_float_step(bench_float_t* t, uint16_t rgb[3])
+{
+  int more = --t->frames != 0;
+  float gain;
+
+  for (int c = 0; c < LIGHT_CHANNELS; ++c)
+    t->value[c] = more ? t->value[c] + t->step[c] : t->target[c];
+  gain = powf(t->value[LIGHT_CHANNEL_LEVEL] / 65280.0f,
+              (float)LIGHT_TRANSITION_GAMMA);
+  for (int c = 0; c < 3; ++c)
+    rgb[c] = (uint16_t)(gain * t->value[LIGHT_CHANNEL_RED + c] + 0.5f);
+  return more;
+}
+
+static void bench_gamma(void)
+{
+  double max_error = 0;
+  int at = 0;
+
+  for (int level = 0; level <= 0xff00; ++level)
+  {
+    double exact =
+        pow(level / 65280.0, LIGHT_TRANSITION_GAMMA) * 65535.0;
+    double error = fabs(light_gamma(level) - exact);
+    if (error > max_error)
+    {
+      max_error = error;
+      at = level;
+    }
+  }
+  printf(
+      "gamma %.1f table: 256 entries, %u bytes, max error %.1f/65535 at "
+      "level %.2f\n",
+      LIGHT_TRANSITION_GAMMA,
+      (unsigned)(256 * sizeof(uint16_t)),
+      max_error,
+      at / 256.0);
+}
+
+static void bench_frames(void)
+{
+  light_transition_t fixed;
+  bench_float_t flt = {0};
+  uint16_t start[LIGHT_CHANNELS] = {0};
+  uint16_t target[LIGHT_CHANNELS];
+  uint16_t rgb[3];
+  uint32_t frames = light_transition_frames(BENCH_TRANSITION_DS);
+  uint64_t total_frames = 0;
+  uint64_t fixed_ns = 0;
+  uint64_t float_ns = 0;
+  uint32_t checksum = 0;
+  int end_error = 0;
+
+  light_transition_init(&fixed, start);
+  for (int n = 0; n < BENCH_TRANSITIONS; ++n)
+  {
+    uint16_t expected[3];
+    uint64_t t0;
+
+    bench_target(target);
+    light_transition_start(&fixed, target, frames);
+    bench_float_start(&flt, target, frames);
+
+    t0 = bench_ns();
+    do
+    {
+      light_transition_output(&fixed, rgb);
+      checksum += rgb[0] + rgb[1] + rgb[2];
+    } while (light_transition_step(&fixed));
+    light_transition_output(&fixed, rgb);
+    fixed_ns += bench_ns() - t0;
+
+    t0 = bench_ns();
+    while (bench_float_step(&flt, expected))
+      checksum += expected[0] + expected[1] + expected[2];
+    float_ns += bench_ns() - t0;
+
+    for (int c = 0; c < 3; ++c)
+    {
+      int error = abs(rgb[c] - expected[c]);
+      if (error > end_error)
+        end_error = error;
+    }
+    total_frames += frames;
+  }
+  printf(
+      "%u transitions of %u frames (%u ms each): %.1f ns per frame fixed "
+      "point, %.1f ns in float with powf()\n",
+      BENCH_TRANSITIONS,
+      (unsigned)frames,
+      (unsigned)(frames * LIGHT_TRANSITION_FRAME_MS),
+      (double)fixed_ns / total_frames,
+      (double)float_ns / total_frames);
+  printf(
+      "  final color within %d/65535 of float, checksum %08x\n",
+      end_error,
+      (unsigned)checksum);
+}
+
+static void bench_xy(void)
+{
+  static const struct
+  {
+    const char* name;
+    double x;
+    double y;
+  } points[] = {
+      {"D65 white", 0.3127, 0.3290},
+      {"sRGB red", 0.64, 0.33},
+      {"sRGB green", 0.30, 0.60},
+      {"sRGB blue", 0.15, 0.06},
+      {"2700 K", 0.4599, 0.4106},
+  };
+
+  for (unsigned i = 0; i < sizeof(points) / sizeof(points[0]); ++i)
+  {
+    uint16_t rgb[3];
+    light_color_from_xy(
+        points[i].x * 65536 + 0.5, points[i].y * 65536 + 0.5, rgb);
+    printf(
+        "  %-10s x %.4f y %.4f: linear rgb %5u %5u %5u\n",
+        points[i].name,
+        points[i].x,
+        points[i].y,
+        rgb[0],
+        rgb[1],
+        rgb[2]);
+  }
+}
+
+int main(void)
+{
+  bench_gamma();
+  bench_frames();
+  printf("CIE xy to linear sRGB:\n");
+  bench_xy();
+  return 0;
+}
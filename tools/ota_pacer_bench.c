@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host benchmark of the OTA block size pacer (main/ota_pacer.c)
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * Build and run from the project directory:
+ *
+ *   cc -O2 -I main tools/ota_pacer_bench.c main/ota_pacer.c -lm \
+ *     -o ota_pacer_bench
+ *   ./ota_pacer_bench
+ *
+ * Simulates the download of an image by a sleepy end device: each block is
+ * an Image Block Request, MAC retried, then the response picked up on the
+ * next fast poll. Frames are lost with a bit error rate, so long frames are
+ * lost more often, and on the routes with long addresses or a source route
+ * the responses above ZB_ZCL_HI_MAX_PAYLOAD_SIZE never arrive. A request
+ * lost after all MAC retries costs the stack timeout, the transfer aborts
+ * after ZCL_OTA_MAX_RESEND_RETRIES in a row. Flash writes either delay the
+ * next request (serial, before the writer task) or overlap with the wait
+ * for the response (pipelined).
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "ota_pacer.h"
+
+#define BENCH_IMAGE_BYTES (600 * 1024)
+/* OTA_CLIENT_MAX_DATA_SIZE, OTA_CLIENT_BLOCK_START and OTA_CLIENT_BLOCK_MIN */
+#define BENCH_BLOCK_MAX 64
+#define BENCH_BLOCK_START 32
+#define BENCH_BLOCK_MIN 16
+/* PHY, MAC, NWK with security and APS headers, without IEEE addresses */
+#define BENCH_FRAME_OVERHEAD 45
+/* ZCL header and fields of the Image Block Request and Response */
+#define BENCH_REQUEST_ZCL 17
+#define BENCH_RESPONSE_ZCL 17
+#define BENCH_MAC_ATTEMPTS 4
+/* 250 kbit/s, plus the ACK and the backoffs of an attempt */
+#define BENCH_US_PER_BYTE 32
+#define BENCH_ATTEMPT_US 2000
+#define BENCH_POLL_US 250000
+#define BENCH_TIMEOUT_US 5000000
+#define BENCH_RESEND_RETRIES 3
+/* ZCL frame limits, ZB_ZCL_HI_WO_IEEE_MAX_PAYLOAD_SIZE and
+ * ZB_ZCL_HI_MAX_PAYLOAD_SIZE */
+#define BENCH_ZCL_MAX_SHORT 82
+#define BENCH_ZCL_MAX_LONG 66
+/* flash write of a block and the erase of each sector it starts */
+#define BENCH_WRITE_US_PER_BYTE 3
+#define BENCH_ERASE_US 45000
+#define BENCH_SECTOR 4096
+
+typedef struct
+{
+  double ber;
+  uint32_t zcl_max;
+} bench_link_t;
+
+typedef enum
+{
+  BENCH_FIXED_SERIAL,
+  BENCH_FIXED_PIPELINED,
+  BENCH_ADAPTIVE_PIPELINED,
+} bench_mode_t;
+
+static const char* const s_mode_names[] = {
+    "fixed 64, serial",
+    "fixed 64, pipelined",
+    "adaptive, pipelined",
+};
+
+static uint64_t s_rng = 0x9e3779b97f4a7c15ULL;
+
+static double bench_random(void)
+{
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 7;
+  s_rng ^= s_rng << 17;
+  return (s_rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* one frame with its MAC retries, airtime added to us */
+static int bench_send(const bench_link_t* link, uint32_t len, uint64_t* us)
+{
+  double ok = len > link->zcl_max
+                  ? 0
+                  : pow(1.0 - link->ber, 8.0 * (len + BENCH_FRAME_OVERHEAD));
+
+  for (int i = 0; i < BENCH_MAC_ATTEMPTS; ++i)
+  {
+    *us += BENCH_ATTEMPT_US + (len + BENCH_FRAME_OVERHEAD) * BENCH_US_PER_BYTE;
+    if (bench_random() < ok)
+      return 1;
+  }
+  return 0;
+}
+
+static uint64_t bench_flash_us(uint32_t offset, uint32_t len)
+{
+  uint64_t us = (uint64_t)len * BENCH_WRITE_US_PER_BYTE;
+
+  if ((offset + len - 1) / BENCH_SECTOR != (offset - 1) / BENCH_SECTOR ||
+      !offset)
+    us += BENCH_ERASE_US;
+  return us;
+}
+
+static void bench_run(const bench_link_t* link, bench_mode_t mode)
+{
+  ota_pacer_t pacer;
+  uint64_t us = 0;
+  uint64_t backlog_us = 0; /* flash work still running in the writer */
+  uint32_t offset = 0;
+  uint32_t requests = 0;
+  uint32_t losses = 0;
+  uint32_t in_row = 0;
+
+  ota_pacer_init(
+      &pacer,
+      BENCH_BLOCK_MIN,
+      BENCH_BLOCK_MAX,
+      mode == BENCH_ADAPTIVE_PIPELINED ? BENCH_BLOCK_START
+                                       : BENCH_BLOCK_MAX);
+  while (offset < BENCH_IMAGE_BYTES)
+  {
+    uint32_t size = pacer.size;
+    uint64_t wait_us = 0;
+
+    if (size > BENCH_IMAGE_BYTES - offset)
+      size = BENCH_IMAGE_BYTES - offset;
+    ++requests;
+    /* the request, then the response on the next poll */
+    if (!bench_send(link, BENCH_REQUEST_ZCL, &wait_us) ||
+        !bench_send(link, BENCH_RESPONSE_ZCL + size, &wait_us))
+    {
+      ++losses;
+      if (++in_row > BENCH_RESEND_RETRIES)
+        break;
+      us += BENCH_TIMEOUT_US;
+      backlog_us = 0;
+      if (mode == BENCH_ADAPTIVE_PIPELINED)
+        ota_pacer_lost(&pacer);
+      continue;
+    }
+    in_row = 0;
+    wait_us += BENCH_POLL_US;
+    if (mode == BENCH_FIXED_SERIAL)
+    {
+      us += wait_us + bench_flash_us(offset, size);
+    }
+    else
+    {
+      /* the previous block is written while this one comes */
+      us += wait_us > backlog_us ? wait_us : backlog_us;
+      backlog_us = bench_flash_us(offset, size);
+    }
+    if (mode == BENCH_ADAPTIVE_PIPELINED)
+      ota_pacer_ok(&pacer);
+    offset += size;
+  }
+  us += backlog_us;
+  if (offset < BENCH_IMAGE_BYTES)
+  {
+    printf(
+        "  %-20s aborted at %u%%, %u requests\n",
+        s_mode_names[mode],
+        (unsigned)(offset * 100ULL / BENCH_IMAGE_BYTES),
+        requests);
+    return;
+  }
+  printf(
+      "  %-20s %7.1f s  %6u requests  %5u lost  %3d byte blocks at the end\n",
+      s_mode_names[mode],
+      us / 1e6,
+      requests,
+      losses,
+      pacer.size);
+}
+
+int main(void)
+{
+  static const bench_link_t links[] = {
+      {0, BENCH_ZCL_MAX_SHORT},
+      {1e-4, BENCH_ZCL_MAX_SHORT},
+      {3e-4, BENCH_ZCL_MAX_SHORT},
+      {6e-4, BENCH_ZCL_MAX_SHORT},
+      {1e-3, BENCH_ZCL_MAX_SHORT},
+      {0, BENCH_ZCL_MAX_LONG},
+      {3e-4, BENCH_ZCL_MAX_LONG},
+  };
+
+  for (unsigned i = 0; i < sizeof(links) / sizeof(links[0]); ++i)
+  {
+    const bench_link_t* link = &links[i];
+    double per = 1.0 - pow(1.0 - link->ber,
+                           8.0 * (BENCH_FRAME_OVERHEAD + BENCH_RESPONSE_ZCL +
+                                  BENCH_BLOCK_MAX));
+    printf(
+        "bit error rate %g, %.0f%% of the 64 byte blocks lost per attempt, "
+        "%u byte ZCL frames\n",
+        link->ber,
+        per * 100,
+        (unsigned)link->zcl_max);
+    for (int mode = BENCH_FIXED_SERIAL; mode <= BENCH_ADAPTIVE_PIPELINED;
+         ++mode)
+    {
+      s_rng = 0x9e3779b97f4a7c15ULL;
+      bench_run(link, mode);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+#
+# SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: CC0-1.0
+#
+# Build a Zigbee OTA Upgrade file from the app image: as is, compressed, or
+# as a delta against the firmware the devices run. The compressed formats
+# are decoded by main/ota_decode.c.
+#
+# usage: tools/ota_pack.py build/light_bulb.bin build/light_bulb.ota
+#        tools/ota_pack.py --base old/light_bulb.bin new.bin new.ota
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+OTA_FILE_ID = 0x0BEEF11E
+OTA_HEADER_VERSION = 0x0100
+OTA_STACK_PRO = 0x0002
+OTA_TAG_IMAGE = 0x0000
+
+# see ota_decode.h
+DECODE_TAG = 0xf000
+DECODE_VERSION = 1
+DECODE_WINDOW_BITS = 12
+
+MATCH_MIN = 3
+MATCH_MAX = 0x3f + MATCH_MIN
+LITERAL_MAX = 0x80
+BASE_MAX = 0x4000
+# a base copy costs 4 bytes, shorter ones are not worth it
+BASE_MIN = 8
+CHAIN_DEPTH = 16
+
+# esp_app_desc_t is 0x20 bytes into the image, app_elf_sha256 0x90 into it
+APP_ELF_SHA256 = slice(0xb0, 0xd0)
+
+HEADER = os.path.join(os.path.dirname(__file__), '..', 'main', 'esp_zb_light.h')
+ZIGBEE_OTA_HEADER = os.path.join(
+    os.path.dirname(__file__), '..', 'managed_components',
+    'espressif__esp-zigbee-lib', 'include', 'zcl', 'esp_zigbee_zcl_ota.h')
+
+
+def defines(path):
+    values = {}
+    try:
+        with open(path) as f:
+            for line in f:
+                m = re.match(r'#define\s+(\w+)\s+(\w+)', line)
+                if m:
+                    values[m.group(1)] = m.group(2)
+    except OSError:
+        pass
+    return values
+
+
+def ota_define(name):
+    values = defines(HEADER)
+    value = values[name]
+    # HA_OTA_MANUFACTURER_CODE names the esp-zigbee default
+    if not re.match(r'0x[0-9a-fA-F]+$|\d+$', value):
+        value = defines(ZIGBEE_OTA_HEADER)[value]
+    return int(value, 0)
+
+
+class Encoder:
+    def __init__(self, image, base):
+        self.image = image
+        self.base = base
+        self.window = 1 << DECODE_WINDOW_BITS
+        self.chains = {}
+        self.base_index = {}
+        for i in range(0, len(base) - BASE_MIN + 1):
+            self.base_index.setdefault(base[i:i + BASE_MIN], i)
+        self.out = bytearray()
+        self.literals = bytearray()
+        self.ops = {'literal': 0, 'match': 0, 'base': 0}
+
+    def flush_literals(self):
+        for i in range(0, len(self.literals), LITERAL_MAX):
+            chunk = self.literals[i:i + LITERAL_MAX]
+            self.out.append(len(chunk) - 1)
+            self.out += chunk
+            self.ops['literal'] += 1
+        self.literals.clear()
+
+    def window_match(self, pos):
+        data = self.image
+        best_len, best_dist = 0, 0
+        limit = min(MATCH_MAX, len(data) - pos)
+        for cand in reversed(self.chains.get(data[pos:pos + MATCH_MIN], [])):
+            if pos - cand > self.window:
+                break
+            n = 0
+            while n < limit and data[cand + n] == data[pos + n]:
+                n += 1
+            if n > best_len:
+                best_len, best_dist = n, pos - cand
+                if n == limit:
+                    break
+        return best_len, best_dist
+
+    def base_match(self, pos):
+        if len(self.image) - pos < BASE_MIN:
+            return 0, 0
+        start = self.base_index.get(self.image[pos:pos + BASE_MIN])
+        if start is None:
+            return 0, 0
+        limit = min(BASE_MAX, len(self.image) - pos, len(self.base) - start)
+        n = BASE_MIN
+        while n < limit and self.base[start + n] == self.image[pos + n]:
+            n += 1
+        return n, start
+
+    def index(self, pos, end):
+        data = self.image
+        for i in range(pos, min(end, len(data) - MATCH_MIN + 1)):
+            chain = self.chains.setdefault(data[i:i + MATCH_MIN], [])
+            chain.append(i)
+            if len(chain) > CHAIN_DEPTH:
+                del chain[0]
+
+    def encode(self):
+        pos = 0
+        data = self.image
+        while pos < len(data):
+            base_len, base_from = self.base_match(pos) if self.base else (0, 0)
+            match_len, match_dist = self.window_match(pos)
+            if base_len >= BASE_MIN and base_len > match_len + 1:
+                self.flush_literals()
+                n = base_len - 1
+                self.out += bytes([0xc0 | n >> 8, n & 0xff])
+                self.out += struct.pack('<I', base_from)[:3]
+                self.ops['base'] += 1
+                step = base_len
+            elif match_len >= MATCH_MIN:
+                self.flush_literals()
+                self.out.append(0x80 | (match_len - MATCH_MIN))
+                self.out += struct.pack('<H', match_dist - 1)
+                self.ops['match'] += 1
+                step = match_len
+            else:
+                self.literals.append(data[pos])
+                step = 1
+            self.index(pos, pos + step)
+            pos += step
+        self.flush_literals()
+        return bytes(self.out)
+
+
+def decode_header(image, base):
+    sha = base[APP_ELF_SHA256] if base else bytes(32)
+    return struct.pack('<BBII', DECODE_VERSION, DECODE_WINDOW_BITS, len(image),
+                       len(base) if base else 0) + sha
+
+
+def ota_file(args, tag, element):
+    header = struct.pack(
+        '<IHHHHHIH32sI', OTA_FILE_ID, OTA_HEADER_VERSION, 56, 0,
+        args.manufacturer, args.image_type, args.file_version, OTA_STACK_PRO,
+        args.name.encode()[:32].ljust(32, b'\0'), 0)
+    body = struct.pack('<HI', tag, len(element)) + element
+    size = len(header) + len(body)
+    return header[:-4] + struct.pack('<I', size) + body
+
+
+def transfer_s(size, rate):
+    return size / rate if rate else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build a Zigbee OTA Upgrade file')
+    parser.add_argument('image', help='app image, build/light_bulb.bin')
+    parser.add_argument('output', help='OTA Upgrade file')
+    parser.add_argument('--base', help='app image the devices run, makes a delta')
+    parser.add_argument('--raw', action='store_true', help='image as is')
+    parser.add_argument('--manufacturer', type=lambda v: int(v, 0))
+    parser.add_argument('--image-type', type=lambda v: int(v, 0))
+    parser.add_argument('--file-version', type=lambda v: int(v, 0))
+    parser.add_argument('--name', default='light_bulb')
+    parser.add_argument('--rate', type=float, default=250.0,
+                        help='block throughput in B/s for the time estimates')
+    args = parser.parse_args()
+
+    if args.manufacturer is None:
+        args.manufacturer = ota_define('HA_OTA_MANUFACTURER_CODE')
+    if args.image_type is None:
+        args.image_type = ota_define('HA_OTA_IMAGE_TYPE')
+    if args.file_version is None:
+        args.file_version = ota_define('HA_OTA_FILE_VERSION')
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    base = b''
+    if args.base:
+        with open(args.base, 'rb') as f:
+            base = f.read()
+        if base[APP_ELF_SHA256] == image[APP_ELF_SHA256]:
+            sys.exit('%s and %s are the same firmware' % (args.base, args.image))
+
+    full = ota_file(args, OTA_TAG_IMAGE, image)
+    if args.raw:
+        packed = full
+        kind = 'full'
+    else:
+        encoder = Encoder(image, base)
+        packed = ota_file(args, DECODE_TAG, decode_header(image, base) + encoder.encode())
+        kind = 'delta' if base else 'compressed'
+    with open(args.output, 'wb') as f:
+        f.write(packed)
+
+    print('%s: %s file of %d bytes, version 0x%08x' %
+          (args.output, kind, len(packed), args.file_version))
+    if not args.raw:
+        print('  full image %d bytes, %.1f%% sent; %d literal, %d match, %d base ops' %
+              (len(full), 100.0 * len(packed) / len(full), encoder.ops['literal'],
+               encoder.ops['match'], encoder.ops['base']))
+        print('  at %.0f B/s: %.0f s against %.0f s for the full image' %
+              (args.rate, transfer_s(len(packed), args.rate),
+               transfer_s(len(full), args.rate)))
+
+
+if __name__ == '__main__':
+    main()
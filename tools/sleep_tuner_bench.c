@@ -0,0 +1,274 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host replay of a wake trace through the adaptive sleep threshold
+ * (main/sleep_tuner_policy.c)
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * Build and run from the project directory:
+ *
+ *   cc -O2 -I main tools/sleep_tuner_bench.c main/sleep_tuner_policy.c \
+ *     -o sleep_tuner_bench
+ *   ./sleep_tuner_bench [trace]
+ *
+ * A trace is the list of idle gaps the stack offers to sleep through, with
+ * the cost of entering and leaving light sleep measured for each. Every gap
+ * is replayed against the stack default threshold and against the tuner,
+ * fed as sleep_tuner_end() feeds it. A gap at or above the threshold is
+ * slept: the cost at the active current, then the gap at the sleep current.
+ * Below the threshold the device stays awake through the gap. Each gap
+ * follows BENCH_EVENT_US of work, the same for both.
+ *
+ * Without an argument, one hour traces are generated: a poll every 7.5 s
+ * followed by short MAC and report gaps, with or without a 10 min OTA
+ * download, for a few sleep costs. A trace recorded on a device is the
+ * decoded binlog output (tools/binlog_decode.py), the "Wake:" lines of
+ * main/sleep_tuner.c are used. It only holds the gaps the device slept
+ * through, so gaps below the threshold in use while recording are missing
+ * from both results.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "sleep_tuner_policy.h"
+
+#define BENCH_MAX_WAKES 100000
+/* ESP32-C6 figures of main/energy_model.h */
+#define BENCH_ACTIVE_UA 27000
+#define BENCH_SLEEP_UA 180
+#define BENCH_EVENT_US 2000
+#define BENCH_HOUR_MS (3600 * 1000)
+/* ZB_CONN_JOINED_POLL_MS */
+#define BENCH_POLL_MS 7500
+#define BENCH_REPORT_EVERY 8
+/* block requests of a transfer, busy */
+#define BENCH_OTA_START_MS (20 * 60 * 1000)
+#define BENCH_OTA_END_MS (30 * 60 * 1000)
+
+typedef struct
+{
+  uint32_t granted_ms;
+  uint32_t cost_us;
+  bool busy;
+} bench_wake_t;
+
+typedef struct
+{
+  double energy; /* uA * us */
+  double time_us;
+  uint32_t sleeps;
+  uint32_t losing; /* slept through a gap that cost more than it saved */
+  uint32_t threshold_ms;
+} bench_result_t;
+
+static bench_wake_t s_trace[BENCH_MAX_WAKES];
+static int s_count;
+static uint32_t s_rng;
+
+static uint32_t bench_random(uint32_t range)
+{
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng % range;
+}
+
+static void bench_add(uint32_t granted_ms, uint32_t cost_us, bool busy)
+{
+  if (s_count == BENCH_MAX_WAKES)
+    return;
+  s_trace[s_count].granted_ms = granted_ms;
+  s_trace[s_count].cost_us = cost_us;
+  s_trace[s_count].busy = busy;
+  ++s_count;
+}
+
+/* the cost spreads by +-20%, one sleep in 50 takes three times as long
+ * (flash, PHY calibration) */
+static uint32_t bench_cost(uint32_t cost_us)
+{
+  uint32_t us = cost_us * (80 + bench_random(41)) / 100;
+
+  return bench_random(50) ? us : 3 * us;
+}
+
+static void bench_generate(uint32_t cost_us, bool ota)
+{
+  uint32_t now = 0;
+  uint32_t cycle = 0;
+
+  s_count = 0;
+  s_rng = 0x12345678;
+  while (now < BENCH_HOUR_MS)
+  {
+    uint32_t used = 0;
+
+    if (ota && now >= BENCH_OTA_START_MS && now < BENCH_OTA_END_MS)
+    {
+      uint32_t gap = 150 + bench_random(200);
+
+      bench_add(gap, bench_cost(cost_us), true);
+      now += gap;
+      continue;
+    }
+    /* poll response and MAC timers */
+    for (int i = 0; i < 2; ++i)
+    {
+      uint32_t gap = 5 + bench_random(36);
+
+      bench_add(gap, bench_cost(cost_us), false);
+      used += gap;
+    }
+    if (++cycle % BENCH_REPORT_EVERY == 0)
+      for (int i = 0; i < 2; ++i)
+      {
+        uint32_t gap = 10 + bench_random(21);
+
+        bench_add(gap, bench_cost(cost_us), false);
+        used += gap;
+      }
+    bench_add(BENCH_POLL_MS - used, bench_cost(cost_us), false);
+    now += BENCH_POLL_MS;
+  }
+}
+
+static int bench_load(const char* path)
+{
+  char line[256];
+  FILE* f = fopen(path, "r");
+
+  if (!f)
+  {
+    perror(path);
+    return -1;
+  }
+  s_count = 0;
+  while (fgets(line, sizeof(line), f))
+  {
+    const char* wake = strstr(line, "Wake: ");
+    unsigned granted_ms;
+    unsigned away_us;
+    int busy;
+
+    if (!wake ||
+        sscanf(
+            wake,
+            "Wake: %u ms granted, %u us away, busy %d",
+            &granted_ms,
+            &away_us,
+            &busy) != 3)
+      continue;
+    bench_add(
+        granted_ms,
+        away_us > granted_ms * 1000u ? away_us - granted_ms * 1000u : 0,
+        busy);
+  }
+  fclose(f);
+  return s_count;
+}
+
+static void bench_replay(bool adaptive, bench_result_t* result)
+{
+  sleep_tuner_filter_t filter = {0};
+  uint32_t overhead_us = 0;
+  uint32_t threshold_ms = SLEEP_TUNER_MIN_THRESHOLD_MS;
+  bool busy = false;
+
+  memset(result, 0, sizeof(*result));
+  for (int i = 0; i < s_count; ++i)
+  {
+    const bench_wake_t* wake = &s_trace[i];
+    double gap_us = wake->granted_ms * 1000.0;
+
+    /* sleep_tuner_set_busy() */
+    if (adaptive && wake->busy != busy)
+    {
+      busy = wake->busy;
+      threshold_ms = sleep_tuner_target_ms(overhead_us, busy, threshold_ms);
+    }
+    result->energy += (double)BENCH_EVENT_US * BENCH_ACTIVE_UA;
+    result->time_us += BENCH_EVENT_US;
+    if (wake->granted_ms < threshold_ms)
+    {
+      result->energy += gap_us * BENCH_ACTIVE_UA;
+      result->time_us += gap_us;
+      continue;
+    }
+    ++result->sleeps;
+    if ((double)wake->cost_us * BENCH_ACTIVE_UA >
+        gap_us * (BENCH_ACTIVE_UA - BENCH_SLEEP_UA))
+      ++result->losing;
+    result->energy += (double)wake->cost_us * BENCH_ACTIVE_UA +
+                      gap_us * BENCH_SLEEP_UA;
+    result->time_us += gap_us + wake->cost_us;
+    /* sleep_tuner_end() after a timer wake up */
+    if (adaptive)
+    {
+      overhead_us = sleep_tuner_filter(&filter, wake->cost_us);
+      threshold_ms = sleep_tuner_target_ms(overhead_us, busy, threshold_ms);
+    }
+  }
+  result->threshold_ms = threshold_ms;
+}
+
+static void bench_report(void)
+{
+  bench_result_t fixed;
+  bench_result_t adaptive;
+
+  bench_replay(false, &fixed);
+  bench_replay(true, &adaptive);
+  printf(
+      "  fixed %3u ms    %8.1f uAh/h, %6u sleeps, %5u losing\n",
+      SLEEP_TUNER_MIN_THRESHOLD_MS,
+      fixed.energy / fixed.time_us,
+      fixed.sleeps,
+      fixed.losing);
+  printf(
+      "  adaptive        %8.1f uAh/h, %6u sleeps, %5u losing, "
+      "ends at %u ms (%+.1f%%)\n",
+      adaptive.energy / adaptive.time_us,
+      adaptive.sleeps,
+      adaptive.losing,
+      adaptive.threshold_ms,
+      100.0 * (adaptive.energy / adaptive.time_us) /
+              (fixed.energy / fixed.time_us) -
+          100.0);
+}
+
+int main(int argc, char** argv)
+{
+  static const uint32_t costs_us[] = {2000, 15000, 40000};
+
+  if (argc > 1)
+  {
+    if (bench_load(argv[1]) <= 0)
+    {
+      fprintf(stderr, "%s: no wake found\n", argv[1]);
+      return 1;
+    }
+    printf("%s, %d wakes\n", argv[1], s_count);
+    bench_report();
+    return 0;
+  }
+  for (int ota = 0; ota < 2; ++ota)
+    for (unsigned c = 0; c < sizeof(costs_us) / sizeof(costs_us[0]); ++c)
+    {
+      bench_generate(costs_us[c], ota);
+      printf(
+          "sleep cost %2u ms, %s, %d wakes\n",
+          (unsigned)(costs_us[c] / 1000),
+          ota ? "10 min OTA" : "idle",
+          s_count);
+      bench_report();
+    }
+  return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host simulation of a fleet rejoining after a parent loss
+ * (main/zb_conn_policy.c)
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * Build and run from the project directory:
+ *
+ *   cc -O2 -I main tools/zb_connectivity_bench.c main/zb_conn_policy.c \
+ *     -o zb_connectivity_bench
+ *   ./zb_connectivity_bench
+ *
+ * N end devices share a parent that goes away at time 0 and comes back
+ * after an outage. Each device notices the loss at its own poll phase,
+ * after ZB_CONN_POLL_FAIL_LIMIT failed polls, then rejoins as
+ * main/zb_connectivity.c does: admission slot, attempt, backoff after a
+ * failure. An attempt keeps the radio on for BENCH_ATTEMPT_MS. While the
+ * parent is down it fails; once it is back, an attempt started while
+ * BENCH_CAPACITY others started in the last BENCH_CONTENTION_MS fails too,
+ * the association frames collide and are not acknowledged at the MAC
+ * layer. Three policies are compared: retry on backoff only, admission
+ * slots at a fixed 1x pace, and admission slots with the pacing factor.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "zb_conn_policy.h"
+
+#define BENCH_MAX_DEVICES 200
+/* ZB_CONN_JOINED_POLL_MS, ZB_CONN_DEGRADED_POLL_MS and
+ * ZB_CONN_POLL_FAIL_LIMIT */
+#define BENCH_JOINED_POLL_MS 7500
+#define BENCH_DEGRADED_POLL_MS 1000
+#define BENCH_POLL_FAIL_LIMIT 3
+/* scan, rejoin request and response, radio on */
+#define BENCH_ATTEMPT_MS 3000
+/* associations the parent takes at once before the frames collide */
+#define BENCH_CONTENTION_MS 250
+#define BENCH_CAPACITY 2
+/* give up, a policy that has not converged by then is reported as such */
+#define BENCH_HORIZON_MS (4 * 3600 * 1000ULL)
+
+typedef enum
+{
+  BENCH_BACKOFF_ONLY,
+  BENCH_ADMISSION,
+  BENCH_ADMISSION_PACED,
+  BENCH_POLICY_COUNT,
+} bench_policy_t;
+
+static const char* const s_policy_names[] = {
+    "backoff only",
+    "admission 1x",
+    "admission, paced",
+};
+
+typedef struct
+{
+  uint32_t ieee_hash;
+  uint64_t lost_ms; /* parent loss noticed */
+  uint64_t next_ms; /* next attempt */
+  uint64_t joined_ms;
+  uint8_t failures;
+  uint16_t pace;
+  uint32_t attempts;
+} bench_device_t;
+
+static uint64_t s_rng;
+
+static uint32_t bench_random(void)
+{
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 7;
+  s_rng ^= s_rng << 17;
+  return s_rng >> 32;
+}
+
+static uint32_t bench_admission(
+    const bench_device_t* dev, bench_policy_t policy, uint64_t now)
+{
+  if (policy == BENCH_BACKOFF_ONLY)
+    return 0;
+  return zb_conn_admission_delay_ms(
+      dev->ieee_hash,
+      dev->failures,
+      now - dev->lost_ms,
+      policy == BENCH_ADMISSION_PACED ? dev->pace : ZB_CONN_PACE_UNIT);
+}
+
+static void bench_run(int count, uint32_t outage_ms, bench_policy_t policy)
+{
+  static bench_device_t devs[BENCH_MAX_DEVICES];
+  static uint64_t starts[BENCH_MAX_DEVICES * 64];
+  int started = 0;
+  int joined = 0;
+  uint32_t attempts = 0;
+  uint32_t collisions = 0;
+  uint64_t last_ms = 0;
+
+  s_rng = 0x9e3779b97f4a7c15ULL;
+  for (int i = 0; i < count; ++i)
+  {
+    bench_device_t* dev = &devs[i];
+
+    memset(dev, 0, sizeof(*dev));
+    dev->ieee_hash = bench_random();
+    dev->pace = ZB_CONN_PACE_UNIT;
+    /* the first failed poll at its phase, then the degraded polls */
+    dev->lost_ms = bench_random() % BENCH_JOINED_POLL_MS +
+                   (BENCH_POLL_FAIL_LIMIT - 1) * BENCH_DEGRADED_POLL_MS;
+    dev->next_ms = dev->lost_ms + bench_admission(dev, policy, dev->lost_ms);
+  }
+
+  while (joined < count)
+  {
+    bench_device_t* dev = NULL;
+    int busy = 0;
+
+    for (int i = 0; i < count; ++i)
+      if (!devs[i].joined_ms && (!dev || devs[i].next_ms < dev->next_ms))
+        dev = &devs[i];
+    uint64_t now = dev->next_ms;
+    if (now > BENCH_HORIZON_MS ||
+        started == sizeof(starts) / sizeof(starts[0]))
+      break;
+
+    for (int i = started - 1; i >= 0 && starts[i] + BENCH_CONTENTION_MS > now;
+         --i)
+      ++busy;
+    starts[started++] = now;
+    ++attempts;
+    ++dev->attempts;
+
+    uint64_t end = now + BENCH_ATTEMPT_MS;
+    if (now >= outage_ms && busy < BENCH_CAPACITY)
+    {
+      dev->joined_ms = end;
+      if (end > last_ms)
+        last_ms = end;
+      ++joined;
+      continue;
+    }
+    if (now >= outage_ms)
+      ++collisions;
+    if (dev->failures < UINT8_MAX)
+      ++dev->failures;
+    dev->pace = zb_conn_pace_failure(dev->pace);
+    dev->next_ms = end + zb_conn_backoff_ms(dev->failures) +
+                   bench_admission(dev, policy, end);
+  }
+
+  if (joined < count)
+  {
+    printf(
+        "  %-17s %d of %d joined after %u h, %u attempts\n",
+        s_policy_names[policy],
+        joined,
+        count,
+        (unsigned)(BENCH_HORIZON_MS / 3600000),
+        attempts);
+    return;
+  }
+  printf(
+      "  %-17s all back %6.1f s after the parent, %5.2f attempts and "
+      "%5.1f s radio on per device, %4u collisions\n",
+      s_policy_names[policy],
+      (last_ms - outage_ms) / 1000.0,
+      (double)attempts / count,
+      (double)attempts * BENCH_ATTEMPT_MS / 1000.0 / count,
+      collisions);
+}
+
+int main(void)
+{
+  static const int counts[] = {10, 50, 200};
+  static const uint32_t outages_ms[] = {10000, 120000};
+
+  for (unsigned o = 0; o < sizeof(outages_ms) / sizeof(outages_ms[0]); ++o)
+    for (unsigned c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+    {
+      printf(
+          "%d devices, parent down for %u s\n",
+          counts[c],
+          (unsigned)(outages_ms[o] / 1000));
+      for (int policy = 0; policy < BENCH_POLICY_COUNT; ++policy)
+        bench_run(counts[c], outages_ms[o], policy);
+    }
+  return 0;
+}
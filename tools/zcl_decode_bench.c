@@ -0,0 +1,180 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Host benchmark of the ZCL attribute decoder (main/zcl_decode.c)
+ *
+ * This example code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * Build and run from the project directory:
+ *
+ *   cc -O2 -I main -I managed_components/espressif__esp-zigbee-lib/include \
+ *     tools/zcl_decode_bench.c main/zcl_decode.c -lm -o zcl_decode_bench
+ *   ./zcl_decode_bench
+ */
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "zcl/esp_zigbee_zcl_common.h"
+#include "zcl_decode.h"
+
+/* one report frame payload, within the APS limit */
+#define BENCH_PAYLOAD_MAX 82
+#define BENCH_ROUNDS 2000000
+
+#define BYTES(s) ((const uint8_t*)(s))
+
+typedef struct
+{
+  const char* name;
+  uint8_t type;
+  uint8_t value[20];
+  uint8_t size;
+} bench_case_t;
+
+static const bench_case_t bench_cases[] = {
+    {"bool", ESP_ZB_ZCL_ATTR_TYPE_BOOL, {1}, 1},
+    {"u8", ESP_ZB_ZCL_ATTR_TYPE_U8, {0xc8}, 1},
+    {"u16", ESP_ZB_ZCL_ATTR_TYPE_U16, {0x34, 0x12}, 2},
+    {"u24", ESP_ZB_ZCL_ATTR_TYPE_U24, {0x56, 0x34, 0x12}, 3},
+    {"u32", ESP_ZB_ZCL_ATTR_TYPE_U32, {0x78, 0x56, 0x34, 0x12}, 4},
+    {"u48", ESP_ZB_ZCL_ATTR_TYPE_U48, {1, 2, 3, 4, 5, 6}, 6},
+    {"u64", ESP_ZB_ZCL_ATTR_TYPE_U64, {1, 2, 3, 4, 5, 6, 7, 8}, 8},
+    {"s8", ESP_ZB_ZCL_ATTR_TYPE_S8, {0xfe}, 1},
+    {"s16", ESP_ZB_ZCL_ATTR_TYPE_S16, {0x18, 0xfc}, 2},
+    {"s24", ESP_ZB_ZCL_ATTR_TYPE_S24, {0xff, 0xff, 0xff}, 3},
+    {"s32", ESP_ZB_ZCL_ATTR_TYPE_S32, {0x00, 0x00, 0x00, 0x80}, 4},
+    {"bitmap16", ESP_ZB_ZCL_ATTR_TYPE_16BITMAP, {0x01, 0x80}, 2},
+    {"enum8", ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM, {3}, 1},
+    {"semi", ESP_ZB_ZCL_ATTR_TYPE_SEMI, {0x00, 0x3c}, 2},
+    {"single", ESP_ZB_ZCL_ATTR_TYPE_SINGLE, {0x00, 0x00, 0xc0, 0x3f}, 4},
+    {"double", ESP_ZB_ZCL_ATTR_TYPE_DOUBLE, {0, 0, 0, 0, 0, 0, 0xf8, 0x3f}, 8},
+    {"utc", ESP_ZB_ZCL_ATTR_TYPE_UTC_TIME, {0x10, 0x20, 0x30, 0x40}, 4},
+    {"ieee", ESP_ZB_ZCL_ATTR_TYPE_IEEE_ADDR, {1, 2, 3, 4, 5, 6, 7, 8}, 8},
+    {"char_str",
+     ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING,
+     {9, 'E', 'S', 'P', '3', '2', 'H', '2', '-', 'L'},
+     10},
+    {"octet_str", ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, {3, 0xaa, 0xbb, 0xcc}, 4},
+    {"long_str",
+     ESP_ZB_ZCL_ATTR_TYPE_LONG_CHAR_STRING,
+     {4, 0, 'l', 'o', 'n', 'g'},
+     6},
+    {"array_u16",
+     ESP_ZB_ZCL_ATTR_TYPE_ARRAY,
+     {ESP_ZB_ZCL_ATTR_TYPE_U16, 3, 0, 1, 0, 2, 0, 3, 0},
+     9},
+    {"struct",
+     ESP_ZB_ZCL_ATTR_TYPE_STRUCTURE,
+     {2, 0, ESP_ZB_ZCL_ATTR_TYPE_U8, 7, ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING, 2,
+      'o', 'k'},
+     8},
+    {"key128",
+     ESP_ZB_ZCL_ATTR_TYPE_128_BIT_KEY,
+     {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+     16},
+};
+
+static double bench_now_s(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* fill a report payload with as many records of the case as fit */
+static size_t bench_fill(
+    const bench_case_t* c, uint8_t* payload, int* records)
+{
+  size_t len = 0;
+
+  *records = 0;
+  while (len + 3 + c->size <= BENCH_PAYLOAD_MAX)
+  {
+    payload[len++] = *records;
+    payload[len++] = 0;
+    payload[len++] = c->type;
+    memcpy(payload + len, c->value, c->size);
+    len += c->size;
+    ++*records;
+  }
+  return len;
+}
+
+static void bench_check(void)
+{
+  zcl_value_t v;
+  zcl_elem_iter_t it;
+
+  assert(zcl_decode(ESP_ZB_ZCL_ATTR_TYPE_S16, BYTES("\x18\xfc"), 2, &v));
+  assert(v.v.s == -1000);
+  assert(zcl_decode(ESP_ZB_ZCL_ATTR_TYPE_SEMI, BYTES("\x00\x3c"), 2, &v));
+  assert(v.v.f == 1.0f);
+  assert(zcl_decode(ESP_ZB_ZCL_ATTR_TYPE_U24, BYTES("\x56\x34\x12"), 3, &v));
+  assert(v.v.u == 0x123456);
+  assert(zcl_decode(ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING, BYTES("\xff"), 1, &v));
+  assert(v.kind == ZCL_VALUE_NULL);
+  /* truncated values */
+  assert(!zcl_decode(
+      ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING, BYTES("\x05" "ab"), 3, &v));
+  assert(!zcl_decode(ESP_ZB_ZCL_ATTR_TYPE_U32, BYTES("\x01\x02"), 2, &v));
+
+  static const uint8_t st[] = {2, 0, ESP_ZB_ZCL_ATTR_TYPE_U8, 7,
+                               ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING, 2, 'o', 'k'};
+  assert(zcl_decode(ESP_ZB_ZCL_ATTR_TYPE_STRUCTURE, st, sizeof(st), &v));
+  assert(v.size == sizeof(st) && v.count == 2);
+  zcl_elems_init(&it, &v);
+  assert(zcl_elems_next(&it, &v) && v.v.u == 7);
+  assert(zcl_elems_next(&it, &v) && v.len == 2 && !memcmp(v.data, "ok", 2));
+  assert(!zcl_elems_next(&it, &v));
+}
+
+int main(void)
+{
+  uint8_t payload[BENCH_PAYLOAD_MAX];
+  uint64_t total_records = 0;
+  double total_s = 0;
+
+  bench_check();
+  printf("%-10s %8s %12s %10s\n", "type", "rec/frm", "Mrecords/s", "MB/s");
+  for (size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); ++i)
+  {
+    const bench_case_t* c = &bench_cases[i];
+    int records;
+    size_t len = bench_fill(c, payload, &records);
+    uint64_t sink = 0;
+    zcl_record_iter_t it;
+    zcl_attr_record_t record;
+
+    double start = bench_now_s();
+    for (int r = 0; r < BENCH_ROUNDS / records; ++r)
+    {
+      zcl_records_init(&it, payload, len, false);
+      while (zcl_records_next(&it, &record))
+        sink += record.value.size + record.attr_id;
+      assert(!it.error);
+    }
+    double elapsed = bench_now_s() - start;
+    uint64_t decoded = (uint64_t)(BENCH_ROUNDS / records) * records;
+    assert(sink);
+
+    printf(
+        "%-10s %8d %12.1f %10.1f\n",
+        c->name,
+        records,
+        decoded / elapsed / 1e6,
+        (double)(BENCH_ROUNDS / records) * len / elapsed / 1e6);
+    total_records += decoded;
+    total_s += elapsed;
+  }
+  printf("all types: %.1f Mrecords/s\n", total_records / total_s / 1e6);
+  return 0;
+}